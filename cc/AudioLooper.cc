@@ -6,10 +6,10 @@
 #include <vector>
 #include <chrono>
 
-AudioLooper::AudioLooper(MasterClock& mc, AudioPlayer* player, double interval, bool verbose, 
+AudioLooper::AudioLooper(MasterClock& mc, std::shared_ptr<AudioPlayer> player, double interval, bool verbose, 
     std::string keypadID) : bpm(mc.getBPM()), 
     loopInterval(interval), isLooping(false), masterClock(mc), 
-    player(player), divisionDurationAsDuration(mc.fetchDivisionDurationAsDuration()),
+    player(std::move(player)), divisionDurationAsDuration(mc.fetchDivisionDurationAsDuration()),
     verbose(verbose), beatDivisions(mc.getBeatDivisions()),
     intervalDuration(std::chrono::duration_cast<
         std::chrono::high_resolution_clock::duration>(divisionDurationAsDuration * beatDivisions / loopInterval)),
@@ -29,7 +29,7 @@ AudioLooper::AudioLooper(AudioLooper&& other) noexcept
       loopInterval(other.loopInterval),
       isLooping(other.isLooping),
       masterClock(other.masterClock),
-      player(other.player),
+      player(std::move(other.player)),
       divisionDurationAsDuration(other.divisionDurationAsDuration),
       verbose(other.verbose),
       beatDivisions(other.beatDivisions),
@@ -90,9 +90,12 @@ std::string AudioLooper::startLoop() {
         printf("         AudioLooper::startLoop::Entered.\n");
     }
     isLooping = true;
-    masterClock.addItemToBatchAtInterval([&]() {
-        this->player->playAudio(); // Call the function you want to execute
-    }, intervalDuration, idTag, true);
+    // The clock applies the removal on a later tick and a worker may still be running the
+    // batch, so the action holds its own player rather than reaching back through the looper.
+    std::shared_ptr<AudioPlayer> loopPlayer = player;
+    masterClock.addItemToBatchAtInterval([loopPlayer]() {
+        loopPlayer->playAudio();
+    }, intervalDuration, idTag, true, ActionPriority::High);
     return idTag;
 }
 // printf("FILEPATH: %s\n", player->getFilePath().c_str());
@@ -17,7 +17,7 @@
 
 class AudioLooper {
 public:
-    AudioLooper(MasterClock& mc, AudioPlayer* player, double interval, bool verbose,
+    AudioLooper(MasterClock& mc, std::shared_ptr<AudioPlayer> player, double interval, bool verbose,
         std::string keypadID);
     // Move Constructor
     AudioLooper(AudioLooper&& other) noexcept;
@@ -37,7 +37,7 @@ private:
     void setIDTag();
 
     MasterClock& masterClock;
-    AudioPlayer* player;
+    std::shared_ptr<AudioPlayer> player; // shared with the sample bank, which may drop it first
     double bpm; // Beats per minute
     double loopInterval; // Loop interval in beats
     bool isLooping; // Whether the audio is currently looping
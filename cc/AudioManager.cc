@@ -1,19 +1,29 @@
 #include "AudioManager.h"
 #include <algorithm>
+#include <bitset>
 #include <cstdio>
 #include <cmath>
 
 AudioManager::AudioManager(MasterClock& mc, KeyboardEvent& kb, LooperManager& lm,
-    const std::unordered_map<std::string, std::pair<bool*, double>>& stringBoolPairs,
+    const KeypadLoopDurations& loopDurations,
     const YAML::Node& audioVerbosity, const YAML::Node& audioMixerConfig, bool sV) :
-    verbose(audioVerbosity["audioManagerVerbose"].as<bool>()), superVerbose(sV),
-    audioProcessor(audioVerbosity["audioProcessorVerbose"].as<bool>()),
     masterClock(mc), keyboardEvent(kb), looperManager(lm),
-    bpm(mc.getBPM()), beatDivisions(mc.getBeatDivisions()), 
-    beatDurationAsDuration(mc.fetchDivisionDurationAsDuration()),
-    stringBoolPairs(stringBoolPairs),
-    runAudioPlaybackThread(false), addLooper(false),
-    audioPlayerVerbose(audioVerbosity["audioPlayerVerbose"].as<bool>()) {
+    audioProcessor(audioVerbosity["audioProcessorVerbose"].as<bool>()),
+    voiceEngine(audioVerbosity["audioManagerVerbose"].as<bool>()),
+    sampleCache(audioMixerConfig["sample_cache"].as<std::string>(""), audioVerbosity["audioManagerVerbose"].as<bool>()),
+    sampleIndex(sampleCache.isEnabled() ? audioMixerConfig["sample_cache"].as<std::string>("") : "",
+        audioVerbosity["audioManagerVerbose"].as<bool>()),
+    sampleBanks(audioProcessor, audioMixerConfig, audioVerbosity["audioManagerVerbose"].as<bool>(),
+        audioVerbosity["audioPlayerVerbose"].as<bool>()),
+    offlineMixer(nullptr),
+    audioPlayerVerbose(audioVerbosity["audioPlayerVerbose"].as<bool>()),
+    loopDurations(loopDurations),
+    notePolyphony(audioMixerConfig["note_polyphony"].as<int>(4)), nextNoteId(1),
+    verbose(audioVerbosity["audioManagerVerbose"].as<bool>()), superVerbose(sV),
+    runAudioPlaybackThread(false), useVoiceEngine(false),
+    immediateTrigger(audioMixerConfig["immediate_trigger"].as<bool>(true)),
+    bpm(mc.getBPM()), beatDurationAsDuration(mc.fetchDivisionDurationAsDuration()),
+    beatDivisions(mc.getBeatDivisions()) {
     if (verbose) {
         printf("   AudioManager::AudioManager::Entered.\n");
     }
@@ -29,11 +39,41 @@ AudioManager::AudioManager(MasterClock& mc, KeyboardEvent& kb, LooperManager& lm
         mixerAudioFormat = AUDIO_F32SYS; // PI
     }
 
-    if (Mix_OpenAudio(mixerSampleRate, mixerAudioFormat, mixerChannels, mixerBufferSize) < 0) {
-        printf("---SDL_mixer initialization failed: %s\n", Mix_GetError());
-        return;
-    } else {
-        printf("   AudioManager::SDL_mixer initialization successful.\n");
+    std::string engine = audioMixerConfig["engine"].as<std::string>("native");
+    if (engine == "native") {
+        // Own the device callback; voices are limited by max_voices, not mixer_channels.
+        int outputChannels = audioMixerConfig["output_channels"].as<int>(2);
+        int maxVoices = audioMixerConfig["max_voices"].as<int>(64);
+        voiceEngine.setStealMode(VoiceEngine::parseStealMode(audioMixerConfig["voice_steal"].as<std::string>("oldest")),
+            audioMixerConfig["voice_fade_ms"].as<double>(5.0));
+        ResamplerQuality resamplerQuality =
+            SampleRateConverter::parseQuality(audioMixerConfig["resampler_quality"].as<std::string>("medium"));
+        voiceEngine.setResamplerQuality(resamplerQuality);
+        // Cached frames resampled at another quality are converted again.
+        sampleCache.setConversion(static_cast<uint32_t>(resamplerQuality));
+        useVoiceEngine = voiceEngine.open(mixerSampleRate, outputChannels,
+            static_cast<SDL_AudioFormat>(mixerAudioFormat), mixerBufferSize, maxVoices);
+        if (!useVoiceEngine) {
+            printf("   ---AudioManager::Voice engine unavailable, falling back to SDL_mixer.\n");
+        }
+    } else if (engine != "sdl_mixer") {
+        printf("   ---AudioManager::Unknown engine '%s', using SDL_mixer.\n", engine.c_str());
+    }
+    if (!useVoiceEngine) {
+        if (Mix_OpenAudio(mixerSampleRate, mixerAudioFormat, mixerChannels, mixerBufferSize) < 0) {
+            printf("---SDL_mixer initialization failed: %s\n", Mix_GetError());
+            return;
+        } else {
+            printf("   AudioManager::SDL_mixer initialization successful.\n");
+        }
+    }
+    sampleBanks.setSampleSources(useVoiceEngine ? &voiceEngine : nullptr,
+        useVoiceEngine && sampleCache.isEnabled() ? &sampleCache : nullptr,
+        sampleIndex.isEnabled() ? &sampleIndex : nullptr);
+    if (immediateTrigger) {
+        keyboardEvent.setTriggerHandler([this](SDL_Scancode keycode, int bankNumber) {
+            triggerNote(keycode, bankNumber);
+        });
     }
     if (verbose) {
         printf("      AudioManager::Constructred.\n");
@@ -42,7 +82,16 @@ AudioManager::AudioManager(MasterClock& mc, KeyboardEvent& kb, LooperManager& lm
 
 AudioManager::~AudioManager() {
     unschedulePlayback();
-    Mix_CloseAudio();
+    sampleBanks.printReport();
+    sampleCache.printReport();
+    sampleIndex.printReport();
+    if (useVoiceEngine) {
+        voiceEngine.getSampleRateConverter().printReport();
+        voiceEngine.printReport();
+        voiceEngine.close();
+    } else {
+        Mix_CloseAudio();
+    }
 }
 // Getter/Setter Function Section
 //###################################################################################################################
@@ -50,14 +99,17 @@ void AudioManager::setCurrentFunction(std::string function) {
     if (verbose) {
         printf("   AudioManager::setCurrentFunction::Updated: %s.\n", function.c_str());
     }
-    currentFunction = function;
+    sampleBanks.selectBank(function);
 }
 
-void AudioManager::setKeypadReady(bool stateUpdate) {
-    if (verbose && superVerbose) {
-        printf("   AudioManager::setKeypadReady::State Update: %d.\n", stateUpdate);
+void AudioManager::setOfflineMixer(OfflineMixer* mixer) {
+    offlineMixer = mixer;
+    if (useVoiceEngine && mixer != nullptr) {
+        // The render pulls from the voice pool itself; the device must stop consuming it.
+        voiceEngine.closeDevice();
+        mixer->setVoiceEngine(&voiceEngine);
     }
-    addLooper = stateUpdate;
+    sampleBanks.setOfflineMixer(mixer);
 }
 // Thread Managment SECTION
 // #################################################################################################
@@ -65,9 +117,10 @@ void AudioManager::schedulePlayback() {
     if (verbose) {
         printf("      AudioManager::startHandlingPlayback::Schedulong Audio Playback Task.\n");
     }
-    masterClock.setRuntimeTasks([&]() {
+    // Runs on the division after key events arrive, not on every division.
+    masterClock.addEventHandler(keyboardEvent.getInputEventId(), [&]() {
         this->audioPlaybackTask(); // Call the function you want to execute
-    });
+    }, ActionPriority::High);
     
 }
 
@@ -75,11 +128,8 @@ void AudioManager::unschedulePlayback() {
     if (verbose) {
         printf("       AudioManager::startHandlingPlayback::Signaling to Stop Audio Playback Thread.\n");
     }
-    std::lock_guard<std::mutex> lock(playerMapMutex);
-    for (const auto& config : noteConfigurations) {
-        removeAudioPlayer(config.keycode); // Clean up each audio player
-    }
-
+    // Players still held by loopers are released when those loopers stop.
+    sampleBanks.clear();
 }
 // Audio Player Section
 //###################################################################################################################
@@ -87,118 +137,125 @@ bool AudioManager::addAudioPlayer(const char* filepath, NoteConfiguration config
     if (verbose) {
         printf("      AudioManager::addAudioPlayer::FilePath: %s.\n", config.noteName.c_str());
     }
+    NoteSample note = {filepath, config};
+    return addAudioPlayers(std::vector<NoteSample>(1, note)) > 0;
+}
 
-    try {
-        std::string functionAssignment = config.functionAssignment;
-        std::string noteName = config.noteName;
-
-        // Create and manage AudioPlayer instance using unique_ptr
-        AudioPlayer* player = new AudioPlayer(audioPlayerVerbose, filepath, audioProcessor);
-
-        // Lock the playerMapMutex to safely modify playerMap
-        {
-            std::lock_guard<std::mutex> lock(playerMapMutex);
-            playerMap.emplace(noteName, std::make_pair(functionAssignment, player));
-        }
-        noteConfigurations.push_back(config);
+size_t AudioManager::addAudioPlayers(const std::vector<NoteSample>& notes) {
+    // Choke group ids and note ids are handed out here, in config order, so they do not depend on load order.
+    std::vector<VoiceOptions> options;
+    for (const NoteSample& note : notes) {
+        options.push_back(getVoiceOptions(note.config));
+    }
+    sampleBanks.addNotes(notes, options);
+    size_t loaded = sampleBanks.loadAllBanks();
+    if (sampleBanks.isLazy()) {
+        return notes.size();
+    }
+    sampleCache.printReport();
+    sampleIndex.printReport();
+    voiceEngine.getSampleRateConverter().printReport();
+    return loaded;
+}
 
-        return true;
-    } catch (const std::exception& e) {
-        // Handle the exception, e.g., log the error
-        printf("      ---AudioManager::addAudioPlayer::Failed to create AudioPlayer: %s\n", e.what());
-        return false;
+VoiceOptions AudioManager::getVoiceOptions(const NoteConfiguration& config) {
+    VoiceOptions options;
+    // Each player is its own note; ids start at 1 since 0 means none.
+    options.note = nextNoteId++;
+    options.polyphony = config.polyphony > 0 ? config.polyphony : notePolyphony;
+    if (!config.chokeGroup.empty()) {
+        auto group = chokeGroupIds.emplace(config.chokeGroup, static_cast<int>(chokeGroupIds.size() + 1));
+        options.chokeGroup = group.first->second;
+    }
+    if (verbose && !config.chokeGroup.empty()) {
+        printf("      AudioManager::getVoiceOptions::%s in choke group %s.\n", config.noteName.c_str(),
+            config.chokeGroup.c_str());
     }
+    return options;
 }
 
 bool AudioManager::removeAudioPlayer(SDL_Scancode keyCode) {
-    std::lock_guard<std::mutex> lock(playerMapMutex);
-    const NoteConfiguration* configToRemove = nullptr;
-    auto foundConfig = std::find_if(noteConfigurations.begin(), noteConfigurations.end(),
-        [&](const auto& config) {
-            return config.functionAssignment == currentFunction && config.keycode == keyCode;
-        });
-        
-    if (foundConfig != noteConfigurations.end()) {
-        configToRemove = &(*foundConfig); // Store the pointer to the found configuration
-        playerMap.erase(configToRemove->noteName);
-        return true;
-    }
-    return false;
+    return sampleBanks.removeNote(sampleBanks.getActiveBank(), keyCode);
 }
 
-AudioPlayer* AudioManager::getAudioPlayer(SDL_Scancode keyCode) {
-    std::lock_guard<std::mutex> lock(playerMapMutex);
-    for (const auto& config : noteConfigurations) {
-        if (config.functionAssignment == currentFunction && config.keycode == keyCode) {
-            if (verbose) {
-                printf("   AudioManager::getAudioPlayer:Note Found: %s.\n", config.noteName.c_str());
-            }
-            auto it = playerMap.find(config.noteName.c_str());
-            if (it != playerMap.end() && it->second.first == currentFunction) {
-                return it->second.second;
-            }
-        }
+std::shared_ptr<AudioPlayer> AudioManager::getAudioPlayer(SDL_Scancode keyCode) {
+    std::shared_ptr<AudioPlayer> player = sampleBanks.getActivePlayer(keyCode);
+    if (verbose && player) {
+        printf("   AudioManager::getAudioPlayer:Note Found: %s.\n", player->getFilePath().c_str());
     }
+    return player;
+}
 
-    // Return nullptr or handle the case as needed when not found
-    return nullptr;
+void AudioManager::triggerNote(SDL_Scancode keyCode, int bankNumber) {
+    std::shared_ptr<AudioPlayer> player = sampleBanks.getPlayer(bankNumber, keyCode);
+    if (player) {
+        player->playAudio();
+    } else if (verbose) {
+        printf("      AudioManager::triggerNote::Note '%d' not found in fn%02d.\n", keyCode, bankNumber);
+    }
 }
 
 void AudioManager::audioPlaybackTask() {
+    // One snapshot per division, so the looper state cannot change halfway through the events.
+    ControlState controlState = keyboardEvent.getControlState();
     if (superVerbose) {
-        printf("      AudioManager::audioPlaybackHandler::stringBoolPairs:\n");
-        printf("   addLooper: %s.\n", addLooper ? "true" : "false");
-        for (const auto& pair : stringBoolPairs) {
-            printf("   %s: %s\n", pair.first.c_str(), *(pair.second.first) ? "true" : "false");
-        }
+        printf("      AudioManager::audioPlaybackHandler::Control state %u: keypads 0x%03x, addLooper: %s.\n",
+            controlState.sequence, controlState.keypadLocks, controlState.addLooper ? "true" : "false");
     }
 
-    if (!keyboardEvent.isScancodeDataEmpty()) {
-        if (verbose) {
-            printf("      AudioManager::audioPlaybackHandler::Keyboard event found.\n");
+    InputEvent event;
+    bool keyEventFound = false;
+    bool activeLooper = false;
+    bool addLooper = controlState.addLooper;
+    std::string keypadIDString;
+    double loopDuration = 0.0;
+    // A flam plays every hit, but one division captures a key into the looper once.
+    std::bitset<SDL_NUM_SCANCODES> capturedKeys;
+    while (keyboardEvent.popInputEvent(event)) {
+        if (!event.down) {
+            continue;
         }
-        std::string noteInfoString = "Playing Notes: ";
-        const std::unordered_set<SDL_Scancode>& scancodeData = keyboardEvent.getScancodeData();
-
-        bool activeLooper = false;
-        std::string keypadIDString;
-        double loopDuration = 0.0;
-
-        // Find the active looper (if any) from stringBoolPairs
-        for (const auto& pair : stringBoolPairs) {
-            bool loopState = *(pair.second.first); // Dereference the bool pointer
-            if (loopState) {
-                activeLooper = loopState;
-                keypadIDString = pair.first;
-                loopDuration = pair.second.second;
-                break; // Break after finding the active looper
+        SDL_Scancode keycode = event.scancode;
+        if (!keyEventFound) {
+            keyEventFound = true;
+            if (verbose) {
+                printf("      AudioManager::audioPlaybackHandler::Keyboard event found.\n");
+            }
+            // The lowest held keypad is the active looper, if any
+            int keypad = controlState.getLockedKeypad();
+            if (keypad >= 0) {
+                activeLooper = true;
+                keypadIDString = "KP" + std::to_string(keypad + 1);
+                loopDuration = loopDurations[keypad];
+            }
+            if (verbose && addLooper) {
+                printf("      AudioManager::playAudio::LooperState: %d.\n", activeLooper);
+                printf("      AudioManager::playAudio::Keypad Number: %s.\n", keypadIDString.c_str());
+                printf("      AudioManager::playAudio::Duration: %f.\n", loopDuration);
             }
         }
-        if (verbose && addLooper) {
-            printf("      AudioManager::playAudio::LooperState: %d.\n", activeLooper);
-            printf("      AudioManager::playAudio::Keypad Number: %s.\n", keypadIDString.c_str());
-            printf("      AudioManager::playAudio::Duration: %f.\n", loopDuration);
-        }
-        std::for_each(scancodeData.begin(), scancodeData.end(), [&](const auto& keycode) {
-            AudioPlayer* player = getAudioPlayer(keycode);
-            if (player) {
+        // The bank the key was pressed in, not the one selected since.
+        std::shared_ptr<AudioPlayer> player = sampleBanks.getPlayer(event.bank, keycode);
+        if (player) {
+            if (!immediateTrigger) {
                 player->playAudio();
-                if (activeLooper && addLooper) {
-                    bool success = looperManager.addAudioLooper(keypadIDString, player, loopDuration);
-                    if (verbose) {
-                        printf("   AudioManager::audioPlaybackTask::addLooper success: %d.\n", success);
-                    }
-                }
-            } else {
+            }
+            // Looper capture stays on the division grid either way.
+            if (activeLooper && addLooper && !capturedKeys.test(keycode)) {
+                capturedKeys.set(keycode);
+                bool success = looperManager.addAudioLooper(keypadIDString, player, loopDuration);
                 if (verbose) {
-                    printf("      AudioManager::audioPlaybackHandler::Note '%d' not found in the player map.\n", keycode);
+                    printf("   AudioManager::audioPlaybackTask::addLooper success: %d.\n", success);
                 }
             }
-        });
-        keyboardEvent.clearScancodeData();
-        
-        // masterClock.startTimer("PLAYPROCESS", false);
-        // printf("   ---%s", masterClock.getDurationString("PLAYPROCESS").c_str());
-        // // window->provideNoteInfo(noteInfoString);
+        } else {
+            if (verbose) {
+                printf("      AudioManager::audioPlaybackHandler::Note '%d' not found in fn%02d.\n", keycode,
+                    event.bank);
+            }
+        }
     }
+    // masterClock.startTimer("PLAYPROCESS", false);
+    // printf("   ---%s", masterClock.getDurationString("PLAYPROCESS").c_str());
+    // // window->provideNoteInfo(noteInfoString);
 }
@@ -6,7 +6,11 @@
 #include "KeyboardEvent.h"
 #include "LooperManager.h"
 #include "MasterClock.h"
+#include "SampleBankManager.h"
+#include "SampleCache.h"
+#include "SampleIndex.h"
 #include "Structures.h"
+#include "VoiceEngine.h"
 #include <algorithm>
 #include <cstddef>
 #include <chrono>
@@ -17,44 +21,55 @@ using Duration = std::chrono::high_resolution_clock::duration;
 class AudioManager {
     public:
         AudioManager(MasterClock& mc, KeyboardEvent& kb, LooperManager& lm,
-            const std::unordered_map<std::string, std::pair<bool*, double>>& stringBoolPairs,
+            const KeypadLoopDurations& loopDurations,
             const YAML::Node& audioVerbosity, const YAML::Node& audioMixerConfig,
             bool sV);
         ~AudioManager();
         bool addAudioPlayer(const char* filepath, NoteConfiguration config);
+        // Hands the notes to the bank manager. With eager loading they are decoded
+        // now and the number loaded is returned; lazy banks load on first use.
+        size_t addAudioPlayers(const std::vector<NoteSample>& notes);
         bool removeAudioPlayer(SDL_Scancode keycode);
         void schedulePlayback();
         void unschedulePlayback();
         void setCurrentFunction(std::string function);
-        void setKeypadReady(bool stateUpdate);
+        void setOfflineMixer(OfflineMixer* mixer);
 
     private:
         // FUNCTIONS
         void audioPlaybackTask();
-        AudioPlayer* getAudioPlayer(SDL_Scancode keycode);
+        // Input thread: plays the hit now instead of at the next division.
+        void triggerNote(SDL_Scancode keycode, int bankNumber);
+        std::shared_ptr<AudioPlayer> getAudioPlayer(SDL_Scancode keycode);
+        VoiceOptions getVoiceOptions(const NoteConfiguration& config);
 
         // OBJECTS
         MasterClock& masterClock;
         KeyboardEvent& keyboardEvent;
         LooperManager& looperManager;
         AudioProcessor audioProcessor;
+        VoiceEngine voiceEngine;
+        SampleCache sampleCache;
+        SampleIndex sampleIndex; // after the cache, which creates the directory
+        SampleBankManager sampleBanks; // after the engine, cache and index, so players go first
         AudioPlayerMapThreadings audioPlayermapThreadings;
+        OfflineMixer* offlineMixer;
 
         // VARIABLES
         bool audioPlayerVerbose;
-        std::unordered_map<std::string, std::pair<std::string, AudioPlayer*>> playerMap;
-        const std::unordered_map<std::string, std::pair<bool*, double>>& stringBoolPairs;
-        std::vector<NoteConfiguration> noteConfigurations;
+        const KeypadLoopDurations& loopDurations;
+        std::unordered_map<std::string, int> chokeGroupIds;
+        int notePolyphony;
+        uint32_t nextNoteId;
         bool verbose;
         bool superVerbose;
         bool runAudioPlaybackThread;
-        bool addLooper;
+        bool useVoiceEngine; // false plays through SDL_mixer channels
+        bool immediateTrigger; // hits play from the input thread; the division task only captures loopers
         double bpm;
         Duration beatDurationAsDuration;
         double beatDivisions;
-        std::string currentFunction;
         std::thread audioPlaybackThread;
-        std::mutex playerMapMutex;
 };
 
 #endif // AUDIO_MANAGER_H
@@ -1,11 +1,62 @@
 #include "AudioPlayer.h"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <mutex>
 #include <thread>
 
-AudioPlayer::AudioPlayer(bool verbose, const char* filepath, AudioProcessor& audioProcessor)
-    : filepath(filepath), chunk(nullptr), audioProcessor(audioProcessor),
-    isPlaying(false), verbose(verbose), channels(2), format(2), frequency(48000) {
-    this->chunk = Mix_LoadWAV(filepath);
+namespace {
+// Samples load on several threads; SDL_mixer's loader is not documented as
+// thread-safe, so only the decode is serialized and the analysis still runs in parallel.
+std::mutex mixerLoadMutex;
+const Sample normalizationPeak = 0.8f;
+}
+
+AudioPlayer::AudioPlayer(bool verbose, const char* filepath, AudioProcessor& audioProcessor,
+    VoiceEngine* voiceEngine, SampleCache* sampleCache, SampleIndex* sampleIndex)
+    : audioProcessor(audioProcessor), offlineMixer(nullptr), voiceEngine(voiceEngine),
+    verbose(verbose), isPlaying(false), frequency(48000), channels(2), chunk(nullptr),
+    voiceFrames(nullptr), voiceFrameCount(0), startFrame(0), sampleGain(1.0f), playbackRate(1.0f),
+    format(2), filepath(filepath), lastVoice(0), lastChannel(-1) {
+    bool analysed = sampleIndex != nullptr && sampleIndex->find(this->filepath, analysis);
+    if (voiceEngine != nullptr) {
+        frequency = voiceEngine->getFrequency();
+        channels = voiceEngine->getChannels();
+        format = AUDIO_F32SYS;
+        if (sampleCache != nullptr && sampleCache->load(this->filepath, frequency, channels, cachedSample)) {
+            voiceFrames = cachedSample.getFrames();
+            voiceFrameCount = cachedSample.getFrameCount();
+            if (verbose) {
+                printf("         AudioPlayer::AudioPlayer::%s - Mapped %u frames from the sample cache.\n",
+                    filepath, voiceFrameCount);
+            }
+        } else {
+            if (!voiceEngine->loadSample(filepath, frames) || frames.empty()) {
+                throw std::runtime_error("Failed to load WAV file");
+            }
+            if (verbose) {
+                printf("         AudioPlayer::AudioPlayer::%s - Loaded %zu frames for the voice engine.\n",
+                    filepath, frames.size() / channels);
+            }
+            if (sampleCache != nullptr) {
+                sampleCache->store(this->filepath, frequency, channels, frames);
+            }
+            voiceFrames = frames.data();
+            voiceFrameCount = static_cast<uint32_t>(frames.size() / channels);
+        }
+        if (!analysed) {
+            audioProcessor.analyzeSamples(voiceFrames, voiceFrameCount, channels, frequency, analysis);
+            if (sampleIndex != nullptr) {
+                sampleIndex->store(this->filepath, analysis);
+            }
+        }
+        sampleGain = AudioProcessor::getNormalizationGain(analysis, normalizationPeak);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mixerLoadMutex);
+        this->chunk = Mix_LoadWAV(filepath);
+    }
     if (chunk == nullptr) {
         printf("         ---AudioPlayer::AudioPlayer:::Error loading WAV file: %s\n", Mix_GetError());
         throw std::runtime_error("Failed to load WAV file");
@@ -22,24 +73,60 @@ AudioPlayer::AudioPlayer(bool verbose, const char* filepath, AudioProcessor& aud
             printf("         AudioPlayer::AudioPlayer::Channels: %d\n", channels);
             printf("         AudioPlayer::AudioPlayer::Constructed.\n");
         }
-        int sampleCount = chunk->alen / sizeof(Sample);
-        Sample* samples = reinterpret_cast<Sample*>(chunk->abuf);
-        audioProcessor.normalizeAudioSamples(samples, sampleCount, 0.8);
+        // The chunk is already in the device format, which is 16-bit with audio_format 1.
+        if (!analysed) {
+            audioProcessor.analyzeAudioBuffer(chunk->abuf, chunk->alen, format, channels, frequency, analysis);
+            if (sampleIndex != nullptr) {
+                sampleIndex->store(this->filepath, analysis);
+            }
+        }
+        // SDL_mixer can only turn a chunk down, so the samples themselves are scaled.
+        audioProcessor.amplifyAudioBuffer(chunk->abuf, chunk->alen, format,
+            AudioProcessor::getNormalizationGain(analysis, normalizationPeak));
+    }
+}
+
+AudioPlayer::AudioPlayer(bool verbose, std::shared_ptr<AudioPlayer> sampleOwner)
+    : audioProcessor(sampleOwner->audioProcessor), offlineMixer(sampleOwner->offlineMixer),
+    voiceEngine(sampleOwner->voiceEngine), verbose(verbose), isPlaying(false),
+    frequency(sampleOwner->frequency), channels(sampleOwner->channels), chunk(sampleOwner->chunk),
+    voiceFrames(sampleOwner->voiceFrames), voiceFrameCount(sampleOwner->voiceFrameCount),
+    startFrame(sampleOwner->startFrame), analysis(sampleOwner->analysis), sampleGain(sampleOwner->sampleGain),
+    playbackRate(1.0f), sampleOwner(sampleOwner), format(sampleOwner->format), filepath(sampleOwner->filepath),
+    lastVoice(0), lastChannel(-1) {
+    if (verbose) {
+        printf("         AudioPlayer::AudioPlayer::%s - Sharing the loaded sample.\n", filepath.c_str());
     }
 }
 
 // Move Constructor
 AudioPlayer::AudioPlayer(AudioPlayer&& other) noexcept
-    : filepath(std::move(other.filepath)), chunk(other.chunk),
-      frequency(other.frequency), format(other.format), channels(other.channels),
-      isPlaying(other.isPlaying), verbose(other.verbose),
-      audioProcessor(other.audioProcessor) {
+    : audioProcessor(other.audioProcessor), offlineMixer(other.offlineMixer), voiceEngine(other.voiceEngine),
+      voiceOptions(other.voiceOptions), verbose(other.verbose), isPlaying(other.isPlaying),
+      frequency(other.frequency), channels(other.channels), chunk(other.chunk), frames(std::move(other.frames)),
+      cachedSample(std::move(other.cachedSample)), voiceFrames(other.voiceFrames), voiceFrameCount(other.voiceFrameCount),
+      startFrame(other.startFrame), analysis(other.analysis), sampleGain(other.sampleGain),
+      playbackRate(other.playbackRate), sampleOwner(std::move(other.sampleOwner)),
+      format(other.format), filepath(std::move(other.filepath)),
+      lastVoice(other.lastVoice.load()), lastChannel(other.lastChannel.load()) {
     // Set the other object's chunk pointer to nullptr to avoid double-free
     other.chunk = nullptr;
+    other.voiceFrames = nullptr;
 }
 
 AudioPlayer::~AudioPlayer() {
+    if (sampleOwner != nullptr) {
+        // The owner stops the voices and frees the sample once the last sharer is gone.
+        return;
+    }
+    // Voices still reading the sample have to end before its memory goes.
+    if (voiceEngine != nullptr && voiceFrames != nullptr) {
+        voiceEngine->stopSample(getPlayFrames());
+    }
     if (chunk != nullptr) {
+        if (offlineMixer != nullptr) {
+            offlineMixer->haltChunk(chunk);
+        }
         Mix_FreeChunk(chunk);
     }
 }
@@ -48,22 +135,85 @@ bool AudioPlayer::getIsPlaying() const {
     return isPlaying;
 }
 
+void AudioPlayer::setOfflineMixer(OfflineMixer* mixer) {
+    offlineMixer = mixer;
+}
+
+void AudioPlayer::setVoiceOptions(const VoiceOptions& options) {
+    voiceOptions = options;
+}
+
+void AudioPlayer::setSkipLeadingSilence(bool skip) {
+    if (sampleOwner != nullptr) {
+        // The owner stops voices by their start pointer, so a sharer must start where it does.
+        startFrame = sampleOwner->startFrame;
+        return;
+    }
+    startFrame = 0;
+    if (skip && voiceFrames != nullptr && analysis.soundLength > 0.0) {
+        // Keep a millisecond ahead of the first sound so the attack is not cut.
+        double start = std::max(0.0, analysis.leadingSilence - 0.001) * frequency;
+        startFrame = std::min(static_cast<uint32_t>(start), voiceFrameCount - 1);
+    }
+}
+
+void AudioPlayer::setPitch(double semitones) {
+    playbackRate = static_cast<float>(std::pow(2.0, semitones / 12.0));
+    if (voiceEngine == nullptr && semitones != 0.0) {
+        printf("         ---AudioPlayer::setPitch::%s - SDL_mixer cannot pitch samples, playing as recorded.\n",
+            filepath.c_str());
+    }
+}
+
+const SampleAnalysis& AudioPlayer::getAnalysis() const {
+    return analysis;
+}
+
+const float* AudioPlayer::getPlayFrames() const {
+    return voiceFrames + static_cast<size_t>(startFrame) * channels;
+}
+
 const std::string& AudioPlayer::getFilePath() const {
     return filepath;
 }
 
+size_t AudioPlayer::getSampleBytes() const {
+    if (sampleOwner != nullptr) {
+        return 0;
+    }
+    return static_cast<size_t>(voiceFrameCount) * channels * sizeof(float) + (chunk != nullptr ? chunk->alen : 0);
+}
+
 void AudioPlayer::playAudio() {
+    if (voiceEngine != nullptr) {
+        VoiceOptions options = voiceOptions;
+        options.gain *= sampleGain;
+        options.rate = playbackRate;
+        VoiceHandle voice = voiceEngine->play(getPlayFrames(), voiceFrameCount - startFrame, options);
+        if (voice == VoiceEngine::noVoice) {
+            printf("         AudioPlayer::playAudio::Voice command queue full, dropped %s.\n", filepath.c_str());
+        }
+        lastVoice.store(voice);
+        isPlaying = false;
+        return;
+    }
     if (this->chunk != nullptr) {
         if (verbose) {
             printf("         AudioPlayer::playAudio::Calling Mix_PlayChannel.\n");
             printf("         AudioPlayer::Playing Filepath: %s\n", filepath.c_str());
         }
 
+        if (offlineMixer != nullptr) {
+            lastVoice.store(offlineMixer->playChunk(this->chunk));
+            isPlaying = false;
+            return;
+        }
         // Check if the audio is already playing; if not, start the playback using SDL_mixer
         int channel = Mix_PlayChannel(-1, this->chunk, 0);
         if (channel == -1) {
             printf("         AudioPlayer::playAudio::Mix_PlayChannel Error: %s\n", Mix_GetError());
         }
+        lastChannel.store(channel);
         if (verbose) {
             printf("         AudioPlayer::After Playing Filepath: %s\n", filepath.c_str()); // Debug print
         }
@@ -72,8 +222,16 @@ void AudioPlayer::playAudio() {
 }
 
 void AudioPlayer::stop() {
-    if (isPlaying) {
-        Mix_HaltChannel(-1);
-        isPlaying = false;
+    if (voiceEngine != nullptr) {
+        voiceEngine->stop(lastVoice.exchange(VoiceEngine::noVoice));
+    } else if (offlineMixer != nullptr) {
+        offlineMixer->halt(lastVoice.exchange(0));
+    } else {
+        int channel = lastChannel.exchange(-1);
+        // The channel may have been handed to another player since.
+        if (channel >= 0 && Mix_GetChunk(channel) == chunk) {
+            Mix_HaltChannel(channel);
+        }
     }
+    isPlaying = false;
 }
@@ -9,17 +9,32 @@
 #include <SDL2/SDL_mixer.h>
 #endif
 #include "AudioProcessor.h"
+#include "OfflineMixer.h"
+#include "SampleCache.h"
+#include "SampleIndex.h"
+#include "VoiceEngine.h"
+#include <atomic>
+#include <memory>
 #include <string>
 #include "mutex"
 #include "queue"
+#include <vector>
 
 typedef float Sample;
 using Duration = std::chrono::high_resolution_clock::duration;
 
-class AudioPlayer {
+// Held through shared_ptr; the sample banks hand out references from a raw table entry.
+class AudioPlayer : public std::enable_shared_from_this<AudioPlayer> {
 public:
-    // Constructor
-    AudioPlayer(bool verbose, const char* filepath, AudioProcessor& audioProcessor);
+    // Constructor; with a voiceEngine the sample is decoded to float for it
+    // and played through it, otherwise it goes through SDL_mixer. A
+    // sampleCache lets the voice engine path map the prepared frames instead,
+    // and a sampleIndex skips the analysis of samples it already knows.
+    AudioPlayer(bool verbose, const char* filepath, AudioProcessor& audioProcessor,
+        VoiceEngine* voiceEngine = nullptr, SampleCache* sampleCache = nullptr, SampleIndex* sampleIndex = nullptr);
+    // Plays the sample already loaded by sampleOwner, which it keeps alive,
+    // e.g. at another pitch. Holds no sample memory of its own.
+    AudioPlayer(bool verbose, std::shared_ptr<AudioPlayer> sampleOwner);
 
     // Move Constructor
     AudioPlayer(AudioPlayer&& other) noexcept;
@@ -29,25 +44,55 @@ public:
 
     // Play the audio synchronized with the MasterClock beats
     void playAudio();
+    // Stops the voice this player started last, leaving every other voice playing.
     void stop();
     bool getIsPlaying() const;
+    // Route playback into an offline render instead of the SDL_mixer channels.
+    void setOfflineMixer(OfflineMixer* mixer);
+    // Note id, polyphony and choke group for the voice engine.
+    void setVoiceOptions(const VoiceOptions& options);
+    // Voice engine only: start playback just before the first sound. Call before the first play.
+    // A player sharing another's sample follows the owner's setting.
+    void setSkipLeadingSilence(bool skip);
+    // Voice engine only: play the sample shifted by semitones, 12 = an octave up.
+    void setPitch(double semitones);
+    const SampleAnalysis& getAnalysis() const;
 
     // Get the file path of the loaded audio
     const std::string& getFilePath() const;
+    // Memory held by the sample (decoded, mapped or SDL_mixer chunk); 0 when it is shared.
+    size_t getSampleBytes() const;
 
     // Move Assignment Operator
     AudioPlayer& operator=(AudioPlayer&& other) noexcept;
 
 private:
+    // Where voices start reading, after any skipped silence.
+    const float* getPlayFrames() const;
+
     AudioProcessor& audioProcessor;
+    OfflineMixer* offlineMixer;
+    VoiceEngine* voiceEngine;
+    VoiceOptions voiceOptions;
     // Variables
     bool verbose;
     bool isPlaying;
     int frequency;
     int channels;
     Mix_Chunk* chunk;
+    std::vector<float> frames; // voice engine sample, interleaved in the engine's layout
+    CachedSample cachedSample; // or the same, mapped from the sample cache
+    const float* voiceFrames;  // whichever of the two holds the sample
+    uint32_t voiceFrameCount;
+    uint32_t startFrame;
+    SampleAnalysis analysis;
+    Sample sampleGain; // normalization, applied as voice gain so the frames stay as decoded
+    float playbackRate; // from setPitch, 1 = as recorded
+    std::shared_ptr<AudioPlayer> sampleOwner; // set when the sample belongs to another player
     Uint16 format;
     std::string filepath;
+    std::atomic<uint32_t> lastVoice; // engine handle or offline voice id, 0 = none
+    std::atomic<int> lastChannel;    // SDL_mixer channel, -1 = none
 };
 
 #endif // AUDIO_PLAYER_H
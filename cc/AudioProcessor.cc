@@ -1,57 +1,226 @@
 #include "AudioProcessor.h"
+#include <algorithm>
 #include <cstdio>
 #include <cmath>
+#include <vector>
+
+namespace {
+const Sample silenceThreshold = 0.001f; // -60 dBFS
+const double silenceDb = -120.0;
+const double loudnessBlockSeconds = 0.4;
+const int loudnessBlockSegments = 4; // blocks overlap by 75%
+const double absoluteGateDb = -70.0;
+const double relativeGateDb = -10.0;
+
+double toLoudnessDb(double meanSquare) {
+    return meanSquare > 0.0 ? -0.691 + 10.0 * std::log10(meanSquare) : silenceDb;
+}
+}
 
 AudioProcessor::AudioProcessor(bool verbose) :
-    verbose(verbose) {
+    verbose(verbose), kernels(MixKernels::get()) {
     if (verbose) {
-        printf("      AudioProcessor::AudioProcessor::Entered.\n");
+        printf("      AudioProcessor::AudioProcessor::Entered, using %s kernels.\n", kernels.name);
     }
 }
 
 AudioProcessor::~AudioProcessor() {
 }
+// Analysis Section
+//###################################################################################################################
+Sample AudioProcessor::getPeak(const Sample* samples, size_t count) const {
+    return kernels.peakFloat(samples, count);
+}
 
-// void AudioProcessor::clipAudioSamples(Sample* samples, size_t count) {
-//     for (size_t i = 0; i < count; i++) {
-//         if (samples[i] > 1.0) {
-//             samples[i] = 1.0;
-//         } else if (samples[i] < -1.0) {
-//             samples[i] = -1.0;
-//         }
-//     }
-// }
+Sample AudioProcessor::getPeak(const int16_t* samples, size_t count) const {
+    return static_cast<Sample>(kernels.peakS16(samples, count)) / 32768.0f;
+}
 
-Sample* AudioProcessor::normalizeAudioSamples(Sample* samples, size_t count, Sample targetPeak) {
-    // Find the maximum absolute value in the samples
-    Sample maxAbsValue = 0.0;
-    for (size_t i = 0; i < count; i++) {
-        Sample absValue = std::abs(samples[i]);
-        if (absValue > maxAbsValue) {
-            maxAbsValue = absValue;
+void AudioProcessor::analyzeSamples(const Sample* frames, size_t frameCount, int channels, int frequency,
+    SampleAnalysis& analysis) const {
+    analysis = SampleAnalysis();
+    if (frameCount == 0 || channels <= 0 || frequency <= 0) {
+        return;
+    }
+    analysis.peak = getPeak(frames, frameCount * channels);
+    analysis.duration = static_cast<double>(frameCount) / frequency;
+
+    // One pass for the energy of each 100 ms segment and the silence and onset frames.
+    size_t segmentFrames = std::max<size_t>(1, static_cast<size_t>(loudnessBlockSeconds * frequency / loudnessBlockSegments));
+    std::vector<double> segmentEnergy((frameCount + segmentFrames - 1) / segmentFrames, 0.0);
+    Sample onsetLevel = analysis.peak * 0.5f;
+    size_t firstSound = frameCount;
+    size_t lastSound = 0;
+    size_t onsetFrame = frameCount;
+    double totalEnergy = 0.0;
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        const Sample* sample = frames + frame * channels;
+        Sample level = 0.0f;
+        double energy = 0.0;
+        for (int channel = 0; channel < channels; channel++) {
+            level = std::max(level, std::fabs(sample[channel]));
+            energy += static_cast<double>(sample[channel]) * sample[channel];
+        }
+        segmentEnergy[frame / segmentFrames] += energy;
+        totalEnergy += energy;
+        if (level > silenceThreshold) {
+            firstSound = std::min(firstSound, frame);
+            lastSound = frame;
+        }
+        if (onsetFrame == frameCount && level >= onsetLevel && level > 0.0f) {
+            onsetFrame = frame;
         }
     }
+    analysis.rmsDb = totalEnergy > 0.0 ? 10.0 * std::log10(totalEnergy / (frameCount * channels)) : silenceDb;
+    if (firstSound < frameCount) {
+        analysis.leadingSilence = static_cast<double>(firstSound) / frequency;
+        analysis.soundLength = static_cast<double>(lastSound + 1 - firstSound) / frequency;
+    } else {
+        analysis.leadingSilence = analysis.duration;
+    }
+    analysis.onset = static_cast<double>(std::min(onsetFrame, frameCount)) / frequency;
+
+    // Channel energies are summed as in BS.1770; a file shorter than one block is one block.
+    std::vector<double> blocks;
+    size_t blockCount = segmentEnergy.size() >= loudnessBlockSegments ? segmentEnergy.size() - loudnessBlockSegments + 1 : 1;
+    size_t segmentsPerBlock = std::min<size_t>(loudnessBlockSegments, segmentEnergy.size());
+    size_t framesPerBlock = std::min(frameCount, segmentFrames * segmentsPerBlock);
+    for (size_t block = 0; block < blockCount; block++) {
+        double energy = 0.0;
+        for (size_t segment = block; segment < block + segmentsPerBlock; segment++) {
+            energy += segmentEnergy[segment];
+        }
+        double meanSquare = energy / framesPerBlock;
+        if (toLoudnessDb(meanSquare) > absoluteGateDb) {
+            blocks.push_back(meanSquare);
+        }
+    }
+    if (blocks.empty()) {
+        return;
+    }
+    double gatedMean = 0.0;
+    for (double block : blocks) {
+        gatedMean += block;
+    }
+    double relativeGate = toLoudnessDb(gatedMean / blocks.size()) + relativeGateDb;
+    double loudMean = 0.0;
+    size_t loudBlocks = 0;
+    for (double block : blocks) {
+        if (toLoudnessDb(block) > relativeGate) {
+            loudMean += block;
+            loudBlocks++;
+        }
+    }
+    analysis.loudnessDb = toLoudnessDb(loudMean / std::max<size_t>(1, loudBlocks));
+}
+
+bool AudioProcessor::analyzeAudioBuffer(const Uint8* buffer, size_t bytes, SDL_AudioFormat format, int channels,
+    int frequency, SampleAnalysis& analysis) const {
+    if (format == AUDIO_F32SYS) {
+        analyzeSamples(reinterpret_cast<const Sample*>(buffer), bytes / sizeof(Sample) / channels, channels, frequency,
+            analysis);
+        return true;
+    }
+    if (format == AUDIO_S16SYS) {
+        std::vector<Sample> converted(bytes / sizeof(int16_t));
+        kernels.s16ToFloat(converted.data(), reinterpret_cast<const int16_t*>(buffer), converted.size());
+        analyzeSamples(converted.data(), converted.size() / channels, channels, frequency, analysis);
+        return true;
+    }
+    printf("      ---AudioProcessor::analyzeAudioBuffer::Format 0x%04x is not supported.\n", format);
+    analysis = SampleAnalysis();
+    return false;
+}
+
+Sample AudioProcessor::getNormalizationGain(const SampleAnalysis& analysis, Sample targetPeak) {
+    return analysis.peak > 0.0f ? targetPeak / analysis.peak : 1.0f;
+}
+// Processing Section
+//###################################################################################################################
+void AudioProcessor::clipAudioSamples(Sample* samples, size_t count) {
+    kernels.clampFloat(samples, samples, count);
+}
+
+Sample* AudioProcessor::normalizeAudioSamples(Sample* samples, size_t count, Sample targetPeak) {
+    // Find the maximum absolute value in the samples
+    Sample maxAbsValue = getPeak(samples, count);
     if (verbose) {
         printf("      AudioProcessor::normalizeAudioSamples:maxAbsValue: %f.\n", maxAbsValue);
     }
-
+    if (maxAbsValue <= 0.0f) {
+        // Silence; scaling would fill the buffer with NaNs.
+        return samples;
+    }
     // Calculate the scaling factor based on the target peak value
-    Sample scaleFactor = targetPeak / maxAbsValue;
-    for (size_t i = 0; i < count; i++) {
-        samples[i] *= scaleFactor;
+    kernels.scaleFloat(samples, samples, count, targetPeak / maxAbsValue);
+    return samples;
+}
+
+int16_t* AudioProcessor::normalizeAudioSamples(int16_t* samples, size_t count, Sample targetPeak) {
+    int32_t maxAbsValue = kernels.peakS16(samples, count);
+    if (verbose) {
+        printf("      AudioProcessor::normalizeAudioSamples:maxAbsValue: %d of 32768.\n", maxAbsValue);
+    }
+    if (maxAbsValue == 0) {
+        return samples;
     }
+    kernels.scaleS16(samples, samples, count, targetPeak * 32768.0f / static_cast<float>(maxAbsValue));
     return samples;
 }
 
-// void AudioProcessor::amplifyAudioSamples(Sample* samples, size_t count, Sample amplificationFactor) {
-//     for (size_t i = 0; i < count; i++) {
-//         samples[i] *= amplificationFactor;
+bool AudioProcessor::normalizeAudioBuffer(Uint8* buffer, size_t bytes, SDL_AudioFormat format, Sample targetPeak) {
+    if (format == AUDIO_F32SYS) {
+        normalizeAudioSamples(reinterpret_cast<Sample*>(buffer), bytes / sizeof(Sample), targetPeak);
+        return true;
+    }
+    if (format == AUDIO_S16SYS) {
+        normalizeAudioSamples(reinterpret_cast<int16_t*>(buffer), bytes / sizeof(int16_t), targetPeak);
+        return true;
+    }
+    printf("      ---AudioProcessor::normalizeAudioBuffer::Format 0x%04x is not supported, left as is.\n", format);
+    return false;
+}
+
+void AudioProcessor::amplifyAudioSamples(Sample* samples, size_t count, Sample amplificationFactor) {
+    kernels.scaleFloat(samples, samples, count, amplificationFactor);
+    // Clip the amplified samples to the valid range
+    kernels.clampFloat(samples, samples, count);
+}
 
-//         // Clip the amplified samples to the valid range
-//         if (samples[i] > 1.0) {
-//             samples[i] = 1.0;
-//         } else if (samples[i] < -1.0) {
-//             samples[i] = -1.0;
-//         }
-//     }
-// }
+void AudioProcessor::amplifyAudioSamples(int16_t* samples, size_t count, Sample amplificationFactor) {
+    kernels.scaleS16(samples, samples, count, amplificationFactor);
+}
+
+bool AudioProcessor::amplifyAudioBuffer(Uint8* buffer, size_t bytes, SDL_AudioFormat format, Sample amplificationFactor) {
+    if (format == AUDIO_F32SYS) {
+        amplifyAudioSamples(reinterpret_cast<Sample*>(buffer), bytes / sizeof(Sample), amplificationFactor);
+        return true;
+    }
+    if (format == AUDIO_S16SYS) {
+        amplifyAudioSamples(reinterpret_cast<int16_t*>(buffer), bytes / sizeof(int16_t), amplificationFactor);
+        return true;
+    }
+    printf("      ---AudioProcessor::amplifyAudioBuffer::Format 0x%04x is not supported, left as is.\n", format);
+    return false;
+}
+
+void AudioProcessor::mixAudioSamples(Sample* destination, const Sample* source, size_t count, Sample gain) {
+    kernels.mixAdd(destination, source, count, gain);
+}
+
+void AudioProcessor::mixAudioSamples(Sample* destination, const int16_t* source, size_t count, Sample gain) {
+    kernels.mixAddS16(destination, source, count, gain / 32768.0f);
+}
+// Conversion Section
+//###################################################################################################################
+void AudioProcessor::convertAudioSamples(int16_t* destination, const Sample* source, size_t count) {
+    kernels.floatToS16(destination, source, count);
+}
+
+void AudioProcessor::convertAudioSamples(Sample* destination, const int16_t* source, size_t count) {
+    kernels.s16ToFloat(destination, source, count);
+}
+
+const char* AudioProcessor::getKernelName() const {
+    return kernels.name;
+}
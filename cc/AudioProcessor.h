@@ -1,24 +1,75 @@
 #ifndef AUDIOPROCESSOR_H
 #define AUDIOPROCESSOR_H
 
+#ifdef _WIN32
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+#include "MixKernels.h"
 #include <cstddef>
+#include <cstdint>
 #include <chrono>
 
 typedef float Sample;
 
+// What the load-time analysis knows about a sample. Times are in seconds so an
+// entry holds for any output rate.
+struct SampleAnalysis {
+    Sample peak = 0.0f;             // largest absolute sample, 1.0 = full scale
+    double rmsDb = -120.0;          // over the whole file, dBFS
+    double loudnessDb = -120.0;     // gated 400 ms block loudness, LUFS-style but without K-weighting
+    double leadingSilence = 0.0;    // until the first sample above -60 dBFS
+    double onset = 0.0;             // where the level first reaches half the peak
+    double soundLength = 0.0;       // from the end of the leading silence to the last sample above -60 dBFS
+    double duration = 0.0;
+};
+
+// Sample processing for float and 16-bit buffers. The work is done by the
+// MixKernels picked for this CPU (scalar, SSE2, AVX2 or NEON).
 class AudioProcessor {
     public:
         explicit AudioProcessor(bool verbose);
         ~AudioProcessor();
 
+        // Largest absolute sample on a 1.0 full scale.
+        Sample getPeak(const Sample* samples, size_t count) const;
+        Sample getPeak(const int16_t* samples, size_t count) const;
+        // Fills analysis from interleaved frames; the buffer version takes native s16 or f32.
+        void analyzeSamples(const Sample* frames, size_t frameCount, int channels, int frequency,
+            SampleAnalysis& analysis) const;
+        bool analyzeAudioBuffer(const Uint8* buffer, size_t bytes, SDL_AudioFormat format, int channels, int frequency,
+            SampleAnalysis& analysis) const;
+        // Gain that brings the analysed peak to targetPeak; 1 for silence.
+        static Sample getNormalizationGain(const SampleAnalysis& analysis, Sample targetPeak);
+
         // Helper function to clip audio samples to the valid range [-1.0, 1.0]
-        // void clipAudioSamples(Sample* samples, size_t count);
+        void clipAudioSamples(Sample* samples, size_t count);
 
         // Helper function to normalize audio samples to the valid range [-1.0, 1.0]
         Sample* normalizeAudioSamples(Sample* samples, size_t count, Sample targetPeak);
-        // void amplifyAudioSamples(Sample* samples, size_t count, Sample amplificationFactor);
+        int16_t* normalizeAudioSamples(int16_t* samples, size_t count, Sample targetPeak);
+        // Normalizes a decoded buffer such as Mix_Chunk::abuf in its own format.
+        // Returns false, leaving the buffer alone, for formats other than native s16 and f32.
+        bool normalizeAudioBuffer(Uint8* buffer, size_t bytes, SDL_AudioFormat format, Sample targetPeak);
+
+        // Scales and clips; the 16-bit version saturates.
+        void amplifyAudioSamples(Sample* samples, size_t count, Sample amplificationFactor);
+        void amplifyAudioSamples(int16_t* samples, size_t count, Sample amplificationFactor);
+        bool amplifyAudioBuffer(Uint8* buffer, size_t bytes, SDL_AudioFormat format, Sample amplificationFactor);
+
+        // destination += source * gain, with 16-bit sources on a 1.0 full scale.
+        void mixAudioSamples(Sample* destination, const Sample* source, size_t count, Sample gain);
+        void mixAudioSamples(Sample* destination, const int16_t* source, size_t count, Sample gain);
+
+        // Float output is clipped to [-1.0, 1.0] before it is converted.
+        void convertAudioSamples(int16_t* destination, const Sample* source, size_t count);
+        void convertAudioSamples(Sample* destination, const int16_t* source, size_t count);
+
+        const char* getKernelName() const;
     private:
         bool verbose;
+        const MixKernelTable& kernels;
 };
 
 #endif // AUDIOPROCESSOR_H
@@ -1,57 +1,108 @@
 #include "BatchActions.h"
-#include <deque>
-#include <functional>
 #include <chrono>
+#include <utility>
 
-BatchActions::BatchActions(std::deque<ScheduleAction> batch, TimePoint executionTime, 
-    const std::string& identifier, bool looping, Duration loopInterval)
-        : batch(std::move(batch)), executionTime(executionTime), idTag(identifier),
-        isLooping(looping), interval(loopInterval) {}
+const size_t BatchActions::maxActions;
 
-// Copy constructor
-BatchActions::BatchActions(const BatchActions& other) {
-    std::lock_guard<std::mutex> lock(other.actionsMutex);
-    batch = other.batch;
-    executionTime = other.executionTime;
-    idTag = other.idTag;
-    isLooping = other.isLooping;
-    interval = other.interval;
+BatchActions::BatchActions(ScheduleAction action, TimePoint executionTime, 
+    const std::string& identifier, bool looping, Duration loopInterval)
+        : actionCount(1), pendingCount(0), priority(action.getPriority()), executionTime(executionTime), idTag(identifier),
+        isLooping(looping), interval(loopInterval), logTagId(0),
+        anchorTime(executionTime - loopInterval), iteration(1), dispatchDeadline(executionTime),
+        inFlight(false), deadlineMisses(0) {
+    actions[0] = std::move(action);
 }
 
 // Move constructor
-BatchActions::BatchActions(BatchActions&& other) {
-    std::lock_guard<std::mutex> lock(other.actionsMutex);
-    batch = std::move(other.batch);
+BatchActions::BatchActions(BatchActions&& other) : actionCount(0), pendingCount(0) {
+    moveFrom(other);
+}
+
+BatchActions::~BatchActions() {}
+
+// Move assignment operator
+BatchActions& BatchActions::operator=(BatchActions&& other) {
+    if (this != &other) {
+        moveFrom(other);
+    }
+    return *this;
+}
+
+void BatchActions::moveFrom(BatchActions& other) {
+    for (size_t index = 0; index < other.actionCount; index++) {
+        actions[index] = std::move(other.actions[index]);
+    }
+    // Drop leftovers from a previous occupant of this slot.
+    for (size_t index = other.actionCount; index < actionCount; index++) {
+        actions[index] = ScheduleAction();
+    }
+    actionCount = other.actionCount;
+    other.actionCount = 0;
+    for (size_t index = 0; index < other.pendingCount; index++) {
+        pendingActions[index] = std::move(other.pendingActions[index]);
+    }
+    for (size_t index = other.pendingCount; index < pendingCount; index++) {
+        pendingActions[index] = ScheduleAction();
+    }
+    pendingCount = other.pendingCount;
+    other.pendingCount = 0;
+    priority = other.priority;
     executionTime = other.executionTime;
     idTag = std::move(other.idTag);
     isLooping = other.isLooping;
     interval = other.interval;
+    logTagId = other.logTagId;
+    anchorTime = other.anchorTime;
+    iteration = other.iteration;
+    dispatchDeadline = other.dispatchDeadline;
+    inFlight.store(other.inFlight.load(std::memory_order_acquire), std::memory_order_release);
+    deadlineMisses.store(other.deadlineMisses.load(std::memory_order_relaxed), std::memory_order_relaxed);
 }
 
-BatchActions::~BatchActions() {}
-
 bool BatchActions::operator<(const BatchActions& other) const {
     return executionTime > other.executionTime;
 }
 
-void BatchActions::addScheduledAction(ScheduleAction action) {
-    std::lock_guard<std::mutex> lock(actionsMutex);
-    batch.push_back(std::move(action));
+bool BatchActions::addScheduledAction(ScheduleAction action) {
+    if (actionCount + pendingCount >= maxActions) {
+        return false;
+    }
+    if (isInFlight()) {
+        // A worker is reading actions; markCompleted merges this in.
+        pendingActions[pendingCount++] = std::move(action);
+        return true;
+    }
+    insertAction(std::move(action));
+    return true;
+}
+
+void BatchActions::insertAction(ScheduleAction&& action) {
+    // Keep the batch ordered by priority; equal priorities run in insertion order.
+    size_t position = actionCount;
+    while (position > 0 && actions[position - 1].getPriority() < action.getPriority()) {
+        actions[position] = std::move(actions[position - 1]);
+        position--;
+    }
+    actions[position] = std::move(action);
+    actionCount++;
+    priority = actions[0].getPriority();
+}
+
+size_t BatchActions::getActionCount() const {
+    return actionCount + pendingCount;
 }
 
 void BatchActions::executeBatchWithCorrection(Duration timeCorrection) {
-    std::lock_guard<std::mutex> lock(actionsMutex);
-    for (auto& action : batch) {
-        action.setTimeCorrection(timeCorrection);
-        action.execute();
-        action.setTimeCorrectionFlagFalse();
+    for (size_t index = 0; index < actionCount; index++) {
+        actions[index].setTimeCorrection(timeCorrection);
+        actions[index].execute();
+        actions[index].setTimeCorrectionFlagFalse();
     }
 }
 
 void BatchActions::executeBatch() const {
-    std::lock_guard<std::mutex> lock(actionsMutex);
-    for (auto& action : batch) {
-        action.execute();
+    for (size_t index = 0; index < actionCount; index++) {
+        actions[index].execute();
     }
 }
 
@@ -63,7 +114,7 @@ TimePoint BatchActions::getExecutionTime() const {
     return executionTime;
 }
 
-std::string BatchActions::getIDTag() const {
+const std::string& BatchActions::getIDTag() const {
     return idTag;
 }
 
@@ -77,4 +128,62 @@ Duration BatchActions::getDuration() const {
 
 bool BatchActions::getLoopingFlag() const {
     return isLooping;
-}
\ No newline at end of file
+}
+
+void BatchActions::setLogTagId(uint32_t tagId) {
+    logTagId = tagId;
+}
+
+uint32_t BatchActions::getLogTagId() const {
+    return logTagId;
+}
+
+void BatchActions::setAnchorTime(TimePoint newAnchorTime) {
+    anchorTime = newAnchorTime;
+}
+
+TimePoint BatchActions::getAnchorTime() const {
+    return anchorTime;
+}
+
+void BatchActions::setIteration(int64_t newIteration) {
+    iteration = newIteration;
+}
+
+int64_t BatchActions::getIteration() const {
+    return iteration;
+}
+
+ActionPriority BatchActions::getPriority() const {
+    return priority;
+}
+
+void BatchActions::markDispatched(TimePoint deadline) {
+    dispatchDeadline = deadline;
+    inFlight.store(true, std::memory_order_release);
+}
+
+void BatchActions::markCompleted() {
+    inFlight.store(false, std::memory_order_release);
+    for (size_t index = 0; index < pendingCount; index++) {
+        insertAction(std::move(pendingActions[index]));
+        pendingActions[index] = ScheduleAction();
+    }
+    pendingCount = 0;
+}
+
+bool BatchActions::isInFlight() const {
+    return inFlight.load(std::memory_order_acquire);
+}
+
+TimePoint BatchActions::getDispatchDeadline() const {
+    return dispatchDeadline;
+}
+
+void BatchActions::recordDeadlineMiss() {
+    deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t BatchActions::getDeadlineMisses() const {
+    return deadlineMisses.load(std::memory_order_relaxed);
+}
@@ -1,60 +1,39 @@
 #ifndef BATCH_ACTIONS_H
 #define BATCH_ACTIONS_H
 
+#include <atomic>
 #include <chrono>
-#include <deque>
-#include <functional>
-#include <mutex>
+#include <cstdint>
 #include <string>
 #include "ScheduleAction.h"
 
 using Duration = std::chrono::high_resolution_clock::duration;
 using TimePoint = std::chrono::high_resolution_clock::time_point;
 
+// A batch keeps its actions in a fixed inline array, so once the scheduler's
+// slots exist, requeueing, moving and executing batches never allocates.
+// Batches are move-only; the scheduler owns each one in a stable slot.
+//
+// Only the clock thread changes a batch. While it is in flight a worker reads
+// the actions, so adds made meanwhile wait in a pending list that
+// markCompleted merges in; nothing on the clock thread takes a lock.
 class BatchActions {
     public:
-        explicit BatchActions(std::deque<ScheduleAction> batch, TimePoint executionTime,
+        static const size_t maxActions = 8;
+
+        explicit BatchActions(ScheduleAction action, TimePoint executionTime,
             const std::string& identifier, bool looping, Duration loopInterval);
-        
-        // Copy constructor
-        BatchActions(const BatchActions& other);
 
         // Move constructor
         BatchActions(BatchActions&& other);
 
+        BatchActions(const BatchActions&) = delete;
+        BatchActions& operator=(const BatchActions&) = delete;
+
         ~BatchActions();
-        
-        // Copy assignment operator
-        BatchActions& operator=(const BatchActions& other) {
-            if (this != &other) {
-                std::lock(actionsMutex, other.actionsMutex);
-                std::lock_guard<std::mutex> self_lock(actionsMutex, std::adopt_lock);
-                std::lock_guard<std::mutex> other_lock(other.actionsMutex, std::adopt_lock);
-                
-                batch = other.batch;
-                executionTime = other.executionTime;
-                idTag = other.idTag;
-                isLooping = other.isLooping;
-                interval = other.interval;
-            }
-            return *this;
-        }
 
         // Move assignment operator
-        BatchActions& operator=(BatchActions&& other) {
-            if (this != &other) {
-                std::lock(actionsMutex, other.actionsMutex);
-                std::lock_guard<std::mutex> self_lock(actionsMutex, std::adopt_lock);
-                std::lock_guard<std::mutex> other_lock(other.actionsMutex, std::adopt_lock);
-                
-                batch = std::move(other.batch);
-                executionTime = other.executionTime;
-                idTag = std::move(other.idTag);
-                isLooping = other.isLooping;
-                interval = other.interval;
-            }
-            return *this;
-        }
+        BatchActions& operator=(BatchActions&& other);
 
         bool operator<(const BatchActions& other) const;
 
@@ -63,19 +42,53 @@ class BatchActions {
 
         void setExecutionTime(TimePoint newExecutionTime);
         TimePoint getExecutionTime() const;
-        std::string getIDTag() const;
+        const std::string& getIDTag() const;
         void setDuration(Duration newDuration);
         Duration getDuration() const;
         bool getLoopingFlag() const;
-        void addScheduledAction(ScheduleAction action);
+        // Returns false when the batch already holds maxActions actions,
+        // counting any still pending behind an in-flight run.
+        bool addScheduledAction(ScheduleAction action);
+        size_t getActionCount() const;
+        void setLogTagId(uint32_t tagId);
+        void setAnchorTime(TimePoint newAnchorTime);
+        TimePoint getAnchorTime() const;
+        void setIteration(int64_t newIteration);
+        int64_t getIteration() const;
+        uint32_t getLogTagId() const;
+        // Highest priority among the actions; decides the batch's place in the worker queues.
+        // Kept up to date by addScheduledAction, so reading it takes no lock.
+        ActionPriority getPriority() const;
+
+        // A dispatched batch stays in flight until a worker has run it. The clock
+        // never hands out a second copy of a batch that is still in flight.
+        void markDispatched(TimePoint deadline);
+        // Also merges the actions added while the batch was in flight.
+        void markCompleted();
+        bool isInFlight() const;
+        TimePoint getDispatchDeadline() const;
+        void recordDeadlineMiss();
+        uint64_t getDeadlineMisses() const;
 
     private:
-        std::deque<ScheduleAction> batch;
+        void moveFrom(BatchActions& other);
+        void insertAction(ScheduleAction&& action);
+
+        ScheduleAction actions[maxActions];
+        size_t actionCount;
+        ScheduleAction pendingActions[maxActions];
+        size_t pendingCount;
+        ActionPriority priority;
         TimePoint executionTime;
         std::string idTag;
         bool isLooping;
         Duration interval;
-        mutable std::mutex actionsMutex;
+        uint32_t logTagId;
+        TimePoint anchorTime;
+        int64_t iteration;
+        TimePoint dispatchDeadline;
+        std::atomic<bool> inFlight;
+        std::atomic<uint64_t> deadlineMisses;
 };
 
 class BatchActionsomparator {
@@ -0,0 +1,235 @@
+#include "BatchScheduler.h"
+#include <limits>
+#include <utility>
+
+const size_t BatchScheduler::invalidHandle = std::numeric_limits<size_t>::max();
+
+BatchScheduler::BatchScheduler() : liveBatchCount(0) {}
+
+BatchScheduler::~BatchScheduler() {}
+// Slot Section
+//###################################################################################################################
+size_t BatchScheduler::scheduleBatch(BatchActions batch) {
+    size_t handle;
+    if (!freeSlots.empty()) {
+        handle = freeSlots.back();
+        freeSlots.pop_back();
+        batchSlots[handle] = std::move(batch);
+    } else {
+        handle = batchSlots.size();
+        batchSlots.emplace_back(std::move(batch));
+        slotStates.push_back(SlotState::Free);
+        heapPositions.push_back(invalidHandle);
+    }
+    slotStates[handle] = SlotState::Queued;
+    idTagToHandle[batchSlots[handle].getIDTag()] = handle;
+    liveBatchCount++;
+    pushHeapEntry(handle);
+    return handle;
+}
+
+bool BatchScheduler::cancelBatch(size_t handle) {
+    if (handle >= slotStates.size()) {
+        return false;
+    }
+    switch (slotStates[handle]) {
+        case SlotState::Queued:
+            removeHeapEntry(handle);
+            retireSlot(handle);
+            return true;
+        case SlotState::Running:
+            // The batch is executing right now; finishBatch releases the slot.
+            slotStates[handle] = SlotState::Cancelled;
+            idTagToHandle.erase(batchSlots[handle].getIDTag());
+            liveBatchCount--;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool BatchScheduler::rescheduleBatch(size_t handle, TimePoint newExecutionTime) {
+    if (handle >= slotStates.size() || slotStates[handle] != SlotState::Queued) {
+        return false;
+    }
+    size_t position = heapPositions[handle];
+    TimePoint previousTime = heap[position].executionTime;
+    batchSlots[handle].setExecutionTime(newExecutionTime);
+    heap[position].executionTime = newExecutionTime;
+    if (newExecutionTime < previousTime) {
+        siftUp(position);
+    } else {
+        siftDown(position);
+    }
+    return true;
+}
+
+size_t BatchScheduler::findHandle(const std::string& idTag) const {
+    auto it = idTagToHandle.find(idTag);
+    if (it != idTagToHandle.end()) {
+        return it->second;
+    }
+    return invalidHandle;
+}
+
+BatchActions& BatchScheduler::getBatch(size_t handle) {
+    return batchSlots[handle];
+}
+
+const BatchActions& BatchScheduler::getBatch(size_t handle) const {
+    return batchSlots[handle];
+}
+
+void BatchScheduler::releaseSlot(size_t handle) {
+    auto it = idTagToHandle.find(batchSlots[handle].getIDTag());
+    if (it != idTagToHandle.end() && it->second == handle) {
+        idTagToHandle.erase(it);
+    }
+    if (slotStates[handle] != SlotState::Cancelled) {
+        liveBatchCount--;
+    }
+    slotStates[handle] = SlotState::Free;
+    heapPositions[handle] = invalidHandle;
+    freeSlots.push_back(handle);
+}
+
+void BatchScheduler::retireSlot(size_t handle) {
+    if (!batchSlots[handle].isInFlight()) {
+        releaseSlot(handle);
+        return;
+    }
+    // A worker still references the batch; completeBatch frees the slot.
+    if (slotStates[handle] != SlotState::Cancelled) {
+        slotStates[handle] = SlotState::Cancelled;
+        idTagToHandle.erase(batchSlots[handle].getIDTag());
+        liveBatchCount--;
+    }
+}
+// Execution Section
+//###################################################################################################################
+size_t BatchScheduler::popDueBatch(TimePoint currentTime) {
+    if (heap.empty() || heap.front().executionTime > currentTime) {
+        return invalidHandle;
+    }
+    size_t handle = heap.front().handle;
+    removeHeapEntry(handle);
+    slotStates[handle] = SlotState::Running;
+    return handle;
+}
+
+void BatchScheduler::finishBatch(size_t handle, TimePoint nextExecutionTime) {
+    if (handle >= slotStates.size()) {
+        return;
+    }
+    if (slotStates[handle] == SlotState::Running && batchSlots[handle].getLoopingFlag()) {
+        slotStates[handle] = SlotState::Queued;
+        batchSlots[handle].setExecutionTime(nextExecutionTime);
+        pushHeapEntry(handle);
+    } else if (slotStates[handle] == SlotState::Running || slotStates[handle] == SlotState::Cancelled) {
+        retireSlot(handle);
+    }
+}
+
+void BatchScheduler::completeBatch(size_t handle) {
+    if (handle >= slotStates.size()) {
+        return;
+    }
+    batchSlots[handle].markCompleted();
+    if (slotStates[handle] == SlotState::Cancelled) {
+        releaseSlot(handle);
+    }
+}
+
+std::vector<size_t> BatchScheduler::getLiveHandles() const {
+    std::vector<size_t> handles;
+    for (size_t handle = 0; handle < slotStates.size(); handle++) {
+        if (slotStates[handle] == SlotState::Queued || slotStates[handle] == SlotState::Running) {
+            handles.push_back(handle);
+        }
+    }
+    return handles;
+}
+
+TimePoint BatchScheduler::getNextExecutionTime() const {
+    if (heap.empty()) {
+        return TimePoint::max();
+    }
+    return heap.front().executionTime;
+}
+
+bool BatchScheduler::empty() const {
+    return liveBatchCount == 0;
+}
+
+size_t BatchScheduler::size() const {
+    return liveBatchCount;
+}
+// Heap Section
+//###################################################################################################################
+bool BatchScheduler::isEarlier(const HeapEntry& lhs, const HeapEntry& rhs) const {
+    if (lhs.executionTime != rhs.executionTime) {
+        return lhs.executionTime < rhs.executionTime;
+    }
+    // Equal deadlines run in handle order so the execution order is stable.
+    return lhs.handle < rhs.handle;
+}
+
+void BatchScheduler::pushHeapEntry(size_t handle) {
+    heap.push_back(HeapEntry{batchSlots[handle].getExecutionTime(), handle});
+    heapPositions[handle] = heap.size() - 1;
+    siftUp(heap.size() - 1);
+}
+
+void BatchScheduler::removeHeapEntry(size_t handle) {
+    size_t position = heapPositions[handle];
+    heapPositions[handle] = invalidHandle;
+    HeapEntry last = heap.back();
+    heap.pop_back();
+    if (position == heap.size()) {
+        return;
+    }
+    placeHeapEntry(position, last);
+    if (position > 0 && isEarlier(last, heap[(position - 1) / 2])) {
+        siftUp(position);
+    } else {
+        siftDown(position);
+    }
+}
+
+void BatchScheduler::siftUp(size_t position) {
+    HeapEntry entry = heap[position];
+    while (position > 0) {
+        size_t parent = (position - 1) / 2;
+        if (!isEarlier(entry, heap[parent])) {
+            break;
+        }
+        placeHeapEntry(position, heap[parent]);
+        position = parent;
+    }
+    placeHeapEntry(position, entry);
+}
+
+void BatchScheduler::siftDown(size_t position) {
+    HeapEntry entry = heap[position];
+    size_t count = heap.size();
+    while (true) {
+        size_t child = 2 * position + 1;
+        if (child >= count) {
+            break;
+        }
+        if (child + 1 < count && isEarlier(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!isEarlier(heap[child], entry)) {
+            break;
+        }
+        placeHeapEntry(position, heap[child]);
+        position = child;
+    }
+    placeHeapEntry(position, entry);
+}
+
+void BatchScheduler::placeHeapEntry(size_t position, const HeapEntry& entry) {
+    heap[position] = entry;
+    heapPositions[entry.handle] = position;
+}
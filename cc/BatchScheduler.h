@@ -0,0 +1,69 @@
+#ifndef BATCH_SCHEDULER_H
+#define BATCH_SCHEDULER_H
+
+#include "BatchActions.h"
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Indexed binary min-heap of BatchActions ordered by execution time.
+// Every batch lives in a stable slot and the slot index is its handle. The
+// heap keeps (executionTime, handle) pairs and heapPositions maps a handle back
+// to its heap entry, so schedule, cancel and reschedule are O(log n) and the
+// clock only ever looks at the top of the heap to find due batches.
+class BatchScheduler {
+    public:
+        static const size_t invalidHandle;
+
+        BatchScheduler();
+        ~BatchScheduler();
+
+        size_t scheduleBatch(BatchActions batch);
+        bool cancelBatch(size_t handle);
+        bool rescheduleBatch(size_t handle, TimePoint newExecutionTime);
+        size_t findHandle(const std::string& idTag) const;
+        BatchActions& getBatch(size_t handle);
+        const BatchActions& getBatch(size_t handle) const;
+
+        // Pops the earliest batch if it is due and marks it as running. The
+        // caller executes it and hands it back through finishBatch.
+        size_t popDueBatch(TimePoint currentTime);
+        void finishBatch(size_t handle, TimePoint nextExecutionTime);
+        // A batch that was handed to a worker keeps its slot until the worker
+        // reports back here, even if it is cancelled in the meantime.
+        void completeBatch(size_t handle);
+        std::vector<size_t> getLiveHandles() const;
+
+        TimePoint getNextExecutionTime() const;
+        bool empty() const;
+        size_t size() const;
+
+    private:
+        enum class SlotState { Free, Queued, Running, Cancelled };
+
+        struct HeapEntry {
+            TimePoint executionTime;
+            size_t handle;
+        };
+
+        bool isEarlier(const HeapEntry& lhs, const HeapEntry& rhs) const;
+        void pushHeapEntry(size_t handle);
+        void removeHeapEntry(size_t handle);
+        void siftUp(size_t position);
+        void siftDown(size_t position);
+        void placeHeapEntry(size_t position, const HeapEntry& entry);
+        void releaseSlot(size_t handle);
+        void retireSlot(size_t handle);
+
+        std::deque<BatchActions> batchSlots;
+        std::vector<SlotState> slotStates;
+        std::vector<size_t> heapPositions;
+        std::vector<size_t> freeSlots;
+        std::vector<HeapEntry> heap;
+        std::unordered_map<std::string, size_t> idTagToHandle;
+        size_t liveBatchCount;
+};
+
+#endif // BATCH_SCHEDULER_H
@@ -0,0 +1,33 @@
+#include "ClockSource.h"
+#include <utility>
+
+ClockSource::~ClockSource() {}
+
+VirtualClockSource::VirtualClockSource(TimePoint startTime) :
+    currentTime(startTime.time_since_epoch().count()) {}
+
+VirtualClockSource::~VirtualClockSource() {}
+
+TimePoint VirtualClockSource::now() const {
+    return TimePoint(Duration(currentTime.load(std::memory_order_acquire)));
+}
+
+Duration VirtualClockSource::waitUntil(TimePoint deadline) {
+    TimePoint from = now();
+    if (deadline <= from) {
+        return Duration(0);
+    }
+    if (advanceHandler) {
+        advanceHandler(from, deadline);
+    }
+    setTime(deadline);
+    return Duration(0);
+}
+
+void VirtualClockSource::setTime(TimePoint time) {
+    currentTime.store(time.time_since_epoch().count(), std::memory_order_release);
+}
+
+void VirtualClockSource::setAdvanceHandler(AdvanceHandler handler) {
+    advanceHandler = std::move(handler);
+}
@@ -0,0 +1,43 @@
+#ifndef CLOCK_SOURCE_H
+#define CLOCK_SOURCE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+using Duration = std::chrono::high_resolution_clock::duration;
+using TimePoint = std::chrono::high_resolution_clock::time_point;
+
+// Where MasterClock reads the time from and how it waits for a deadline.
+// Without one the clock uses high_resolution_clock and PrecisionWait.
+class ClockSource {
+    public:
+        virtual ~ClockSource();
+        virtual TimePoint now() const = 0;
+        // Returns the wakeup error (actual wakeup - deadline).
+        virtual Duration waitUntil(TimePoint deadline) = 0;
+};
+
+// Simulated time for offline rendering. Waiting never sleeps: the clock jumps
+// straight to the deadline, so a session runs as fast as the CPU allows. The
+// advance handler runs before every jump and may step the clock through the
+// interval itself (to inject input or render audio up to a point in time).
+class VirtualClockSource : public ClockSource {
+    public:
+        typedef std::function<void(TimePoint from, TimePoint to)> AdvanceHandler;
+
+        explicit VirtualClockSource(TimePoint startTime = TimePoint());
+        ~VirtualClockSource();
+
+        TimePoint now() const override;
+        Duration waitUntil(TimePoint deadline) override;
+        void setTime(TimePoint time);
+        void setAdvanceHandler(AdvanceHandler handler);
+
+    private:
+        std::atomic<int64_t> currentTime;
+        AdvanceHandler advanceHandler;
+};
+
+#endif // CLOCK_SOURCE_H
@@ -0,0 +1,155 @@
+#include "DurationLogger.h"
+
+const uint32_t DurationLogger::formatVersion;
+const uint32_t DurationLogger::noTag;
+
+namespace {
+const char logMagic[8] = {'M', 'E', 'L', 'Y', 'D', 'L', 'O', 'G'};
+const uint32_t durationEntryKind = 0;
+const uint32_t tagEntryKind = 1;
+const uint32_t durationEntrySize = 2 * sizeof(uint32_t) + 4 * sizeof(int64_t);
+const std::chrono::milliseconds writerInterval(100);
+}
+
+DurationLogger::DurationLogger(size_t capacity, bool verbose) :
+    records(capacity), droppedRecords(0), running(false), verbose(verbose), logFile(nullptr) {
+    // Tag id 0 is reserved for "no tag".
+    tagNames.push_back("");
+    tagIds[""] = noTag;
+}
+
+DurationLogger::~DurationLogger() {
+    stop();
+}
+// Start/Stop Section
+//###################################################################################################################
+void DurationLogger::start(const std::string& filepath, double bpm, double beatDivisions, int64_t startTime) {
+    if (running.load(std::memory_order_acquire)) {
+        return;
+    }
+    logFile = std::fopen(filepath.c_str(), "wb");
+    if (logFile == nullptr) {
+        printf("   ---DurationLogger::start::Error opening %s for writing.\n", filepath.c_str());
+        return;
+    }
+    uint32_t version = formatVersion;
+    uint32_t entrySize = durationEntrySize;
+    std::fwrite(logMagic, sizeof(logMagic), 1, logFile);
+    std::fwrite(&version, sizeof(version), 1, logFile);
+    std::fwrite(&entrySize, sizeof(entrySize), 1, logFile);
+    std::fwrite(&bpm, sizeof(bpm), 1, logFile);
+    std::fwrite(&beatDivisions, sizeof(beatDivisions), 1, logFile);
+    std::fwrite(&startTime, sizeof(startTime), 1, logFile);
+    std::fflush(logFile);
+
+    running.store(true, std::memory_order_release);
+    writerThread = std::thread(&DurationLogger::writerLoop, this);
+    if (verbose) {
+        printf("   DurationLogger::start::Writing %s.\n", filepath.c_str());
+    }
+}
+
+void DurationLogger::stop() {
+    if (running.exchange(false)) {
+        writerCV.notify_all();
+    }
+    if (writerThread.joinable()) {
+        writerThread.join();
+    }
+    if (logFile != nullptr) {
+        drainRecords();
+        std::fclose(logFile);
+        logFile = nullptr;
+        uint64_t dropped = droppedRecords.load(std::memory_order_relaxed);
+        if (dropped > 0) {
+            printf("   DurationLogger::stop::Dropped %llu records (ring buffer full).\n",
+                static_cast<unsigned long long>(dropped));
+        }
+    }
+}
+// Producer Section
+//###################################################################################################################
+uint32_t DurationLogger::registerTag(const std::string& tag) {
+    std::lock_guard<std::mutex> lock(tagMutex);
+    auto it = tagIds.find(tag);
+    if (it != tagIds.end()) {
+        return it->second;
+    }
+    uint32_t tagId = static_cast<uint32_t>(tagNames.size());
+    tagNames.push_back(tag);
+    tagIds[tag] = tagId;
+    return tagId;
+}
+
+bool DurationLogger::logRecord(const DurationLogRecord& record) {
+    if (!records.push(record)) {
+        droppedRecords.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+uint64_t DurationLogger::getDroppedRecordCount() const {
+    return droppedRecords.load(std::memory_order_relaxed);
+}
+// Writer Section
+//###################################################################################################################
+void DurationLogger::writerLoop() {
+    while (running.load(std::memory_order_acquire)) {
+        {
+            std::unique_lock<std::mutex> lock(writerMutex);
+            writerCV.wait_for(lock, writerInterval, [this] {
+                return !running.load(std::memory_order_acquire);
+            });
+        }
+        drainRecords();
+    }
+}
+
+void DurationLogger::drainRecords() {
+    DurationLogRecord record;
+    bool wroteRecords = false;
+    while (records.pop(record)) {
+        writeDurationEntry(record);
+        wroteRecords = true;
+    }
+    if (wroteRecords) {
+        std::fflush(logFile);
+    }
+}
+
+void DurationLogger::writeTagEntry(uint32_t tagId) {
+    std::string name;
+    {
+        std::lock_guard<std::mutex> lock(tagMutex);
+        if (tagId >= tagNames.size()) {
+            return;
+        }
+        if (tagWritten.size() < tagNames.size()) {
+            tagWritten.resize(tagNames.size(), false);
+        }
+        if (tagWritten[tagId]) {
+            return;
+        }
+        tagWritten[tagId] = true;
+        name = tagNames[tagId];
+    }
+    uint32_t nameLength = static_cast<uint32_t>(name.size());
+    std::fwrite(&tagEntryKind, sizeof(tagEntryKind), 1, logFile);
+    std::fwrite(&tagId, sizeof(tagId), 1, logFile);
+    std::fwrite(&nameLength, sizeof(nameLength), 1, logFile);
+    std::fwrite(name.data(), 1, name.size(), logFile);
+}
+
+void DurationLogger::writeDurationEntry(const DurationLogRecord& record) {
+    if (record.tagId != noTag) {
+        // Tag names are written lazily, the first time a record refers to them.
+        writeTagEntry(record.tagId);
+    }
+    std::fwrite(&durationEntryKind, sizeof(durationEntryKind), 1, logFile);
+    std::fwrite(&record.tagId, sizeof(record.tagId), 1, logFile);
+    std::fwrite(&record.timestamp, sizeof(record.timestamp), 1, logFile);
+    std::fwrite(&record.processingDuration, sizeof(record.processingDuration), 1, logFile);
+    std::fwrite(&record.sleepDuration, sizeof(record.sleepDuration), 1, logFile);
+    std::fwrite(&record.wakeupError, sizeof(record.wakeupError), 1, logFile);
+}
@@ -0,0 +1,77 @@
+#ifndef DURATION_LOGGER_H
+#define DURATION_LOGGER_H
+
+#include "RingBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// One scheduler iteration. Durations are in nanoseconds and the timestamp is
+// relative to the clock start time. tagId 0 means no looping batch ran.
+// wakeupError is how late the wait that ended the iteration woke up.
+struct DurationLogRecord {
+    int64_t timestamp;
+    int64_t processingDuration;
+    int64_t sleepDuration;
+    int64_t wakeupError;
+    uint32_t tagId;
+};
+
+// Binary duration log. The clock thread only pushes fixed-size records into a
+// preallocated ring buffer; a background writer thread drains the ring into
+// duration_logs_*.bin so no file I/O happens on the timing-critical thread.
+//
+// File layout (little-endian):
+//   header:   char[8] "MELYDLOG", uint32 version, uint32 durationEntrySize,
+//             double bpm, double beatDivisions, int64 startTime (ns since epoch)
+//   entries:  uint32 kind followed by
+//             kind 0 (duration): uint32 tagId, int64 timestamp,
+//                                int64 processingDuration, int64 sleepDuration,
+//                                int64 wakeupError (version 2+)
+//             kind 1 (tag):      uint32 tagId, uint32 nameLength, char[nameLength]
+class DurationLogger {
+    public:
+        static const uint32_t formatVersion = 2;
+        static const uint32_t noTag = 0;
+
+        DurationLogger(size_t capacity = 8192, bool verbose = false);
+        ~DurationLogger();
+
+        void start(const std::string& filepath, double bpm, double beatDivisions, int64_t startTime);
+        void stop();
+
+        // Called when a batch is created; maps an idTag to a compact integer id.
+        uint32_t registerTag(const std::string& tag);
+        // Called from the clock thread; never blocks and never touches the file.
+        bool logRecord(const DurationLogRecord& record);
+        uint64_t getDroppedRecordCount() const;
+
+    private:
+        void writerLoop();
+        void drainRecords();
+        void writeTagEntry(uint32_t tagId);
+        void writeDurationEntry(const DurationLogRecord& record);
+
+        SPSCRingBuffer<DurationLogRecord> records;
+        std::atomic<uint64_t> droppedRecords;
+        std::atomic<bool> running;
+        bool verbose;
+        std::FILE* logFile;
+        std::thread writerThread;
+        std::mutex writerMutex;
+        std::condition_variable writerCV;
+
+        mutable std::mutex tagMutex;
+        std::unordered_map<std::string, uint32_t> tagIds;
+        std::vector<std::string> tagNames;
+        std::vector<bool> tagWritten;
+};
+
+#endif // DURATION_LOGGER_H
@@ -0,0 +1,134 @@
+#ifndef INLINE_FUNCTION_H
+#define INLINE_FUNCTION_H
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template<typename Signature, size_t Capacity = 48>
+class InlineFunction;
+
+// Move-only replacement for std::function that keeps the callable in a fixed
+// buffer inside the object. Constructing, moving and calling one never touches
+// the heap; a callable that does not fit is rejected at compile time rather
+// than silently allocated. Capturing a few pointers (or a std::function,
+// which is 32 bytes on libstdc++) fits the default capacity.
+template<typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity> {
+    private:
+        template<typename F>
+        using EnableIfCallable = typename std::enable_if<
+            !std::is_same<typename std::decay<F>::type, InlineFunction>::value &&
+            std::is_convertible<decltype(std::declval<typename std::decay<F>::type&>()(std::declval<Args>()...)), R>::value
+        >::type;
+
+    public:
+        InlineFunction() noexcept : ops(nullptr) {}
+        InlineFunction(std::nullptr_t) noexcept : ops(nullptr) {}
+
+        template<typename F, typename = EnableIfCallable<F>>
+        InlineFunction(F&& function) : ops(nullptr) {
+            typedef typename std::decay<F>::type Callable;
+            static_assert(sizeof(Callable) <= Capacity,
+                "Callable is too large for InlineFunction; capture less or raise the capacity.");
+            static_assert(alignof(Callable) <= alignof(std::max_align_t),
+                "Callable is over-aligned for InlineFunction.");
+            if (isNull(function)) {
+                return;
+            }
+            new (&storage) Callable(std::forward<F>(function));
+            ops = &OpsFor<Callable>::table();
+        }
+
+        InlineFunction(InlineFunction&& other) noexcept : ops(nullptr) {
+            moveFrom(other);
+        }
+
+        InlineFunction& operator=(InlineFunction&& other) noexcept {
+            if (this != &other) {
+                reset();
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        InlineFunction& operator=(std::nullptr_t) noexcept {
+            reset();
+            return *this;
+        }
+
+        InlineFunction(const InlineFunction&) = delete;
+        InlineFunction& operator=(const InlineFunction&) = delete;
+
+        ~InlineFunction() {
+            reset();
+        }
+
+        R operator()(Args... args) const {
+            return ops->invoke(&storage, std::forward<Args>(args)...);
+        }
+
+        explicit operator bool() const noexcept {
+            return ops != nullptr;
+        }
+
+        void reset() noexcept {
+            if (ops != nullptr) {
+                ops->destroy(&storage);
+                ops = nullptr;
+            }
+        }
+
+    private:
+        struct Ops {
+            R (*invoke)(void* storage, Args&&... args);
+            void (*move)(void* destination, void* source);
+            void (*destroy)(void* storage);
+        };
+
+        template<typename Callable>
+        struct OpsFor {
+            static R invoke(void* storage, Args&&... args) {
+                return (*static_cast<Callable*>(storage))(std::forward<Args>(args)...);
+            }
+            static void move(void* destination, void* source) {
+                new (destination) Callable(std::move(*static_cast<Callable*>(source)));
+                static_cast<Callable*>(source)->~Callable();
+            }
+            static void destroy(void* storage) {
+                static_cast<Callable*>(storage)->~Callable();
+            }
+            static const Ops& table() {
+                static const Ops ops = {&invoke, &move, &destroy};
+                return ops;
+            }
+        };
+
+        template<typename T>
+        static bool isNull(T* pointer) {
+            return pointer == nullptr;
+        }
+        template<typename S>
+        static bool isNull(const std::function<S>& function) {
+            return !function;
+        }
+        template<typename T>
+        static bool isNull(const T&) {
+            return false;
+        }
+
+        void moveFrom(InlineFunction& other) noexcept {
+            if (other.ops != nullptr) {
+                other.ops->move(&storage, &other.storage);
+                ops = other.ops;
+                other.ops = nullptr;
+            }
+        }
+
+        mutable typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type storage;
+        const Ops* ops;
+};
+
+#endif // INLINE_FUNCTION_H
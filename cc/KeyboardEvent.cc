@@ -2,18 +2,41 @@
 #include <thread>
 #include <iostream>
 #include <algorithm> 
-#include <unordered_set>
 #include <array>
+#include <chrono>
+
+namespace {
+// Several seconds of drumming between two divisions at any usable tempo.
+const size_t inputEventCapacity = 256;
+
+// controlState layout: keypad locks in bits 0-8, add and remove looper in 9 and 10,
+// the function number in 16-23 and the sequence in the high 32 bits.
+const int addLooperBit = 9;
+const int removeLooperBit = 10;
+const int functionShift = 16;
+const int sequenceShift = 32;
+
+uint64_t getSteadyNanoseconds() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+}
 
 KeyboardEvent::KeyboardEvent(MasterClock& mc, bool vb, bool timeVerbose, bool superVerbose)
-    : masterClock(mc), verbose(vb), timeVerbose(timeVerbose), superVerbose(superVerbose), 
-    currentKeyState(SDL_GetKeyboardState(NULL)),
-    logging(false), newFunction(false), activeFNIndex(9), currentFunction("fn10"),
-    addLooper(false), removeLooper(false), quit(false) {
+    : verbose(vb), timeVerbose(timeVerbose), superVerbose(superVerbose), masterClock(mc),
+    inputEvents(inputEventCapacity), pushedEventCount(0), droppedEventCount(0), eventWaitNanoseconds(0),
+    maxEventWaitNanoseconds(0), poppedEventCount(0),
+    keypadLocks(0), addLooper(false), removeLooper(false), logging(false), quit(false), activeFNIndex(9),
+    controlSequence(0), controlState(0),
+    inputEventId(masterClock.registerEvent("KeyboardInput", true)),
+    controlEventId(masterClock.registerEvent("ControlState", false)),
+    keyboardProbe(masterClock.registerProbe("KeyboardEvent")), sessionRecorder(nullptr),
+    currentKeyState(SDL_GetKeyboardState(NULL)) {
     initPressedKeysMap();
     initKeypadPressedKeysMap();
     initKeypadCtrlPressedKeysMap();
     initFunctionPressedKeysMap();
+    publishControlState();
     if (verbose) {
         printf("       KeyboardEvent::KeyboardEvent::Constructed.\n");
     }
@@ -87,61 +110,101 @@ void KeyboardEvent::stopHandlingEvents() {
     if (keyboardThread.joinable()) {
         keyboardThread.join();  // Wait for the thread to finish
     }
+    printReport();
 }
 // Getter/Setter Functions SECTION
 // #################################################################################################
-bool KeyboardEvent::getKeypadStates(int keypadNumber) {
-    if (keypadNumber >= 0 && keypadNumber <= 8) {
-        std::lock_guard<std::mutex> lock(isKeypadLockedMutex);
-        if (verbose && superVerbose && isKPLocked[keypadNumber]) {
-            printf("       KeyboardEvent::getKeypadStates::KeypadNumber: %d.\n", keypadNumber);
-            printf("       KeyboardEvent::getKeypadStates::KeypadNumber: %d.\n", isKPLocked[keypadNumber]);
+ControlState KeyboardEvent::getControlState() const {
+    uint64_t word = controlState.load(std::memory_order_acquire);
+    ControlState state;
+    state.keypadLocks = static_cast<uint16_t>(word & 0x1FF);
+    state.addLooper = (word >> addLooperBit & 1) != 0;
+    state.removeLooper = (word >> removeLooperBit & 1) != 0;
+    state.functionNumber = static_cast<int>(word >> functionShift & 0xFF);
+    state.sequence = static_cast<uint32_t>(word >> sequenceShift);
+    return state;
+}
+
+MasterClock::EventId KeyboardEvent::getInputEventId() const {
+    return inputEventId;
+}
+
+MasterClock::EventId KeyboardEvent::getControlEventId() const {
+    return controlEventId;
+}
+
+int ControlState::getLockedKeypad() const {
+    for (int keypad = 0; keypad < 9; keypad++) {
+        if (keypadLocks & (1 << keypad)) {
+            return keypad;
         }
-        return isKPLocked[keypadNumber];
-    } 
-    if (keypadNumber == -1) {
-        return addLooper;
-    } 
-    if (keypadNumber == -2) {
-        return removeLooper;
     }
-    return false;
+    return -1;
 }
 
-bool KeyboardEvent::isScancodeDataEmpty() {
-    std::lock_guard<std::mutex> lock(scancodeDataMutex);
-    if (verbose) {
-        printf("          KeyboardEvent::isScancodeDataEmpty: %d.\n", scancodeData.empty());
+void KeyboardEvent::publishControlState() {
+    controlSequence++;
+    uint64_t word = static_cast<uint64_t>(keypadLocks) |
+        static_cast<uint64_t>(addLooper) << addLooperBit |
+        static_cast<uint64_t>(removeLooper) << removeLooperBit |
+        static_cast<uint64_t>(activeFNIndex + 1) << functionShift |
+        static_cast<uint64_t>(controlSequence) << sequenceShift;
+    controlState.store(word, std::memory_order_release);
+    masterClock.signalEvent(controlEventId);
+    if (verbose && superVerbose) {
+        printf("       KeyboardEvent::publishControlState::Keypads 0x%03x, add %d, remove %d, fn%02d, sequence %u.\n",
+            keypadLocks, addLooper, removeLooper, activeFNIndex + 1, controlSequence);
     }
-    return scancodeData.empty();
 }
 
-void KeyboardEvent::functionFetchReset() {
-    std::lock_guard<std::mutex> lock(newFunctionMutex);
-    newFunction = false;
+void KeyboardEvent::setSessionRecorder(SessionRecorder* recorder) {
+    sessionRecorder = recorder;
 }
 
-std::string KeyboardEvent::getFunctionState() {
-    return currentFunction;
+void KeyboardEvent::setTriggerHandler(TriggerHandler handler) {
+    triggerHandler = std::move(handler);
 }
 
-void KeyboardEvent::setScancodeData(SDL_Scancode scancode) {
-    std::lock_guard<std::mutex> lock(scancodeDataMutex);
-    if (scancodeData.size() < 4) {
-        scancodeData.insert(scancode);
+void KeyboardEvent::pushInputEvent(SDL_Scancode scancode, bool down, Uint32 timestamp) {
+    InputEvent event = {scancode, down, timestamp, getSteadyNanoseconds(), activeFNIndex + 1};
+    if (!inputEvents.push(event)) {
+        // The input thread never waits on the consumer; the hit still played if triggering is immediate.
+        droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+        return;
     }
+    pushedEventCount.fetch_add(1, std::memory_order_relaxed);
+    masterClock.signalEvent(inputEventId);
 }
 
-const std::unordered_set<SDL_Scancode>& KeyboardEvent::getScancodeData() {
-    std::lock_guard<std::mutex> lock(scancodeDataMutex);
+bool KeyboardEvent::popInputEvent(InputEvent& event) {
+    if (!inputEvents.pop(event)) {
+        return false;
+    }
+    uint64_t now = getSteadyNanoseconds();
+    uint64_t wait = now > event.steadyNanoseconds ? now - event.steadyNanoseconds : 0;
+    eventWaitNanoseconds.fetch_add(wait, std::memory_order_relaxed);
+    if (wait > maxEventWaitNanoseconds.load(std::memory_order_relaxed)) {
+        maxEventWaitNanoseconds.store(wait, std::memory_order_relaxed);
+    }
+    poppedEventCount.fetch_add(1, std::memory_order_relaxed);
     if (verbose) {
-        printf("       KeyboardEvent::getScancodeData::Codes ");
-        for (const int& code : scancodeData) {
-            printf("%d ", code);
-        }
-        printf("\n");
+        printf("       KeyboardEvent::popInputEvent::Code %d %s at %u ms, waited %.2f ms.\n", event.scancode,
+            event.down ? "down" : "up", event.sdlTimestamp, wait / 1e6);
     }
-    return scancodeData;
+    return true;
+}
+
+void KeyboardEvent::printReport() const {
+    uint64_t pushed = pushedEventCount.load(std::memory_order_relaxed);
+    uint64_t dropped = droppedEventCount.load(std::memory_order_relaxed);
+    if (pushed == 0 && dropped == 0) {
+        return;
+    }
+    uint64_t popped = poppedEventCount.load(std::memory_order_relaxed);
+    printf("      KeyboardEvent::Report::%llu key events, %llu dropped on a full ring, wait before use avg %.2f ms, max %.2f ms.\n",
+        static_cast<unsigned long long>(pushed), static_cast<unsigned long long>(dropped),
+        popped > 0 ? eventWaitNanoseconds.load(std::memory_order_relaxed) / 1e6 / popped : 0.0,
+        maxEventWaitNanoseconds.load(std::memory_order_relaxed) / 1e6);
 }
 // Validator Functions SECTION
 // #################################################################################################
@@ -193,23 +256,18 @@ void KeyboardEvent::handleKeypadKey(SDL_Scancode scancode) {
             printf("               KeyboardEvent::handleKeypadKey::Scancode: %d.\n", scancode);
             printf("               KeyboardEvent::handleKeypadKey::State: %d.\n", keypadPressedKeys[scancode]);
         }
-        std::lock_guard<std::mutex> lock(isKeypadLockedMutex);
-        isKPLocked[scancode - 89] = keypadPressedKeys[scancode];
+        uint16_t bit = static_cast<uint16_t>(1 << (scancode - 89));
+        keypadLocks = keypadPressedKeys[scancode] ? (keypadLocks | bit) : (keypadLocks & ~bit);
+        publishControlState();
     }
 }
 
 void KeyboardEvent::handleFunctionKey(SDL_Scancode scancode) {
     if (scancode >= 58 && scancode <= 69) {
         activeFNIndex = scancode - 58;
-        if (activeFNIndex <= 8) {
-            currentFunction = "fn0" + std::to_string(activeFNIndex + 1);
-        } else if (activeFNIndex >= 9 && activeFNIndex < 12) {
-            currentFunction = "fn" + std::to_string(activeFNIndex + 1);
-        }
-        std::lock_guard<std::mutex> lock(newFunctionMutex);
-        newFunction = true;
+        publishControlState();
         if (verbose) {
-            printf("          KeyboardEvent::handleFunctionKeys::Setting New Function: %s.\n", currentFunction.c_str());
+            printf("          KeyboardEvent::handleFunctionKeys::Setting New Function: fn%02d.\n", activeFNIndex + 1);
             for (const auto& pair : pressedKeys) {
                 printf("         -Key: %d, Value: %d\n", pair.first, pair.second);
             }
@@ -231,9 +289,10 @@ void KeyboardEvent::handleKeypadControls(SDL_Scancode scancode) {
     } else if (scancode == 86) {
         removeLooper = keypadCtrlPressedKeys[scancode];
     }
+    publishControlState();
 }
 
-void KeyboardEvent::handleAlphaNumericKeyDown(SDL_Scancode scancode) {
+void KeyboardEvent::handleAlphaNumericKeyDown(SDL_Scancode scancode, Uint32 timestamp) {
     if (verbose) {
         printf("       KeyboardEvent::Keyboard Thread::Inside Handler.\n");
     }
@@ -241,16 +300,79 @@ void KeyboardEvent::handleAlphaNumericKeyDown(SDL_Scancode scancode) {
         if (verbose) {
             printf("       KeyboardEvent::handleKeyboardEvent::Codes to play construct: Code: %d\n", scancode);
         }
-        setScancodeData(scancode);
+        // activeFNIndex is only written on this thread, so the hit and its queued event
+        // both use the bank selected before it.
+        if (triggerHandler) {
+            triggerHandler(scancode, activeFNIndex + 1);
+        }
+        pushInputEvent(scancode, true, timestamp);
     }
 }
 
-void KeyboardEvent::clearScancodeData() {
-    std::lock_guard<std::mutex> lock(scancodeDataMutex);
-    if (verbose && superVerbose) {
-        printf("       KeyboardEvent::clearScancodeData.\n");
+void KeyboardEvent::processKeyDown(SDL_Scancode theCode, bool pressed, Uint32 timestamp) {
+    std::lock_guard<std::mutex> lock(pressedKeysMutex);
+    if (pressedKeys.find(theCode) != pressedKeys.end()) {
+        if (!pressedKeys[theCode]) {
+            pressedKeys[theCode] = pressed;
+            handleAlphaNumericKeyDown(theCode, timestamp);
+        }
+    } else if (keypadPressedKeys.find(theCode) != keypadPressedKeys.end()) {
+        if (!keypadPressedKeys[theCode]) {
+            keypadPressedKeys[theCode] = pressed;
+            handleKeypadKey(theCode);
+        }
+    } else if (keypadCtrlPressedKeys.find(theCode) != keypadCtrlPressedKeys.end()) {
+        if (!keypadCtrlPressedKeys[theCode]) {
+            keypadCtrlPressedKeys[theCode] = pressed;
+            handleKeypadControls(theCode);
+        }
+    } else if (functionPressedKeys.find(theCode) != functionPressedKeys.end()) {
+        if (!functionPressedKeys[theCode]) {
+            functionPressedKeys[theCode] = pressed;
+            handleFunctionKey(theCode);
+        }
+    }
+}
+
+void KeyboardEvent::processKeyUp(SDL_Scancode theCode, bool pressed, Uint32 timestamp) {
+    if (pressedKeys.find(theCode) != pressedKeys.end()) {
+        std::lock_guard<std::mutex> lock(pressedKeysMutex);
+        if (pressedKeys[theCode]) {
+            pressedKeys[theCode] = pressed;
+            pushInputEvent(theCode, false, timestamp);
+        }
+    } else if (keypadPressedKeys.find(theCode) != keypadPressedKeys.end()) {
+        if (keypadPressedKeys[theCode]) {
+            keypadPressedKeys[theCode] = pressed;
+            handleKeypadKey(theCode);
+        }
+    } else if (keypadCtrlPressedKeys.find(theCode) != keypadCtrlPressedKeys.end()) {
+        if (keypadCtrlPressedKeys[theCode]) {
+            keypadCtrlPressedKeys[theCode] = pressed;
+            handleKeypadControls(theCode);
+        }
+    } else if (functionPressedKeys.find(theCode) != functionPressedKeys.end()) {
+        if (functionPressedKeys[theCode]) {
+            functionPressedKeys[theCode] = pressed;
+            handleFunctionKey(theCode);
+        }
+    }
+}
+
+void KeyboardEvent::injectKeyEvent(SDL_Scancode scancode, bool down) {
+    if (down) {
+        processKeyDown(scancode, true, SDL_GetTicks());
+    } else {
+        processKeyUp(scancode, false, SDL_GetTicks());
+    }
+}
+
+void KeyboardEvent::recordKeyEvent(SDL_Scancode scancode, bool down) {
+    if (sessionRecorder != nullptr) {
+        Duration sinceStart = masterClock.getCurrentTime() - masterClock.getStartTime();
+        sessionRecorder->recordKeyEvent(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(sinceStart).count(), scancode, down);
     }
-    scancodeData.clear();
 }
 // THREAD SECTION
 // #################################################################################################
@@ -264,7 +386,7 @@ void KeyboardEvent::handleKeyboardEvent() {
     SDL_Event event;
     while (!quit || !stopFlag) {
         if (verbose && timeVerbose) {
-            masterClock.startTimer("KeyboardEvent", true);
+            masterClock.startTimer(keyboardProbe, true);
         }
 
         // while (SDL_PollEvent(&event)) {
@@ -281,53 +403,16 @@ void KeyboardEvent::handleKeyboardEvent() {
 
                 // Check if the scancode is a key in the pressedKeys map
                 if (event.key.repeat == 0) {
-                    std::lock_guard<std::mutex> lock(pressedKeysMutex);
-                    if (pressedKeys.find(theCode) != pressedKeys.end()) {
-                        if (!pressedKeys[theCode]) {
-                            pressedKeys[theCode] = currentKeyState[theCode] == SDL_PRESSED;;
-                            handleAlphaNumericKeyDown(theCode);
-                        }
-                    } else if (keypadPressedKeys.find(theCode) != keypadPressedKeys.end()) {
-                        if (!keypadPressedKeys[theCode]) {
-                            keypadPressedKeys[theCode] = currentKeyState[theCode] == SDL_PRESSED;;
-                            handleKeypadKey(theCode);
-                        }
-                    } else if (keypadCtrlPressedKeys.find(theCode) != keypadCtrlPressedKeys.end()) {
-                        if (!keypadCtrlPressedKeys[theCode]) {
-                            keypadCtrlPressedKeys[theCode] = currentKeyState[theCode] == SDL_PRESSED;;
-                            handleKeypadControls(theCode);
-                        }
-                    } else if (functionPressedKeys.find(theCode) != functionPressedKeys.end()) {
-                        if (!functionPressedKeys[theCode]) {
-                            functionPressedKeys[theCode] = currentKeyState[theCode] == SDL_PRESSED;;
-                            handleFunctionKey(theCode);
-                        }
-                    }
+                    recordKeyEvent(theCode, true);
+                    processKeyDown(theCode, currentKeyState[theCode] == SDL_PRESSED, event.key.timestamp);
                     break;
                 }
             case SDL_KEYUP:
                 // std::cout << "Keypad scancode " << theCode << std::endl;
-                if (pressedKeys.find(theCode) != pressedKeys.end()) {
-                    std::lock_guard<std::mutex> lock(pressedKeysMutex);
-                    if (pressedKeys[theCode]) {
-                        pressedKeys[theCode] = currentKeyState[theCode] == SDL_PRESSED;;
-                    }
-                } else if (keypadPressedKeys.find(theCode) != keypadPressedKeys.end()) {
-                    if (keypadPressedKeys[theCode]) {
-                        keypadPressedKeys[theCode] = currentKeyState[theCode] == SDL_PRESSED;;
-                        handleKeypadKey(theCode);
-                    }
-                } else if (keypadCtrlPressedKeys.find(theCode) != keypadCtrlPressedKeys.end()) {
-                    if (keypadCtrlPressedKeys[theCode]) {
-                        keypadCtrlPressedKeys[theCode]  = currentKeyState[theCode] == SDL_PRESSED;;
-                        handleKeypadControls(theCode);
-                    }
-                } else if (functionPressedKeys.find(theCode) != functionPressedKeys.end()) {
-                    if (functionPressedKeys[theCode]) {
-                        functionPressedKeys[theCode] = currentKeyState[theCode] == SDL_PRESSED;;
-                        handleFunctionKey(theCode);
-                    }
+                if (event.type == SDL_KEYUP) {
+                    recordKeyEvent(theCode, false);
                 }
+                processKeyUp(theCode, currentKeyState[theCode] == SDL_PRESSED, event.key.timestamp);
                 break;
             // Handle other event types if needed
             default:
@@ -336,8 +421,8 @@ void KeyboardEvent::handleKeyboardEvent() {
         // }
 
         if (verbose && timeVerbose) {
-            masterClock.startTimer("KeyboardEvent", false);
-            printf("        EventHandler Loop Complete::%s\n", masterClock.getDurationString("KeyboardEvent").c_str());
+            masterClock.startTimer(keyboardProbe, false);
+            printf("        EventHandler Loop Complete::%s\n", masterClock.getDurationString(keyboardProbe).c_str());
         }
     }
     printf("      KeyboardEvent::Event Loop Exited.\n");
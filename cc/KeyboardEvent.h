@@ -7,31 +7,70 @@
 #include <SDL2/SDL.h> // Include path for Linux
 #endif
 #include "MasterClock.h"
+#include "RingBuffer.h"
+#include "SessionRecorder.h"
 #include <atomic>
+#include <cstdint>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 #include <string>
 #include <mutex>
 #include <array>
+#include <functional>
+
+// A note key going down or up, as read by the input thread.
+struct InputEvent {
+    SDL_Scancode scancode;
+    bool down;
+    Uint32 sdlTimestamp;        // SDL event time, milliseconds since SDL_Init
+    uint64_t steadyNanoseconds; // steady clock when the input thread saw it
+    int bank;                   // function bank selected at the time, 1 = F1 .. 12 = F12
+};
+
+// Keypad and function key state as of one change on the input thread.
+struct ControlState {
+    uint16_t keypadLocks; // bit n set while KP(n + 1) is held
+    bool addLooper;       // KP+ held
+    bool removeLooper;    // KP- held
+    int functionNumber;   // bank of the last function key, 1 = F1 .. 12 = F12
+    uint32_t sequence;    // bumped by every change
+
+    // Lowest held keypad, 0..8, or -1.
+    int getLockedKeypad() const;
+};
 
 class KeyboardEvent {
 public:
+    // Called on the input thread for each note key press, with the function bank
+    // (1 = F1 .. 12 = F12) active at that moment.
+    typedef std::function<void(SDL_Scancode, int)> TriggerHandler;
+
     KeyboardEvent(MasterClock& mc, bool vb, bool timeVerbose, bool superVerbose);
 
     ~KeyboardEvent();
 
     void startHandlingEvents();
 
-    void clearScancodeData();
-    bool getKeypadStates(int keypadNumber);
+    // Wait-free from any thread: the whole state is published as one atomic word.
+    ControlState getControlState() const;
+    // Clock events for MasterClock::addEventHandler. The input event is signalled for
+    // every key event pushed and runs its handlers on the next division; the control
+    // event is signalled on every control state change and runs them straight away.
+    MasterClock::EventId getInputEventId() const;
+    MasterClock::EventId getControlEventId() const;
 
-    bool isScancodeDataEmpty();
-    const std::unordered_set<SDL_Scancode>& getScancodeData();
+    // Note key events in the order they happened, for one consumer at a time
+    // (the division task). Never blocks; false once the ring is empty.
+    bool popInputEvent(InputEvent& event);
     void handleKeyboardEvent();
     void stopHandlingEvents();
-    void functionFetchReset();
-    std::string getFunctionState();
+
+    // Feeds a key transition through the same handlers as a live SDL event;
+    // used to replay a recorded session without a keyboard thread.
+    void injectKeyEvent(SDL_Scancode scancode, bool down);
+    void setSessionRecorder(SessionRecorder* recorder);
+    // Set before startHandlingEvents(); key presses still reach popInputEvent for the grid.
+    void setTriggerHandler(TriggerHandler handler);
 
 private:
     bool verbose;
@@ -42,34 +81,48 @@ private:
     std::unordered_map<SDL_Scancode, bool> keypadPressedKeys;
     std::unordered_map<SDL_Scancode, bool> keypadCtrlPressedKeys;
     std::unordered_map<SDL_Scancode, bool> functionPressedKeys;
-    std::unordered_set<SDL_Scancode> scancodeData;
     std::mutex keypadPressedKeysMutex;
-    std::mutex isKeypadLockedMutex;
-    std::mutex newFunctionMutex;
     std::mutex pressedKeysMutex;
     std::mutex keyboardMutex;
-    std::mutex scancodeDataMutex;
+    // Written only by the input thread, or by injectKeyEvent when there is none.
+    SPSCRingBuffer<InputEvent> inputEvents;
+    std::atomic<uint64_t> pushedEventCount;
+    std::atomic<uint64_t> droppedEventCount; // the consumer fell a whole ring behind
+    std::atomic<uint64_t> eventWaitNanoseconds; // pushed to popped, summed
+    std::atomic<uint64_t> maxEventWaitNanoseconds;
+    std::atomic<uint64_t> poppedEventCount;
     std::condition_variable keyboardCV;
     std::atomic<bool> stopFlag = ATOMIC_VAR_INIT(false);
     std::thread keyboardThread;
-    bool isKPLocked[9] = {false};
-    bool keypadLockStates[10] = {false};
+    // Input thread only; every change is published through controlState.
+    uint16_t keypadLocks;
     bool addLooper;
     bool removeLooper;
     bool logging;
-    bool newFunction;
     bool quit;
     int activeFNIndex;
-    std::string currentFunction;
+    uint32_t controlSequence;
+    std::atomic<uint64_t> controlState;
+    // Registered with masterClock in the constructor, so declared after it.
+    MasterClock::EventId inputEventId;
+    MasterClock::EventId controlEventId;
+    ProbeId keyboardProbe;
+    SessionRecorder* sessionRecorder;
+    TriggerHandler triggerHandler;
 
+    void processKeyDown(SDL_Scancode scancode, bool pressed, Uint32 timestamp);
+    void processKeyUp(SDL_Scancode scancode, bool pressed, Uint32 timestamp);
+    void recordKeyEvent(SDL_Scancode scancode, bool down);
     void handleKeypadKey(SDL_Scancode scancode);
-    void handleAlphaNumericKeyDown(SDL_Scancode scancode);
+    void handleAlphaNumericKeyDown(SDL_Scancode scancode, Uint32 timestamp);
     void handleKeypadControls(SDL_Scancode scancode);
     void handleFunctionKey(SDL_Scancode scancode);
     bool isKeypadKey(SDL_Scancode scancode);
     bool isKeypadControlKey(SDL_Scancode scancode);
     bool isFunctionControlKey(SDL_Scancode scancode);
-    void setScancodeData(SDL_Scancode scancode);
+    void pushInputEvent(SDL_Scancode scancode, bool down, Uint32 timestamp);
+    void publishControlState();
+    void printReport() const;
     void initPressedKeysMap();
     void initKeypadPressedKeysMap();
     void initKeypadCtrlPressedKeysMap();
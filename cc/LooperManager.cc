@@ -6,14 +6,12 @@
 #include <algorithm>
 #include <unordered_set>
 
-LooperManager::LooperManager(MasterClock& mc, KeyboardEvent& kb, 
-    const std::unordered_map<std::string, std::pair<bool*, double>>& stringBoolPairs,
+LooperManager::LooperManager(MasterClock& mc, KeyboardEvent& kb,
     const YAML::Node& looperVerbosity,  bool superVerbose, bool timeVerbose) :
     masterClock(mc), keyboardEvent(kb),
     audioLooperVerbose(looperVerbosity["audioLooperVerbose"].as<bool>()),
     verbose(looperVerbosity["looperManagerVerbose"].as<bool>()), superVerbose(superVerbose), timeVerbose(timeVerbose), 
-    stringBoolPairs(stringBoolPairs),
-    addLooper(false), removeLooper(false), runAudioLooperThread(false){
+    runAudioLooperThread(false){
     if (verbose) {
         printf("   LooperManager::LooperManager::Constructed.\n");
     }
@@ -21,18 +19,14 @@ LooperManager::LooperManager(MasterClock& mc, KeyboardEvent& kb,
 
 LooperManager::~LooperManager() {
 }
-// Getter/Setter Function SECTION
-// #################################################################################################
-void LooperManager::setRemoveLooper(bool removeState) {
-    removeLooper = removeState;
-}
 // Thread Managment SECTION
 // #################################################################################################
 void LooperManager::scheduleLooperTask() {
     if (verbose) {
         printf("      LooperManager::scheduleLooperTask::Starting Audio Looper Task.\n");
     }
-    masterClock.setRuntimeTasks([&]() {
+    // Runs when a keypad, KP+ or KP- changes rather than on every division.
+    masterClock.addEventHandler(keyboardEvent.getControlEventId(), [&]() {
         this->audioLooperTask(); // Call the function you want to execute
     });
     
@@ -41,29 +35,30 @@ void LooperManager::scheduleLooperTask() {
 // Audio Looper Section
 //###################################################################################################################
 void LooperManager::audioLooperTask() {
-    if (!audioLoopers.empty() && removeLooper) {
+    if (audioLoopers.empty()) {
+        return;
+    }
+    ControlState controlState = keyboardEvent.getControlState();
+    if (controlState.removeLooper) {
         if (verbose) {
             printf("      LooperManager::audioLooperTask::Entered.\n");
         }
-        std::string keypadIDStringToRemove;
-        
-        // Find the keypadIDString that needs to be removed using std::find_if
-        auto foundPair = std::find_if(stringBoolPairs.begin(), stringBoolPairs.end(),
-            [](const auto& pair) {
-                if (pair.second.first) { // Check if the pointer is valid
-                    return *pair.second.first;
-                }
-                return false;
-            });
-            
-        if (foundPair != stringBoolPairs.end()) {
-            keypadIDStringToRemove = foundPair->first;
-        
-            // Remove all loopers with the specified keypadIDString
-            removeAudioLoopers(keypadIDStringToRemove);
+        // KP- removes the loopers of the lowest held keypad.
+        int keypad = controlState.getLockedKeypad();
+        if (keypad >= 0) {
+            removeAudioLoopers("KP" + std::to_string(keypad + 1));
+        }
+    }
+}
+
+void LooperManager::removeAllLoopers() {
+    for (auto& looper : keypadIDToLoopers) {
+        if (looper.second->checkIfLooping()) {
+            looper.second->stopLoop();
         }
-        removeLooper = false;
     }
+    keypadIDToLoopers.clear();
+    audioLoopers.clear();
 }
 
 void LooperManager::removeAudioLoopers(const std::string& keypadIDStr) {
@@ -78,7 +73,7 @@ void LooperManager::removeAudioLoopers(const std::string& keypadIDStr) {
     audioLoopers.erase(keypadIDStr);
 }
 
-bool LooperManager::addAudioLooper(const std::string& keypadIDStr, AudioPlayer* player, double loopDuration) {
+bool LooperManager::addAudioLooper(const std::string& keypadIDStr, std::shared_ptr<AudioPlayer> player, double loopDuration) {
     if (verbose) {
         printf("      LooperManager::addAudioLooper::Looper ID: %s\n", keypadIDStr.c_str());
         printf("      LooperManager::addAudioLooper::Looper Duration %f.\n", loopDuration);
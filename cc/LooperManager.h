@@ -18,14 +18,14 @@ struct AudioLooperInfo {
 class LooperManager {
     public:
         LooperManager(MasterClock& mc, KeyboardEvent& kb,
-        const std::unordered_map<std::string, std::pair<bool*, double>>& stringBoolPairs,
         const YAML::Node& verbosity, bool superVerbose, bool timeVerbose);
         ~LooperManager();
         void audioLooperTask();
-        bool addAudioLooper(const std::string& keypadIDStr, AudioPlayer* player, double loopDuration);
+        bool addAudioLooper(const std::string& keypadIDStr, std::shared_ptr<AudioPlayer> player, double loopDuration);
+        // Stops every loop and releases their players, e.g. before shutdown.
+        void removeAllLoopers();
         void loopSetter();
         void scheduleLooperTask();
-        void setRemoveLooper(bool removeState);
 
     private:
         void removeAudioLoopers(const std::string& keypadIDStr);
@@ -36,13 +36,10 @@ class LooperManager {
         bool superVerbose;
         bool timeVerbose;
         bool audioLooperVerbose;
-        bool addLooper;
-        bool removeLooper;
         bool runAudioLooperThread;
 
         std::unordered_multimap<std::string, AudioLooperInfo> audioLoopers;
         std::unordered_multimap<std::string, std::shared_ptr<AudioLooper>> keypadIDToLoopers;
-        const std::unordered_map<std::string, std::pair<bool*, double>>& stringBoolPairs;
 };
 
 #endif // LOOPER_MANAGER_H
\ No newline at end of file
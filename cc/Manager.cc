@@ -4,24 +4,28 @@
 #include <vector>
 #include <mutex>
 #include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <unordered_set>
 
 Manager::Manager(MasterClock& mc,
-    const std::unordered_map<std::string, std::pair<bool*, double>>& stringBoolPairs,
+    const KeypadLoopDurations& loopDurations,
     const YAML::Node& verbosity,
     const YAML::Node& notesConfig, const YAML::Node& windowConfig,
     const YAML::Node& audioMixerConfig,
-    bool sV, bool tV) :
-    masterClock(mc), currentFunction("FN10"),
-    verbose(verbosity["managerVerbose"].as<bool>()),
-    stringBoolPairs(stringBoolPairs), notesConfig(notesConfig),
+    bool sV, bool tV, bool liveInput) :
+    masterClock(mc),
     keyboardEvent(masterClock, verbosity["keyboardEventVerbose"].as<bool>(), tV, sV),
-    looperManager(masterClock, keyboardEvent, stringBoolPairs,
+    looperManager(masterClock, keyboardEvent,
         verbosity["looperVerbosity"], sV, tV),
     graphicManager(verbosity["graphicVerbosity"], sV, tV,
          masterClock, windowConfig),
     audioManager(masterClock, keyboardEvent, looperManager,
-        stringBoolPairs, verbosity["audioVerbosity"], audioMixerConfig, sV) {
+        loopDurations, verbosity["audioVerbosity"], audioMixerConfig, sV),
+    verbose(verbosity["managerVerbose"].as<bool>()),
+    currentFunctionNumber(0), appliedControlSequence(UINT32_MAX),
+    loopDurations(loopDurations), notesConfig(notesConfig) {
     if (verbose) {
         printf("   Manager::Constructor Entered.\n");
     }
@@ -29,7 +33,9 @@ Manager::Manager(MasterClock& mc,
     mixerBufferSize = audioMixerConfig["mixer_buffer_size"].as<int>();
     scheduleAudioLooperTask();
     scheduleAudioPlaybackTask();
-    startKeyboardThread();
+    if (liveInput) {
+        startKeyboardThread();
+    }
     scheduleupdateStates();
     // startAnimationThread();
     if (verbose) {
@@ -46,6 +52,8 @@ void Manager::joinManagerThread() {
     keyboardEvent.stopHandlingEvents();
     graphicManager.stopAnimationWindow();
     printf("   Manager::joinManagerThread::KeyboardEventThread Down.\n");
+    // Loopers share players with the sample banks; stop them before the banks are cleared.
+    looperManager.removeAllLoopers();
     audioManager.unschedulePlayback();
     printf("   Manager::joinManagerThread::unschedulePlayback Done.\n");
 }
@@ -56,49 +64,99 @@ void Manager::setNotesConfig() {
     if (verbose) {
         printf("   Manager::setNotesConfig::Entered.\n");
     }
+    std::vector<NoteSample> notes;
     for (const auto& note : notesConfig) {
-        NoteConfiguration config;
-        config.noteName = note.first.as<std::string>();
         const YAML::Node& noteConfig = note.second;
-        std::string filepath = noteConfig["filepath"].as<std::string>();
+        if (noteConfig["zones"]) {
+            addInstrumentNotes(note.first.as<std::string>(), noteConfig, notes);
+            continue;
+        }
+        NoteSample sample;
+        NoteConfiguration& config = sample.config;
+        config.noteName = note.first.as<std::string>();
+        sample.filepath = noteConfig["filepath"].as<std::string>();
         config.keycode = static_cast<SDL_Scancode>(noteConfig["keycode"].as<int>());
         config.functionAssignment = noteConfig["fnNumber"].as<std::string>();
-        audioManager.addAudioPlayer(filepath.c_str(), config);
+        config.polyphony = noteConfig["polyphony"].as<int>(0);
+        config.chokeGroup = noteConfig["choke_group"].as<std::string>("");
+        config.semitones = noteConfig["semitones"].as<double>(0.0);
+        notes.push_back(sample);
     }
+    // The YAML nodes are only read here; decoding runs on the loader threads.
+    audioManager.addAudioPlayers(notes);
 }
 
-void Manager::setFunction() {
-    bool didChangeLock = false;
-    std::string updatedFunction = keyboardEvent.getFunctionState();
-
-    if (!(currentFunction == updatedFunction)) {
-        didChangeLock = true;
-        currentFunction = updatedFunction;
+void Manager::addInstrumentNotes(const std::string& instrumentName, const YAML::Node& instrumentConfig,
+    std::vector<NoteSample>& notes) {
+    // zones are the recorded samples and the semitone each was played at; every key
+    // plays the nearest zone, preferring the one above so ties are pitched down.
+    std::vector<std::pair<int, std::string>> zones;
+    for (const auto& zone : instrumentConfig["zones"]) {
+        zones.emplace_back(zone["semitone"].as<int>(), zone["filepath"].as<std::string>());
     }
-    if (didChangeLock) {
-        audioManager.setCurrentFunction(currentFunction);
-        keyboardEvent.functionFetchReset();
+    if (zones.empty() || !instrumentConfig["keys"]) {
+        printf("   ---Manager::addInstrumentNotes::%s needs zones and keys, skipped.\n", instrumentName.c_str());
+        return;
     }
-}
-
-void Manager::updateStates() {
-    for (int index = 1; index <= 9; index++) {
-        std::string key = "KP" + std::to_string(index);
-        auto it = stringBoolPairs.find(key);
-        if (it != stringBoolPairs.end()) {
-            *(it->second.first) = keyboardEvent.getKeypadStates(index - 1);
+    for (const auto& key : instrumentConfig["keys"]) {
+        int keycode = key.first.as<int>();
+        int semitone = key.second.as<int>();
+        const std::pair<int, std::string>* nearest = &zones.front();
+        for (const auto& zone : zones) {
+            int distance = std::abs(semitone - zone.first);
+            int nearestDistance = std::abs(semitone - nearest->first);
+            if (distance < nearestDistance || (distance == nearestDistance && zone.first > nearest->first)) {
+                nearest = &zone;
+            }
         }
+        NoteSample sample;
+        NoteConfiguration& config = sample.config;
+        config.noteName = instrumentName + "_" + std::to_string(keycode);
+        sample.filepath = nearest->second;
+        config.keycode = static_cast<SDL_Scancode>(keycode);
+        config.functionAssignment = instrumentConfig["fnNumber"].as<std::string>();
+        config.polyphony = instrumentConfig["polyphony"].as<int>(0);
+        config.chokeGroup = instrumentConfig["choke_group"].as<std::string>("");
+        config.semitones = semitone - nearest->first;
+        notes.push_back(sample);
+    }
+    if (verbose) {
+        printf("   Manager::addInstrumentNotes::%s: %zu keys from %zu zones.\n", instrumentName.c_str(),
+            instrumentConfig["keys"].size(), zones.size());
     }
-    if (keyboardEvent.getKeypadStates(-1)) {
-        audioManager.setKeypadReady(keyboardEvent.getKeypadStates(-1));
-    } else {
-        audioManager.setKeypadReady(false);
+}
+
+void Manager::setFunction(int functionNumber) {
+    if (functionNumber == currentFunctionNumber) {
+        return;
     }
+    currentFunctionNumber = functionNumber;
+    char function[8];
+    snprintf(function, sizeof(function), "fn%02d", functionNumber);
+    audioManager.setCurrentFunction(function);
+}
+
+void Manager::injectKeyEvent(SDL_Scancode scancode, bool down) {
+    keyboardEvent.injectKeyEvent(scancode, down);
+}
 
-    if (keyboardEvent.getKeypadStates(-2)) {
-        looperManager.setRemoveLooper(keyboardEvent.getKeypadStates(-2));
+void Manager::setOfflineMixer(OfflineMixer* mixer) {
+    audioManager.setOfflineMixer(mixer);
+}
+
+void Manager::setSessionRecorder(SessionRecorder* recorder) {
+    keyboardEvent.setSessionRecorder(recorder);
+}
+
+void Manager::updateStates() {
+    // Keypad and looper keys are read from the snapshot by the tasks that use them;
+    // only a function key change needs acting on here.
+    ControlState controlState = keyboardEvent.getControlState();
+    if (controlState.sequence == appliedControlSequence) {
+        return;
     }
-    setFunction();
+    appliedControlSequence = controlState.sequence;
+    setFunction(controlState.functionNumber);
 }
 // Manager Thread Section
 //###################################################################################################################
@@ -134,8 +192,8 @@ void Manager::scheduleupdateStates() {
     if (verbose) {
         printf("   Manager::scheduleupdateStates.\n");
     }
-    masterClock.setRuntimeTasks([&]() {
+    masterClock.addEventHandler(keyboardEvent.getControlEventId(), [&]() {
         this->updateStates(); 
-    });
+    }, ActionPriority::Low);
 }
 
@@ -23,20 +23,29 @@ typedef float Sample;
 class Manager {
     public:
         Manager(MasterClock& mc,
-            const std::unordered_map<std::string, std::pair<bool*, double>>& stringBoolPairs,
+            const KeypadLoopDurations& loopDurations,
             const YAML::Node& verbosity,
             const YAML::Node& notesConfig, const YAML::Node& windowConfig,
             const YAML::Node& audioMixerConfig,
-            bool sV, bool tV);
+            bool sV, bool tV, bool liveInput = true);
         ~Manager();
 
         void joinManagerThread();
         void updateStates();
-        void setFunction();
+        void setFunction(int functionNumber);
+
+        // Offline rendering: input comes from a recorded session and audio
+        // goes to a file instead of the keyboard thread and the sound card.
+        void injectKeyEvent(SDL_Scancode scancode, bool down);
+        void setOfflineMixer(OfflineMixer* mixer);
+        void setSessionRecorder(SessionRecorder* recorder);
         
     private:
         // functions
         void setNotesConfig();
+        // Expands an instrument entry (zones + keys) into one note per key.
+        void addInstrumentNotes(const std::string& instrumentName, const YAML::Node& instrumentConfig,
+            std::vector<NoteSample>& notes);
         void scheduleupdateStates();
         void scheduleAudioLooperTask();
         void scheduleAudioPlaybackTask();
@@ -55,10 +64,11 @@ class Manager {
         bool superVerbose;
         bool timeVerbose;
         int mixerBufferSize;
-        std::string currentFunction;
+        int currentFunctionNumber;
+        uint32_t appliedControlSequence;
         
         // Structures
-        const std::unordered_map<std::string, std::pair<bool*, double>>& stringBoolPairs;
+        const KeypadLoopDurations& loopDurations;
         const YAML::Node& notesConfig;
 };
 
@@ -1,21 +1,47 @@
 #include "MasterClock.h"
-#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <thread>
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <regex>
+#include <utility>
 
 // Define and initialize the static members
 bool MasterClock::verbose = false;
 bool MasterClock::superVerbose = false;
 bool MasterClock::timeVerbose = false;
+const MasterClock::EventId MasterClock::invalidEvent;
+const size_t MasterClock::maxReportedBatches;
+thread_local const MasterClock* MasterClock::runningClock = nullptr;
+
+namespace {
+int64_t toWakeTicks(TimePoint timePoint) {
+    return timePoint.time_since_epoch().count();
+}
+
+// Lowers target to value; true if this call lowered it.
+bool lowerWakeTicks(std::atomic<int64_t>& target, int64_t value) {
+    int64_t current = target.load();
+    while (value < current) {
+        if (target.compare_exchange_weak(current, value)) {
+            return true;
+        }
+    }
+    return false;
+}
+}
 
 MasterClock::MasterClock(double bpm, double beatDivisions, bool vb, bool sVb, bool timeVerbose) : quit(false), 
     isNoteDataReady(false), logging(false), bufferUpdated(false), filename("duration_logs"),
     divisionDurationAsDuration(Duration(0)),
     timeCorrectionForBuffer(Duration(0)), processingDuration(Duration(0)),
-    currentDivisionOfBeat(0)
+    deadlineTolerance(std::chrono::milliseconds(1)), scheduleCommands(1024), completedBatches(4096),
+    clockSource(nullptr), workerThreadCount(2), workerRealtimePriority(0), overrunCount(0), lateStartCount(0),
+    eventCount(0), divisionEvents(0), signalledEvents(0), eventsInFlight(false), nextEventDivision(TimePoint::max()),
+    signalCount(0), eventDispatchCount(0), armedWakeTime(toWakeTicks(TimePoint::min())),
+    requestedWakeTime(toWakeTicks(TimePoint::max())), tickCount(0), totalProcessingTicks(0)
     {
     startTime = getCurrentTime();
     std::time_t startTimeTimeT = std::chrono::high_resolution_clock::to_time_t(startTime);
@@ -27,14 +53,14 @@ MasterClock::MasterClock(double bpm, double beatDivisions, bool vb, bool sVb, bo
 
     // Convert the ostringstream to a string
     std::string formattedTime = timeFormat.str();
-    filename = filename + "_" + formattedTime + ".txt";
+    filename = filename + "_" + formattedTime + ".bin";
     setVerboseStatus(vb, sVb, timeVerbose);
+    scheduleProbe = registerProbe("ScheduleThreadProcess");
     this->setBPM(bpm);
     this->beatDivisions = beatDivisions;
-    std::string logMessage = "MasterClock::MasterClock::Setup:\n";
-    logMessage += "  BPM: " + std::to_string(bpm) + "\n";
-    logMessage += "  Divisions: " + std::to_string(beatDivisions) + "\n";
-    writeStringToFile(logMessage);
+    int64_t startTimeSinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    durationLogger.start(filename, bpm, beatDivisions, startTimeSinceEpoch);
     if (verbose) {
         printf("   MasterClock::masterClock::Constructred\n");
     }
@@ -42,15 +68,29 @@ MasterClock::MasterClock(double bpm, double beatDivisions, bool vb, bool sVb, bo
 
 MasterClock::~MasterClock(){
     stop();
+    // Join the workers while the scheduler and its mutex are still alive.
+    workerPool.reset();
 }
 // Start/Stop Section
 //###################################################################################################################
 void MasterClock::start() {
     divisionDurationAsDuration = calculateDivisionDuration();
+    initTimePointQueue();
+    if (workerThreadCount > 0 && !workerPool && clockSource == nullptr) {
+        int priority = workerRealtimePriority;
+        workerPool.reset(new ThreadPool(workerThreadCount, [priority](size_t) {
+            PrecisionWait::setRealtimePriority(priority, verbose);
+        }));
+    }
+    if (verbose) {
+        printf("   MasterClock::start::Worker Threads: %zu.\n", workerThreadCount);
+    }
 }
 
 void MasterClock::stop() {
     quit.store(true, std::memory_order_release);  // Signal the timer thread to quit
+    precisionWait.interrupt(); // it may be asleep with nothing scheduled
+    durationLogger.stop();
 }
 // Getter/Setter Section
 //###################################################################################################################
@@ -71,13 +111,22 @@ double MasterClock::getBPM() const {
 }
 
 int MasterClock::getCurrentDivisonOfBeat() {
-    return currentDivisionOfBeat;
+    // Worked out from the time, since the clock no longer wakes on every division.
+    int64_t divisionsPerBeat = std::max<int64_t>(1, std::llround(beatDivisions));
+    return static_cast<int>(getNearestDivisionIndex(getCurrentTime()) % divisionsPerBeat);
 }
 
 TimePoint MasterClock::getCurrentTime() const {
+    if (clockSource != nullptr) {
+        return clockSource->now();
+    }
     return std::chrono::high_resolution_clock::now();
 }
 
+void MasterClock::setClockSource(ClockSource* source) {
+    clockSource = source;
+}
+
 Duration MasterClock::fetchDivisionDurationAsDuration() const {
     return divisionDurationAsDuration;
 }
@@ -86,9 +135,21 @@ double MasterClock::getBeatDivisions() const {
     return beatDivisions;
 }
 
-// TimePoint MasterClock::getStartTime() const {
-//     return startTime;
-// }
+TimePoint MasterClock::getStartTime() const {
+    return startTime;
+}
+
+TimePoint MasterClock::getDivisionTimePoint(int64_t index) const {
+    return startTime + divisionDurationAsDuration * index;
+}
+
+int64_t MasterClock::getNearestDivisionIndex(TimePoint timePoint) const {
+    if (divisionDurationAsDuration.count() <= 0) {
+        return 0;
+    }
+    Duration sinceStart = timePoint - startTime;
+    return (sinceStart + divisionDurationAsDuration / 2) / divisionDurationAsDuration;
+}
 
 Duration MasterClock::calculateDivisionDuration() const {
     // Calculate the duration of one beat based on the BPM
@@ -104,16 +165,50 @@ Duration MasterClock::calculateDivisionDuration() const {
     return duration;
 }
 
-void MasterClock::writeStringToFile(const std::string& content) {
-    std::ofstream outputFile(filename, std::ios_base::app);
-    if (outputFile.is_open()) {
-        outputFile << content;
-        outputFile.close(); // Close the file
-    } else {
-        std::cerr << "Error opening file for writing!" << std::endl;
+void MasterClock::setClockConfig(const YAML::Node& clockConfig) {
+    if (!clockConfig) {
+        return;
+    }
+    WaitMode waitMode = PrecisionWait::parseWaitMode(clockConfig["wait_mode"].as<std::string>("sleep"));
+    precisionWait.configure(waitMode,
+        clockConfig["spin_yield"].as<bool>(true),
+        clockConfig["realtime_priority"].as<int>(0),
+        clockConfig["cpu_core"].as<int>(-1),
+        clockConfig["calibration_samples"].as<int>(100));
+    workerThreadCount = static_cast<size_t>(std::max(0, clockConfig["worker_threads"].as<int>(2)));
+    workerRealtimePriority = clockConfig["worker_realtime_priority"].as<int>(0);
+    deadlineTolerance = std::chrono::microseconds(clockConfig["deadline_tolerance_us"].as<int>(1000));
+    if (verbose) {
+        printf("   MasterClock::setClockConfig::Wait Mode: %s.\n", PrecisionWait::getWaitModeName(waitMode));
+    }
+}
+// Beat Grid Section
+//###################################################################################################################
+void MasterClock::initTimePointQueue() {
+    // Every execution time is derived from this origin, so wakeup lateness
+    // never accumulates and loops launched on the same grid stay phase-locked.
+    startTime = getCurrentTime();
+    if (verbose) {
+        printf("   MasterClock::initTimePointQueue::Grid Division: %lld ns.\n",
+            static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(divisionDurationAsDuration).count()));
     }
 }
 
+TimePoint MasterClock::advanceBatchOnGrid(BatchActions& batch, TimePoint currentTime) const {
+    // execution time = anchor + iteration * interval, computed from integers
+    // rather than by adding the interval to the (late) wakeup time.
+    Duration interval = batch.getDuration();
+    int64_t nextIteration = batch.getIteration() + 1;
+    TimePoint nextExecutionTime = batch.getAnchorTime() + interval * nextIteration;
+    if (nextExecutionTime <= currentTime) {
+        // The clock fell behind by more than one interval; skip the missed
+        // hits instead of firing them in a burst, but stay on the grid.
+        nextIteration = (currentTime - batch.getAnchorTime()) / interval + 1;
+        nextExecutionTime = batch.getAnchorTime() + interval * nextIteration;
+    }
+    batch.setIteration(nextIteration);
+    return nextExecutionTime;
+}
 // Scheduler Section
 //###################################################################################################################
 bool MasterClock::containsBatchActions(const std::string& idTag) const {
@@ -121,182 +216,482 @@ bool MasterClock::containsBatchActions(const std::string& idTag) const {
 }
 
 void MasterClock::removeBatchFromQueue(const std::string& idTag) {
-    std::lock_guard<std::mutex> lock(scheduledIntervalsMutex);
+    {
+        std::lock_guard<std::mutex> lock(scheduledTagsMutex);
+        scheduledTags.erase(idTag);
+    }
+    ScheduleCommand command;
+    command.type = ScheduleCommandType::Remove;
+    command.idTag = idTag;
+    postCommand(std::move(command));
+}
 
-    auto it = std::find_if(scheduledActionBatches.begin(), scheduledActionBatches.end(),
-                            [&idTag](const BatchActions& batch) { return batch.getIDTag() == idTag; });
+bool MasterClock::searchBatchActions(const std::string& idTag) const {
+    // Answered from the tags recorded when commands were posted, so callers
+    // see their own add/remove immediately, before the clock applies it.
+    std::lock_guard<std::mutex> lock(scheduledTagsMutex);
+    auto it = scheduledTags.find(idTag);
+    if (it == scheduledTags.end()) {
+        return false;
+    }
+    return it->second.isLooping || getCurrentTime() <= it->second.lastExecutionTime;
+}
 
-    if (it != scheduledActionBatches.end()) {
-        size_t indexToRemove = std::distance(scheduledActionBatches.begin(), it);
-        idTagToBatchIndex.erase(idTag);
+void MasterClock::postCommand(ScheduleCommand command) {
+    // The clock applies commands before it dispatches, so a removal never needs an
+    // early wake and an add only needs one if it falls due before the armed deadline.
+    TimePoint wakeTime = TimePoint::max();
+    if (command.type == ScheduleCommandType::Add) {
+        wakeTime = command.anchorTime + command.interval;
+    } else if (command.type == ScheduleCommandType::AddHandler) {
+        wakeTime = getCurrentTime();
+    }
+    if (runningClock == this) {
+        // An inline batch or handler: nobody else drains the queue, so a full one spills to
+        // overflowCommands, and later posts queue behind the spill to keep their order.
+        if (!overflowCommands.empty() || !scheduleCommands.push(std::move(command))) {
+            overflowCommands.push_back(std::move(command));
+        }
+    } else {
+        while (!scheduleCommands.push(std::move(command))) {
+            // Mutators wait for the clock to drain, never the other way round. A busy clock
+            // drains at its next hit; only one idle for longer is woken to make room.
+            wakeClock(getCurrentTime() + divisionDurationAsDuration);
+            std::this_thread::yield();
+        }
+    }
+    if (wakeTime != TimePoint::max()) {
+        wakeClock(wakeTime);
+    }
+}
+
+void MasterClock::wakeClock(TimePoint wakeTime) {
+    int64_t wakeTicks = toWakeTicks(wakeTime);
+    // Only the post that lowers the request interrupts; later ones ride on its wakeup.
+    if (!lowerWakeTicks(requestedWakeTime, wakeTicks)) {
+        return;
+    }
+    // Sequentially consistent with armWakeTime: either this sees the armed deadline,
+    // or the clock sees the request before it starts waiting.
+    if (clockSource == nullptr && wakeTicks < armedWakeTime.load()) {
+        precisionWait.interrupt();
+    }
+}
+
+TimePoint MasterClock::armWakeTime(TimePoint deadline) {
+    armedWakeTime.store(toWakeTicks(deadline));
+    // Posts made while the clock was awake did not interrupt it; honour them here.
+    return std::min(deadline, TimePoint(Duration(requestedWakeTime.load())));
+}
 
-        scheduledActionBatches.erase(it);
+void MasterClock::applyScheduleCommands() {
+    // Bounded so producers that keep posting cannot hold the clock in here.
+    size_t budget = scheduleCommands.capacity();
+    ScheduleCommand command;
+    while (budget-- > 0 && scheduleCommands.pop(command)) {
+        applyScheduleCommand(command);
+    }
+    // Spilled after everything the clock thread had already queued, which the budget covers.
+    for (ScheduleCommand& overflowCommand : overflowCommands) {
+        applyScheduleCommand(overflowCommand);
+    }
+    overflowCommands.clear();
+}
+
+void MasterClock::applyScheduleCommand(ScheduleCommand& command) {
+    switch (command.type) {
+        case ScheduleCommandType::Add:
+            applyAddCommand(command);
+            break;
+        case ScheduleCommandType::Remove:
+            batchScheduler.cancelBatch(batchScheduler.findHandle(command.idTag));
+            break;
+        case ScheduleCommandType::AddHandler:
+            eventHandlers.push_back(EventHandler{command.event, command.priority, std::move(command.function)});
+            signalledEvents.fetch_or(1u << command.event, std::memory_order_acq_rel);
+            break;
+    }
+}
+
+bool MasterClock::dispatchDueBatch(TimePoint currentTime, uint32_t& logTagInUse) {
+    size_t handle = batchScheduler.popDueBatch(currentTime);
+    if (handle == BatchScheduler::invalidHandle) {
+        return false;
+    }
+    BatchActions* batch = &batchScheduler.getBatch(handle);
+    if (batch->getLoopingFlag()) {
+        logTagInUse = batch->getLogTagId();
+    }
+    TimePoint deadline = batch->getExecutionTime();
+    TimePoint nextExecutionTime = advanceBatchOnGrid(*batch, currentTime);
+    if (batch->isInFlight()) {
+        // The previous run is still going. Skip this hit instead of
+        // stacking a second copy of the batch behind it.
+        batch->recordDeadlineMiss();
+        overrunCount.fetch_add(1, std::memory_order_relaxed);
+        batchScheduler.finishBatch(handle, nextExecutionTime);
+        return true;
+    }
+    batch->markDispatched(deadline);
+    bool highPriority = batch->getPriority() == ActionPriority::High;
+    batchScheduler.finishBatch(handle, nextExecutionTime);
+    if (workerPool) {
+        workerPool->enqueue([this, batch, handle]() {
+            runBatch(batch, handle);
+        }, highPriority);
+    } else {
+        runBatch(batch, handle);
+    }
+    return true;
+}
+
+void MasterClock::runBatch(BatchActions* batch, size_t handle) {
+    // The slot cannot be reused while the batch is in flight, so the pointer
+    // stays valid while a worker runs it.
+    if (getCurrentTime() - batch->getDispatchDeadline() > deadlineTolerance) {
+        batch->recordDeadlineMiss();
+        lateStartCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    batch->executeBatch();
+    if (!workerPool) {
+        batchScheduler.completeBatch(handle);
+        return;
+    }
+    while (!completedBatches.push(std::move(handle))) {
+        std::this_thread::yield();
+    }
+}
+
+void MasterClock::applyCompletedBatches() {
+    size_t handle;
+    while (completedBatches.pop(handle)) {
+        batchScheduler.completeBatch(handle);
+    }
+}
+
+Duration MasterClock::getWakeupErrorPercentile(double percentile) const {
+    return precisionWait.getWakeupErrorPercentile(percentile);
+}
 
-        // Update the indices in idTagToBatchIndex for the remaining batches
-        for (size_t i = indexToRemove; i < scheduledActionBatches.size(); ++i) {
-            idTagToBatchIndex[scheduledActionBatches[i].getIDTag()] = i;
+Duration MasterClock::getMaxWakeupError() const {
+    return precisionWait.getMaxWakeupError();
+}
+
+uint64_t MasterClock::getWakeupCount() const {
+    return precisionWait.getWakeupCount();
+}
+
+uint64_t MasterClock::getInterruptedWakeupCount() const {
+    return precisionWait.getInterruptedWakeupCount();
+}
+
+uint64_t MasterClock::getTickCount() const {
+    return tickCount.load(std::memory_order_relaxed);
+}
+
+Duration MasterClock::getTotalProcessingTime() const {
+    return Duration(totalProcessingTicks.load(std::memory_order_relaxed));
+}
+
+uint64_t MasterClock::getOverrunCount() const {
+    return overrunCount.load(std::memory_order_relaxed);
+}
+
+uint64_t MasterClock::getLateStartCount() const {
+    return lateStartCount.load(std::memory_order_relaxed);
+}
+
+void MasterClock::printDeadlineReport() {
+    printf("   MasterClock::Report::Deadline misses: %llu late starts, %llu overruns.\n",
+        static_cast<unsigned long long>(lateStartCount.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(overrunCount.load(std::memory_order_relaxed)));
+    printf("   MasterClock::Report::Events: %llu signals, %llu handler dispatches.\n",
+        static_cast<unsigned long long>(signalCount.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(eventDispatchCount.load(std::memory_order_relaxed)));
+    if (workerPool) {
+        printf("   MasterClock::Report::Worker Threads: %zu, stolen tasks: %llu.\n", workerPool->getThreadCount(),
+            static_cast<unsigned long long>(workerPool->getStolenTaskCount()));
+    }
+    // One line per batch only when verbose; with thousands of loops the summary is all that fits.
+    std::vector<std::pair<uint64_t, size_t>> missedBatches;
+    for (size_t handle : batchScheduler.getLiveHandles()) {
+        BatchActions& batch = batchScheduler.getBatch(handle);
+        if (batch.getDeadlineMisses() > 0) {
+            missedBatches.emplace_back(batch.getDeadlineMisses(), handle);
         }
     }
+    if (missedBatches.empty()) {
+        return;
+    }
+    size_t listed = verbose ? missedBatches.size() : std::min(missedBatches.size(), maxReportedBatches);
+    std::partial_sort(missedBatches.begin(), missedBatches.begin() + listed, missedBatches.end(),
+        std::greater<std::pair<uint64_t, size_t>>());
+    printf("   MasterClock::Report::%zu batches missed deadlines, worst %zu:\n", missedBatches.size(), listed);
+    for (size_t index = 0; index < listed; index++) {
+        printf("   MasterClock::Report::%s missed %llu deadlines.\n",
+            batchScheduler.getBatch(missedBatches[index].second).getIDTag().c_str(),
+            static_cast<unsigned long long>(missedBatches[index].first));
+    }
 }
 
-bool MasterClock::searchBatchActions(const std::string& idTag) const {
-    std::lock_guard<std::mutex> lock(scheduledIntervalsMutex);
-    return std::any_of(scheduledActionBatches.begin(), scheduledActionBatches.end(),
-        [&](const BatchActions& batch) { return batch.getIDTag() == idTag; });
+TimePoint MasterClock::getNextExecutionTime() const {
+    return batchScheduler.getNextExecutionTime();
 }
 
+TimePoint MasterClock::getNextDivisionTimePoint(TimePoint timePoint) const {
+    Duration sinceStart = std::max(Duration(0), timePoint - startTime);
+    return getDivisionTimePoint((sinceStart + divisionDurationAsDuration - Duration(1)) / divisionDurationAsDuration);
+}
 
-size_t MasterClock::getIndexForBatch(const BatchActions& batch) const {
-    auto it = std::find_if(scheduledActionBatches.begin(), scheduledActionBatches.end(),
-                           [&batch](const BatchActions& b) { return &b == &batch; });
+// Control Plane Section
+//###################################################################################################################
+MasterClock::EventId MasterClock::registerEvent(const std::string& name, bool onDivision) {
+    EventId event = eventCount.fetch_add(1, std::memory_order_relaxed);
+    if (event >= invalidEvent) {
+        printf("   ---MasterClock::registerEvent::No room for event %s.\n", name.c_str());
+        return invalidEvent;
+    }
+    if (onDivision) {
+        divisionEvents.fetch_or(1u << event, std::memory_order_release);
+    }
+    if (verbose) {
+        printf("   MasterClock::registerEvent::%s: %u%s.\n", name.c_str(), event, onDivision ? ", on division" : "");
+    }
+    return event;
+}
 
-    if (it != scheduledActionBatches.end()) {
-        return std::distance(scheduledActionBatches.begin(), it);
+void MasterClock::addEventHandler(EventId event, ActionFunction handler, ActionPriority priority) {
+    if (event >= invalidEvent) {
+        return;
     }
+    ScheduleCommand command;
+    command.type = ScheduleCommandType::AddHandler;
+    command.function = std::move(handler);
+    command.priority = priority;
+    command.event = event;
+    postCommand(std::move(command));
+}
 
-    // Return an invalid index or throw an exception if not found
-    return std::numeric_limits<size_t>::max();
+void MasterClock::signalEvent(EventId event) {
+    if (event >= invalidEvent) {
+        return;
+    }
+    signalCount.fetch_add(1, std::memory_order_relaxed);
+    uint32_t bit = 1u << event;
+    // Only the first signal since the last dispatch needs to wake the clock, and a
+    // division event not before the division it will run on.
+    if ((signalledEvents.fetch_or(bit, std::memory_order_acq_rel) & bit) == 0) {
+        TimePoint now = getCurrentTime();
+        bool onDivision = (divisionEvents.load(std::memory_order_acquire) & bit) != 0;
+        wakeClock(onDivision ? getNextDivisionTimePoint(now) : now);
+    }
+}
+
+void MasterClock::dispatchSignalledEvents(TimePoint currentTime) {
+    uint32_t signalled = signalledEvents.load(std::memory_order_acquire);
+    // One dispatch at a time; the handlers share state and used to run as one batch.
+    if (signalled == 0 || eventsInFlight.load(std::memory_order_acquire)) {
+        return;
+    }
+    uint32_t divisionMask = divisionEvents.load(std::memory_order_acquire);
+    uint32_t due = signalled & ~divisionMask;
+    if ((signalled & divisionMask) != 0) {
+        if (nextEventDivision == TimePoint::max()) {
+            // The first division at or after the signal. The signal may only wake the
+            // clock at that division, a little past it, so the tolerance still counts.
+            nextEventDivision = getNextDivisionTimePoint(currentTime - deadlineTolerance);
+        }
+        if (currentTime >= nextEventDivision) {
+            due |= signalled & divisionMask;
+            nextEventDivision = TimePoint::max();
+        }
+    }
+    if (due == 0) {
+        return;
+    }
+    due &= signalledEvents.fetch_and(~due, std::memory_order_acq_rel);
+    dueHandlers.clear();
+    for (ActionPriority priority : {ActionPriority::High, ActionPriority::Normal, ActionPriority::Low}) {
+        for (EventHandler& handler : eventHandlers) {
+            if (handler.priority == priority && (due & (1u << handler.event)) != 0) {
+                dueHandlers.push_back(&handler);
+            }
+        }
+    }
+    if (dueHandlers.empty()) {
+        return;
+    }
+    eventDispatchCount.fetch_add(1, std::memory_order_relaxed);
+    eventsInFlight.store(true, std::memory_order_release);
+    if (workerPool) {
+        workerPool->enqueue([this]() {
+            runEventHandlers();
+        }, dueHandlers.front()->priority == ActionPriority::High);
+    } else {
+        runEventHandlers();
+    }
 }
 
-void MasterClock::setRuntimeTasks(std::function<void()> taskFunction) {
-    std::string idTag = "RunTimeTasks";
-    Duration divisionDurationAsDuration = fetchDivisionDurationAsDuration();
-    Duration intervalDuration = divisionDurationAsDuration;
+void MasterClock::runEventHandlers() {
+    for (EventHandler* handler : dueHandlers) {
+        handler->function();
+    }
+    eventsInFlight.store(false, std::memory_order_release);
+    // Signals that arrived meanwhile were held back for this dispatch to finish.
+    if (signalledEvents.load(std::memory_order_acquire) != 0) {
+        wakeClock(getCurrentTime());
+    }
+}
 
-    addItemToBatchAtInterval(taskFunction, intervalDuration, idTag, true);
+TimePoint MasterClock::getNextEventTime(TimePoint currentTime) const {
+    uint32_t signalled = signalledEvents.load(std::memory_order_acquire);
+    if (signalled == 0 || eventsInFlight.load(std::memory_order_acquire)) {
+        return TimePoint::max();
+    }
+    if ((signalled & ~divisionEvents.load(std::memory_order_acquire)) != 0) {
+        return currentTime;
+    }
+    return nextEventDivision == TimePoint::max() ? currentTime : nextEventDivision;
 }
 
-void MasterClock::addItemToBatchAtInterval(std::function<void()> function, Duration interval, 
-    const std::string& idTag, bool isLooping) {
-    std::lock_guard<std::mutex> lock(scheduledIntervalsMutex);
+void MasterClock::addItemToBatchAtInterval(ActionFunction function, Duration interval, 
+    const std::string& idTag, bool isLooping, ActionPriority priority) {
     if (verbose) {
         printf("   MasterClock::addItemToBatchAtInteval::Entered.\n");
         printf("   MasterClock::addItemToBatchAtInterval::idTag: %s.\n", idTag.c_str());
     }
 
     if (interval.count() > 0) {
-        auto it = idTagToBatchIndex.find(idTag);
-        if (it != idTagToBatchIndex.end() && scheduledActionBatches[it->second].getDuration() == interval) {
-            scheduledActionBatches[it->second].addScheduledAction(ScheduleAction(function));
-        } else {
-            createNewBatchAndAddAction(function, interval, idTag, isLooping);
+        ScheduleCommand command;
+        command.type = ScheduleCommandType::Add;
+        command.idTag = idTag;
+        command.function = std::move(function);
+        command.interval = interval;
+        // Anchor new batches to the nearest division so they start on the beat grid.
+        command.anchorTime = getDivisionTimePoint(getNearestDivisionIndex(getCurrentTime()));
+        command.isLooping = isLooping;
+        command.priority = priority;
+        command.logTagId = durationLogger.registerTag(idTag);
+        {
+            std::lock_guard<std::mutex> lock(scheduledTagsMutex);
+            ScheduledTag& tag = scheduledTags[idTag];
+            tag.isLooping = tag.isLooping || isLooping;
+            tag.lastExecutionTime = std::max(tag.lastExecutionTime, command.anchorTime + interval);
         }
+        postCommand(std::move(command));
     }
 }
 
-void MasterClock::createNewBatchAndAddAction(std::function<void()> function, Duration interval, 
-    const std::string& idTag, bool isLooping) {
-    TimePoint executionTime = getCurrentTime() + interval;
-    BatchActions newBatch({ ScheduleAction(function) }, executionTime, idTag, isLooping, interval);
-    
-    // Find the appropriate position to insert the new batch to maintain sorted order
-    auto insertPos = std::lower_bound(scheduledActionBatches.begin(), scheduledActionBatches.end(), newBatch,
-        [](const BatchActions& lhs, const BatchActions& rhs) {
-            return lhs.getExecutionTime() < rhs.getExecutionTime();
-        });
-
-    // Insert the new batch at the calculated position
-    scheduledActionBatches.insert(insertPos, std::move(newBatch));
-    
-    // Update idTagToBatchIndex with the correct index for the newly inserted batch
-    idTagToBatchIndex[idTag] = std::distance(scheduledActionBatches.begin(), insertPos);
+void MasterClock::applyAddCommand(ScheduleCommand& command) {
+    size_t handle = batchScheduler.findHandle(command.idTag);
+    if (handle != BatchScheduler::invalidHandle && batchScheduler.getBatch(handle).getDuration() == command.interval) {
+        if (!batchScheduler.getBatch(handle).addScheduledAction(
+            ScheduleAction(std::move(command.function), false, command.priority))) {
+            printf("   ---MasterClock::applyAddCommand::Batch %s is full, action dropped.\n", command.idTag.c_str());
+        }
+    } else {
+        createNewBatchAndAddAction(command);
+    }
+}
+
+void MasterClock::createNewBatchAndAddAction(ScheduleCommand& command) {
+    TimePoint executionTime = command.anchorTime + command.interval;
+    BatchActions newBatch(ScheduleAction(std::move(command.function), false, command.priority), executionTime,
+        command.idTag, command.isLooping, command.interval);
+    newBatch.setAnchorTime(command.anchorTime);
+    newBatch.setIteration(1);
+    newBatch.setLogTagId(command.logTagId);
+    batchScheduler.scheduleBatch(std::move(newBatch));
 }
 
 void MasterClock::executeScheduledBatches() {
+    runningClock = this;
+    if (clockSource == nullptr) {
+        precisionWait.applyThreadPolicy();
+        precisionWait.calibrate();
+    }
     while (!quit.load(std::memory_order_acquire)) {
-        
-        startTimer("ScheduleThreadProcess", true);
+        tickCount.fetch_add(1, std::memory_order_relaxed);
+        startTimer(scheduleProbe, true);
+        // Awake: posts from here on leave their wake time for armWakeTime instead of interrupting.
+        // Exchanged rather than stored, so any post whose request this drops is visible below.
+        armedWakeTime.store(toWakeTicks(TimePoint::min()));
+        requestedWakeTime.exchange(toWakeTicks(TimePoint::max()));
+        applyCompletedBatches();
+        applyScheduleCommands();
         TimePoint currentTime = getCurrentTime();
-        TimePoint nextExecutionTime  = TimePoint::max();
-        std::string idTagInUse;
-        for (auto& batch : scheduledActionBatches) {
-            if (batch.getExecutionTime() <= currentTime) {
-                batch.executeBatch();
-                if (batch.getLoopingFlag()) {
-                    idTagInUse = batch.getIDTag();
-                    TimePoint nextExecutionTime = currentTime + batch.getDuration();
-                    batch.setExecutionTime(nextExecutionTime);
-                    idTagToBatchIndex[batch.getIDTag()] = getIndexForBatch(batch);
-                    
-                }
-            }
-            nextExecutionTime = std::min(nextExecutionTime, batch.getExecutionTime());
-        }
-        startTimer("ScheduleThreadProcess", false);
-        processingDuration = getDuration("ScheduleThreadProcess");
-        TimePoint sleepTimePoint = nextExecutionTime  - processingDuration;
-        std::string processingDurationLog = "MasterClock::executeScheduledBatches::Duration: " +  std::to_string(std::chrono::duration_cast<
-            std::chrono::microseconds>(processingDuration).count()) + " (microseconds) " + "PD_time" + "\n";
-        std::string sleepDurationLog = "MasterClock::executeScheduledBatches::Duration: " +  std::to_string(std::chrono::duration_cast<
-            std::chrono::microseconds>(sleepTimePoint - currentTime).count()) + " (microseconds) " + idTagInUse + "\n";
-        writeStringToFile(processingDurationLog);
-        writeStringToFile(sleepDurationLog);
-        if (sleepTimePoint > currentTime) {
-            std::this_thread::sleep_until(sleepTimePoint);
-        }
-        currentDivisionOfBeat += 1;
-        if (currentDivisionOfBeat >= beatDivisions) {
-            currentDivisionOfBeat = 0;
+        uint32_t logTagInUse = DurationLogger::noTag;
+        // Only batches at the top of the heap are due; the clock thread only
+        // decides what runs and leaves the running to the worker pool.
+        while (dispatchDueBatch(currentTime, logTagInUse)) {}
+        dispatchSignalledEvents(currentTime);
+        // Sleep until the next loop hit or division event. Posted commands and signals
+        // wake the clock early, so an idle clock does not wake at all.
+        TimePoint nextExecutionTime = std::min(getNextExecutionTime(), getNextEventTime(currentTime));
+        if (clockSource != nullptr) {
+            // Offline renders still step every division, so injected keys are handled on the same grid.
+            nextExecutionTime = std::min(nextExecutionTime,
+                getDivisionTimePoint(getNearestDivisionIndex(currentTime) + 1));
         }
+        nextExecutionTime = armWakeTime(nextExecutionTime);
+        startTimer(scheduleProbe, false);
+        processingDuration = getDuration(scheduleProbe);
+        totalProcessingTicks.fetch_add(processingDuration.count(), std::memory_order_relaxed);
+        // Wake at the deadline itself; the precision wait absorbs the OS wakeup slop.
+        Duration wakeupError = clockSource != nullptr ? clockSource->waitUntil(nextExecutionTime)
+            : precisionWait.waitUntil(nextExecutionTime);
+        DurationLogRecord record;
+        record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(currentTime - startTime).count();
+        record.processingDuration = std::chrono::duration_cast<std::chrono::nanoseconds>(processingDuration).count();
+        record.sleepDuration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::min(nextExecutionTime, getCurrentTime()) - currentTime).count();
+        record.wakeupError = std::chrono::duration_cast<std::chrono::nanoseconds>(wakeupError).count();
+        record.tagId = logTagInUse;
+        durationLogger.logRecord(record);
+    }
+    if (workerPool) {
+        workerPool->waitIdle();
     }
+    applyCompletedBatches();
+    applyScheduleCommands();
+    precisionWait.printReport();
+    printDeadlineReport();
+    if (timeVerbose) {
+        printProfileReport();
+    }
+    runningClock = nullptr;
 }
 // Process Timer Section
 //###################################################################################################################
-void MasterClock::startTimer(const std::string& processName, bool start) {
-    std::lock_guard<std::mutex> lock(timerMutex);
-    std::string currentProcessName = processName;
+ProbeId MasterClock::registerProbe(const std::string& processName) {
+    return profiler.registerProbe(processName);
+}
+
+void MasterClock::startTimer(ProbeId probe, bool start) {
     if (start) {
-        // If the process name already exists in the vector, update its start time
-        auto it = std::find_if(processRecords.begin(), processRecords.end(),
-            [&currentProcessName](const auto& record) {
-                return record.first == currentProcessName;
-            });
-        if (it != processRecords.end()) {
-            it->second.first = getCurrentTime();
-        } else {
-            // If the process name does not exist, add a new record
-            processRecords.push_back({currentProcessName, {getCurrentTime(), TimePoint()}});
-        }
+        profiler.startTimer(probe);
     } else {
-        // Update the end time for the corresponding process name
-        auto it = std::find_if(processRecords.begin(), processRecords.end(),
-            [&currentProcessName](const auto& record) {
-                return record.first == currentProcessName;
-            });
-        if (it != processRecords.end()) {
-            it->second.second = getCurrentTime();
-        }
+        profiler.stopTimer(probe);
     }
 }
 
-Duration MasterClock::getDuration(const std::string& processName) {
-    std::lock_guard<std::mutex> lock(timerMutex);
-    for (auto it = processRecords.begin(); it != processRecords.end(); ++it) {
-        const auto& record = *it;
-
-        if (record.first == processName && record.second.first != TimePoint() && record.second.second != TimePoint()) {
-            const Duration duration = record.second.second - record.second.first;
-            // Erase the entry from the vector before returning
-            processRecords.erase(it);
+Duration MasterClock::getDuration(ProbeId probe) {
+    return profiler.getLastDuration(probe);
+}
 
-            return duration;
-        }
+std::string MasterClock::getDurationString(ProbeId probe) {
+    Duration duration = profiler.getLastDuration(probe);
+    if (duration < Duration(0)) {
+        return "-1";
     }
-    return Duration(-1); // If processName not found or start/end time not set
+    const std::chrono::milliseconds durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(duration);
+    return profiler.getProbeName(probe) + " Duration: " + std::to_string(durationMs.count()) + " milliseconds\n";
 }
 
-std::string MasterClock::getDurationString(const std::string& processName) {
-    std::lock_guard<std::mutex> lock(timerMutex);
-    for (auto it = processRecords.begin(); it != processRecords.end(); ++it) {
-        const auto& record = *it;
-
-        if (record.first == processName && record.second.first != TimePoint() && record.second.second != TimePoint()) {
-            const std::chrono::milliseconds duration = std::chrono::duration_cast<std::chrono::milliseconds>(record.second.second - record.second.first);
-            // Erase the entry from the vector before returning
-            processRecords.erase(it);
+std::vector<ProbeSnapshot> MasterClock::getProfileSnapshot() const {
+    return profiler.snapshot();
+}
 
-            return processName + " Duration: " + std::to_string(duration.count()) + " milliseconds\n";
-        }
-    }
-    return "-1"; // If processName not found or start/end time not set
+void MasterClock::printProfileReport() const {
+    profiler.printReport();
 }
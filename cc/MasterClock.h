@@ -10,7 +10,14 @@
 #endif
 #include "ScheduleAction.h"
 #include "BatchActions.h"
+#include "BatchScheduler.h"
+#include "ClockSource.h"
+#include "DurationLogger.h"
+#include "PrecisionWait.h"
+#include "Profiler.h"
+#include "RingBuffer.h"
 #include "Structures.h"
+#include "ThreadPool.h"
 #include <atomic>
 #include <chrono>
 #include <vector>
@@ -18,57 +25,138 @@
 #include <iomanip>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 #include <queue>
 #include <functional>
+#include <memory>
+#include <unordered_map>
 
 class MasterClock {
 public:
+    typedef uint32_t EventId;
+    static const EventId invalidEvent = 32; // one bit of signalledEvents per event
+
     explicit MasterClock(double bpm = 120.0, double beatDivisions = 8.0, bool vb = false, bool sVb = false, bool timeVerbose = false);
     ~MasterClock();
     void setBPM(double newBPM);
+    void setClockConfig(const YAML::Node& clockConfig);
+    // Replaces the system clock, e.g. with a VirtualClockSource for offline
+    // rendering. Call before start(); batches then run inline on the clock
+    // thread so a render is deterministic.
+    void setClockSource(ClockSource* source);
     void start();
     void stop();
     double fetchDivisionDurationInSeconds() const;
     std::mutex mtx;
-    mutable std::mutex divisionTimesMutex;
 
-    TimePoint getDivisionTimePoint(int index) const;
+    // Beat grid: division n starts at startTime + n * divisionDuration.
+    TimePoint getDivisionTimePoint(int64_t index) const;
+    int64_t getNearestDivisionIndex(TimePoint timePoint) const;
 
     TimePoint getCurrentTime() const;
-    // TimePoint getStartTime() const;
+    TimePoint getStartTime() const;
 
     double getBPM() const;
     double getBeatDivisions() const;
     Duration fetchDivisionDurationAsDuration() const;
     int getCurrentDivisonOfBeat();
 
-    // Process Timer
-    void startTimer(const std::string& processName, bool start);
-    std::string getDurationString(const std::string& processName);
-    Duration getDuration(const std::string& processName);
-    void writeStringToFile(const std::string& content);
+    // Process Timer: probes are registered once, then timed lock-free per thread.
+    ProbeId registerProbe(const std::string& processName);
+    void startTimer(ProbeId probe, bool start);
+    std::string getDurationString(ProbeId probe);
+    Duration getDuration(ProbeId probe);
+    std::vector<ProbeSnapshot> getProfileSnapshot() const;
+    void printProfileReport() const;
+
+    // Run statistics; the wakeup figures are only stable once executeScheduledBatches has returned.
+    Duration getWakeupErrorPercentile(double percentile) const;
+    Duration getMaxWakeupError() const;
+    uint64_t getWakeupCount() const;
+    // Waits cut short because a post or signal needed the clock sooner.
+    uint64_t getInterruptedWakeupCount() const;
+    // Passes through the clock loop, whatever woke it.
+    uint64_t getTickCount() const;
+    // Time spent processing ticks, summed over all of them; excludes calibration and waits.
+    Duration getTotalProcessingTime() const;
+    uint64_t getOverrunCount() const;
+    uint64_t getLateStartCount() const;
     bool isNoteDataEmpty();
     void updateWindwoTimeValues();
     void waitForBufferUpdate();
     void executeScheduledBatches();
-    void setRuntimeTasks(std::function<void()> taskFunction);
+
+    // Control plane: instead of polling every division, work that depends on input or
+    // state is signalled when it changes and its handlers run once on the worker pool.
+    // Handlers of a division event wait for the next division, so work such as looper
+    // capture stays on the beat grid; the others run at once. Signals coalesce, and the
+    // handlers of one dispatch run one after another, highest priority first.
+    EventId registerEvent(const std::string& name, bool onDivision);
+    // A new handler also runs once when added, so it starts from the current state.
+    void addEventHandler(EventId event, ActionFunction handler, ActionPriority priority = ActionPriority::Normal);
+    // Wait-free apart from waking the clock; safe from any thread.
+    void signalEvent(EventId event);
 
     bool containsBatchActions(const std::string& idTag) const;
     void removeBatchFromQueue(const std::string& idTag);
-    void addItemToBatchAtInterval(std::function<void()> function, Duration interval, 
-        const std::string& idTag, bool isLooping);
+    void addItemToBatchAtInterval(ActionFunction function, Duration interval, 
+        const std::string& idTag, bool isLooping, ActionPriority priority = ActionPriority::Normal);
 
 private:
+    enum class ScheduleCommandType { Add, Remove, AddHandler };
+
+    // Scheduler mutations are posted by other threads and applied by the clock
+    // thread at the start of a tick, so only the clock thread touches batchScheduler.
+    struct ScheduleCommand {
+        ScheduleCommandType type;
+        std::string idTag;
+        ActionFunction function;
+        Duration interval;
+        TimePoint anchorTime;
+        bool isLooping;
+        ActionPriority priority;
+        uint32_t logTagId;
+        EventId event;
+    };
+
+    struct EventHandler {
+        EventId event;
+        ActionPriority priority;
+        ActionFunction function;
+    };
+
+    struct ScheduledTag {
+        bool isLooping;
+        TimePoint lastExecutionTime;
+    };
+
     // declare member functions
     static void emptyFunction(MasterClock&) {};
     Duration calculateDivisionDuration() const;
-    void timePointQueue(Duration correctionTime);
     void initTimePointQueue();
+    TimePoint advanceBatchOnGrid(BatchActions& batch, TimePoint currentTime) const;
     static void setVerboseStatus(bool vb, bool sVb, bool tVb);
-    void createNewBatchAndAddAction(std::function<void()> function, Duration interval,
-        const std::string& idTag, bool isLooping);
+    void createNewBatchAndAddAction(ScheduleCommand& command);
+    void postCommand(ScheduleCommand command);
+    void applyScheduleCommands();
+    void applyScheduleCommand(ScheduleCommand& command);
+    void applyCompletedBatches();
+    void applyAddCommand(ScheduleCommand& command);
     bool searchBatchActions(const std::string& idTag) const;
-    size_t getIndexForBatch(const BatchActions& batch) const;
+    bool dispatchDueBatch(TimePoint currentTime, uint32_t& logTagInUse);
+    void runBatch(BatchActions* batch, size_t handle);
+    TimePoint getNextExecutionTime() const;
+    TimePoint getNextDivisionTimePoint(TimePoint timePoint) const;
+    // Asks the clock to be awake by wakeTime; interrupts its wait only if it is armed for later.
+    void wakeClock(TimePoint wakeTime);
+    TimePoint armWakeTime(TimePoint deadline);
+    void dispatchSignalledEvents(TimePoint currentTime);
+    void runEventHandlers();
+    TimePoint getNextEventTime(TimePoint currentTime) const;
+    void printDeadlineReport();
+
+    // Batches named in the deadline report unless verbose, worst first.
+    static const size_t maxReportedBatches = 10;
 
     // declare member variables
     double bpm;
@@ -80,7 +168,6 @@ private:
     bool bufferUpdated;
     bool isNoteDataReady;
     bool logging;
-    int currentDivisionOfBeat;
     std::string filename;
 
     // declare time units
@@ -89,20 +176,58 @@ private:
     Duration timeCorrectionForBuffer;
     TimePoint nextDivisionTime;
     Duration processingDuration;
+    Duration deadlineTolerance;
 
     // declare structures
-    std::vector<std::pair<std::string, std::pair<TimePoint, TimePoint>>> processRecords;
-    std::vector<TimePoint> divisionTimes;
-    std::unordered_map<std::string, size_t> idTagToBatchIndex;
-    std::deque<BatchActions> scheduledActionBatches;
+    BatchScheduler batchScheduler;
+    MPSCRingBuffer<ScheduleCommand> scheduleCommands;
+    // Posts the clock thread itself makes while scheduleCommands is full: inline batches and
+    // handlers cannot wait for a drain only their own thread performs. Clock thread only.
+    std::vector<ScheduleCommand> overflowCommands;
+    // The clock whose executeScheduledBatches the calling thread is running, if any.
+    static thread_local const MasterClock* runningClock;
+    // Workers report finished batches here rather than through scheduleCommands,
+    // so a burst of adds/removes can never hold a batch in flight past its next hit.
+    MPSCRingBuffer<size_t> completedBatches;
+    std::unordered_map<std::string, ScheduledTag> scheduledTags;
+    DurationLogger durationLogger;
+    PrecisionWait precisionWait;
+    ClockSource* clockSource;
+    Profiler profiler;
+    ProbeId scheduleProbe;
+    size_t workerThreadCount;
+    int workerRealtimePriority;
+    std::atomic<uint64_t> overrunCount;
+    std::atomic<uint64_t> lateStartCount;
+    // Created in start(); null runs batches inline on the clock thread.
+    std::unique_ptr<ThreadPool> workerPool;
+
+    // Control plane. Handlers are added and dispatched on the clock thread only; a
+    // deque keeps them in place while a worker runs the ones in dueHandlers.
+    std::atomic<EventId> eventCount;
+    std::atomic<uint32_t> divisionEvents;
+    std::atomic<uint32_t> signalledEvents;
+    std::atomic<bool> eventsInFlight;
+    std::deque<EventHandler> eventHandlers;
+    std::vector<EventHandler*> dueHandlers;
+    TimePoint nextEventDivision;
+    std::atomic<uint64_t> signalCount;
+    std::atomic<uint64_t> eventDispatchCount;
+
+    // Wake coalescing, in high_resolution_clock ticks. armedWakeTime is the deadline the
+    // clock is waiting for, or the minimum while it is awake; requestedWakeTime is the
+    // earliest wake any post or signal has asked for since the clock last looked.
+    std::atomic<int64_t> armedWakeTime;
+    std::atomic<int64_t> requestedWakeTime;
+    std::atomic<uint64_t> tickCount;
+    std::atomic<int64_t> totalProcessingTicks; // high_resolution_clock ticks
     
     // declare threading mechanisms
     std::thread timerThread;
-    mutable std::mutex timerMutex;
     std::mutex mtxNoteData;
     std::condition_variable bufferUpdateCV;
     std::condition_variable cvNoteData;
-    mutable std::mutex scheduledIntervalsMutex; //
+    mutable std::mutex scheduledTagsMutex; // guards scheduledTags; never taken by the clock thread
 };
 
 #endif // MASTER_CLOCK_H
@@ -0,0 +1,233 @@
+// MixKernelTest.cc
+// Runs every MixKernelTable this CPU supports against the scalar reference on
+// random and edge-value buffers, over lengths around each vector width and
+// from unaligned start offsets, and reports any kernel whose output differs.
+// Everything must match bit for bit except dotFloat, whose vector sums are
+// added in a different order and only have to agree to a rounding error.
+// build.sh links it as mix_kernel_test and runs it.
+#include "MixKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Every length up to a few AVX2 blocks, then a few long ones with odd tails.
+const size_t maxShortLength = 70;
+const size_t longLengths[] = {127, 128, 129, 255, 1000, 1023, 4096, 4099};
+// Start offsets in elements from a 64-byte boundary.
+const size_t startOffsets[] = {0, 1, 2, 3, 5};
+const size_t padding = 64;
+
+const float floatEdges[] = {0.0f, -0.0f, 1.0f, -1.0f, 1.0000001f, -1.0000001f, 0.9999999f, 2.0f, -2.0f,
+    1e-30f, -1e-30f, 1e30f, -1e30f, 0.5f / 32767.0f, 1.5f / 32767.0f, -2.5f / 32767.0f};
+const int16_t s16Edges[] = {0, 1, -1, 32767, -32768, -32767, 16384, -16384};
+const float gains[] = {1.0f, 0.0f, -1.0f, 0.7071f, 1.9f, 1e-4f};
+// Brings 16-bit sources mixed into a float bus back to full scale.
+const float s16GainScale = 1.0f / 32768.0f;
+
+struct TestContext {
+    std::mt19937 random;
+    size_t checks;
+    size_t failures;
+};
+
+std::vector<size_t> getLengths() {
+    std::vector<size_t> lengths;
+    for (size_t length = 0; length <= maxShortLength; length++) {
+        lengths.push_back(length);
+    }
+    lengths.insert(lengths.end(), std::begin(longLengths), std::end(longLengths));
+    return lengths;
+}
+
+// Mostly random values with the edge cases mixed in at random places.
+void fillFloat(TestContext& context, std::vector<float>& buffer, float range) {
+    std::uniform_real_distribution<float> value(-range, range);
+    std::uniform_int_distribution<size_t> edge(0, 3 * (sizeof(floatEdges) / sizeof(floatEdges[0])));
+    for (float& sample : buffer) {
+        size_t pick = edge(context.random);
+        sample = pick < sizeof(floatEdges) / sizeof(floatEdges[0]) ? floatEdges[pick] : value(context.random);
+    }
+}
+
+void fillS16(TestContext& context, std::vector<int16_t>& buffer) {
+    std::uniform_int_distribution<int> value(-32768, 32767);
+    std::uniform_int_distribution<size_t> edge(0, 3 * (sizeof(s16Edges) / sizeof(s16Edges[0])));
+    for (int16_t& sample : buffer) {
+        size_t pick = edge(context.random);
+        sample = pick < sizeof(s16Edges) / sizeof(s16Edges[0]) ? s16Edges[pick] : static_cast<int16_t>(value(context.random));
+    }
+}
+
+template <typename T>
+void expectSame(TestContext& context, const MixKernelTable& kernels, const char* kernel, const T* actual,
+    const T* expected, size_t count, size_t offset) {
+    context.checks++;
+    if (std::memcmp(actual, expected, count * sizeof(T)) == 0) {
+        return;
+    }
+    size_t index = 0;
+    while (std::memcmp(&actual[index], &expected[index], sizeof(T)) == 0) {
+        index++;
+    }
+    context.failures++;
+    printf("   ---MixKernelTest::%s::%s differs from scalar at %zu of %zu (offset %zu): %.9g vs %.9g.\n",
+        kernels.name, kernel, index, count, offset, static_cast<double>(actual[index]),
+        static_cast<double>(expected[index]));
+}
+
+void expectSameValue(TestContext& context, const MixKernelTable& kernels, const char* kernel, double actual,
+    double expected, double tolerance, size_t count, size_t offset) {
+    context.checks++;
+    if (std::fabs(actual - expected) <= tolerance) {
+        return;
+    }
+    context.failures++;
+    printf("   ---MixKernelTest::%s::%s differs from scalar for %zu samples (offset %zu): %.9g vs %.9g.\n",
+        kernels.name, kernel, count, offset, actual, expected);
+}
+
+// Element-wise kernels, for one length and start offset.
+void checkBufferKernels(TestContext& context, const MixKernelTable& kernels, size_t count, size_t offset) {
+    const MixKernelTable& scalar = MixKernels::getScalar();
+    std::uniform_int_distribution<size_t> pickGain(0, sizeof(gains) / sizeof(gains[0]) - 1);
+    float gain = gains[pickGain(context.random)];
+
+    std::vector<float> floatSource(count + padding);
+    std::vector<float> floatOther(count + padding);
+    std::vector<int16_t> s16Source(count + padding);
+    fillFloat(context, floatSource, 1.5f);
+    fillFloat(context, floatOther, 1.0f);
+    fillS16(context, s16Source);
+    const float* source = floatSource.data() + offset;
+    const int16_t* s16 = s16Source.data() + offset;
+
+    std::vector<float> actual(floatOther);
+    std::vector<float> expected(floatOther);
+    kernels.mixAdd(actual.data() + offset, source, count, gain);
+    scalar.mixAdd(expected.data() + offset, source, count, gain);
+    expectSame(context, kernels, "mixAdd", actual.data(), expected.data(), actual.size(), offset);
+
+    actual = floatOther;
+    expected = floatOther;
+    kernels.mixAddS16(actual.data() + offset, s16, count, gain * s16GainScale);
+    scalar.mixAddS16(expected.data() + offset, s16, count, gain * s16GainScale);
+    expectSame(context, kernels, "mixAddS16", actual.data(), expected.data(), actual.size(), offset);
+
+    kernels.clampFloat(actual.data() + offset, source, count);
+    scalar.clampFloat(expected.data() + offset, source, count);
+    expectSame(context, kernels, "clampFloat", actual.data(), expected.data(), actual.size(), offset);
+
+    kernels.s16ToFloat(actual.data() + offset, s16, count);
+    scalar.s16ToFloat(expected.data() + offset, s16, count);
+    expectSame(context, kernels, "s16ToFloat", actual.data(), expected.data(), actual.size(), offset);
+
+    kernels.scaleFloat(actual.data() + offset, source, count, gain);
+    scalar.scaleFloat(expected.data() + offset, source, count, gain);
+    expectSame(context, kernels, "scaleFloat", actual.data(), expected.data(), actual.size(), offset);
+
+    // In place is allowed.
+    kernels.scaleFloat(actual.data() + offset, actual.data() + offset, count, gain);
+    scalar.scaleFloat(expected.data() + offset, expected.data() + offset, count, gain);
+    expectSame(context, kernels, "scaleFloat in place", actual.data(), expected.data(), actual.size(), offset);
+
+    std::vector<int16_t> actualS16(s16Source);
+    std::vector<int16_t> expectedS16(s16Source);
+    kernels.floatToS16(actualS16.data() + offset, source, count);
+    scalar.floatToS16(expectedS16.data() + offset, source, count);
+    expectSame(context, kernels, "floatToS16", actualS16.data(), expectedS16.data(), actualS16.size(), offset);
+
+    kernels.scaleS16(actualS16.data() + offset, s16, count, gain);
+    scalar.scaleS16(expectedS16.data() + offset, s16, count, gain);
+    expectSame(context, kernels, "scaleS16", actualS16.data(), expectedS16.data(), actualS16.size(), offset);
+
+    expectSameValue(context, kernels, "peakFloat", kernels.peakFloat(source, count),
+        scalar.peakFloat(source, count), 0.0, count, offset);
+    expectSameValue(context, kernels, "peakS16", kernels.peakS16(s16, count), scalar.peakS16(s16, count), 0.0,
+        count, offset);
+
+    // Audio-range inputs only, so the huge edge values cannot overflow the sum.
+    std::vector<float> dotSource(floatSource);
+    scalar.clampFloat(dotSource.data(), floatSource.data(), dotSource.size());
+    source = dotSource.data() + offset;
+    const float* other = floatOther.data() + offset;
+    double magnitude = 0.0;
+    for (size_t index = 0; index < count; index++) {
+        magnitude += std::fabs(static_cast<double>(source[index]) * other[index]);
+    }
+    expectSameValue(context, kernels, "dotFloat", kernels.dotFloat(source, other, count),
+        scalar.dotFloat(source, other, count), 1e-6 * magnitude + 1e-30, count, offset);
+}
+
+// The resampler over the block edges: the start and end of the source, tails
+// shorter than a block, rates either side of 1 and channel counts past the
+// vector path's limit.
+void checkResampler(TestContext& context, const MixKernelTable& kernels) {
+    const MixKernelTable& scalar = MixKernels::getScalar();
+    const uint32_t sourceLengths[] = {1, 2, 3, 4, 5, 37, 1000};
+    const int channelCounts[] = {1, 2, 3, 8, 9};
+    const double rates[] = {1.0, 0.5, 0.75, 1.0594631, 1.5, 2.0, 3.7};
+    const size_t frameCounts[] = {0, 1, 7, 31, 32, 33, 64, 65, 100, 257};
+    std::uniform_real_distribution<double> startFraction(0.0, 1.0);
+    std::uniform_int_distribution<size_t> pickOffset(0, sizeof(startOffsets) / sizeof(startOffsets[0]) - 1);
+    for (uint32_t sourceFrames : sourceLengths) {
+        for (int channels : channelCounts) {
+            std::vector<float> source(sourceFrames * channels + padding);
+            fillFloat(context, source, 1.0f);
+            for (double rate : rates) {
+                uint64_t step = static_cast<uint64_t>(rate * 4294967296.0);
+                for (size_t frameCount : frameCounts) {
+                    // From the very first frame, from inside and from near the end.
+                    const double starts[] = {0.0, startFraction(context.random) * sourceFrames,
+                        std::max(0.0, sourceFrames - 2.5)};
+                    for (double start : starts) {
+                        uint64_t position = static_cast<uint64_t>(start * 4294967296.0);
+                        size_t sourceOffset = startOffsets[pickOffset(context.random)];
+                        size_t offset = startOffsets[pickOffset(context.random)];
+                        std::vector<float> actual(frameCount * channels + padding);
+                        fillFloat(context, actual, 1.0f);
+                        std::vector<float> expected(actual);
+                        kernels.mixAddResampled(actual.data() + offset, source.data() + sourceOffset, sourceFrames,
+                            channels, position, step, frameCount, 0.8f);
+                        scalar.mixAddResampled(expected.data() + offset, source.data() + sourceOffset, sourceFrames,
+                            channels, position, step, frameCount, 0.8f);
+                        expectSame(context, kernels, "mixAddResampled", actual.data(), expected.data(),
+                            actual.size(), offset);
+                    }
+                }
+            }
+        }
+    }
+}
+
+}
+
+int main() {
+    TestContext context;
+    context.random.seed(20240611);
+    context.checks = 0;
+    context.failures = 0;
+    std::vector<const MixKernelTable*> supported = MixKernels::getSupported();
+    // The first table is the scalar reference itself.
+    for (size_t table = 1; table < supported.size(); table++) {
+        const MixKernelTable* kernels = supported[table];
+        printf("MixKernelTest::Checking %s kernels against scalar.\n", kernels->name);
+        for (size_t count : getLengths()) {
+            for (size_t offset : startOffsets) {
+                checkBufferKernels(context, *kernels, count, offset);
+            }
+        }
+        checkResampler(context, *kernels);
+    }
+    if (context.failures > 0) {
+        printf("MixKernelTest::FAILED: %zu of %zu checks differ from scalar.\n", context.failures, context.checks);
+        return 1;
+    }
+    printf("MixKernelTest::Passed %zu checks over %zu vector kernel tables.\n", context.checks, supported.size() - 1);
+    return 0;
+}
@@ -0,0 +1,795 @@
+#include "MixKernels.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIX_KERNELS_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIX_KERNELS_NEON 1
+#endif
+
+namespace {
+const float s16Scale = 32767.0f;
+const float s16ToFloatScale = 1.0f / 32768.0f;
+
+// Scalar Section
+//###################################################################################################################
+void mixAddScalar(float* destination, const float* source, size_t count, float gain) {
+    for (size_t index = 0; index < count; index++) {
+        destination[index] += source[index] * gain;
+    }
+}
+
+void floatToS16Scalar(int16_t* destination, const float* source, size_t count) {
+    for (size_t index = 0; index < count; index++) {
+        float sample = std::min(1.0f, std::max(-1.0f, source[index]));
+        destination[index] = static_cast<int16_t>(std::lrint(sample * s16Scale));
+    }
+}
+
+void clampFloatScalar(float* destination, const float* source, size_t count) {
+    for (size_t index = 0; index < count; index++) {
+        destination[index] = std::min(1.0f, std::max(-1.0f, source[index]));
+    }
+}
+
+void mixAddS16Scalar(float* destination, const int16_t* source, size_t count, float gain) {
+    for (size_t index = 0; index < count; index++) {
+        destination[index] += static_cast<float>(source[index]) * gain;
+    }
+}
+
+void s16ToFloatScalar(float* destination, const int16_t* source, size_t count) {
+    for (size_t index = 0; index < count; index++) {
+        destination[index] = static_cast<float>(source[index]) * s16ToFloatScale;
+    }
+}
+
+float peakFloatScalar(const float* source, size_t count) {
+    float peak = 0.0f;
+    for (size_t index = 0; index < count; index++) {
+        peak = std::max(peak, std::fabs(source[index]));
+    }
+    return peak;
+}
+
+int32_t peakS16Scalar(const int16_t* source, size_t count) {
+    int32_t peak = 0;
+    for (size_t index = 0; index < count; index++) {
+        peak = std::max(peak, std::abs(static_cast<int32_t>(source[index])));
+    }
+    return peak;
+}
+
+void scaleFloatScalar(float* destination, const float* source, size_t count, float gain) {
+    for (size_t index = 0; index < count; index++) {
+        destination[index] = source[index] * gain;
+    }
+}
+
+void scaleS16Scalar(int16_t* destination, const int16_t* source, size_t count, float gain) {
+    for (size_t index = 0; index < count; index++) {
+        float sample = std::min(32767.0f, std::max(-32768.0f, static_cast<float>(source[index]) * gain));
+        destination[index] = static_cast<int16_t>(std::lrint(sample));
+    }
+}
+
+void mixAddResampledScalar(float* destination, const float* source, uint32_t sourceFrames, int channels,
+    uint64_t position, uint64_t step, size_t frameCount, float gain) {
+    for (size_t frame = 0; frame < frameCount; frame++, position += step) {
+        int64_t index = static_cast<int64_t>(position >> 32);
+        float fraction = getPositionFraction(position);
+        for (int channel = 0; channel < channels; channel++) {
+            float taps[4];
+            for (int tap = 0; tap < 4; tap++) {
+                int64_t tapIndex = index + tap - 1;
+                taps[tap] = tapIndex >= 0 && tapIndex < sourceFrames ? source[tapIndex * channels + channel] : 0.0f;
+            }
+            destination[frame * channels + channel] += cubicHermite(taps[0], taps[1], taps[2], taps[3], fraction) * gain;
+        }
+    }
+}
+
+float dotFloatScalar(const float* a, const float* b, size_t count) {
+    float sum = 0.0f;
+    for (size_t index = 0; index < count; index++) {
+        sum += a[index] * b[index];
+    }
+    return sum;
+}
+
+// The vector resamplers work on blocks of output samples ("lanes", frame by
+// channel) whose four taps all lie inside the source; blocks at the edges
+// go through the scalar kernel above.
+const size_t resampleBlockFrames = 32;
+const int maxResampleChannels = 8;
+
+bool isInteriorBlock(uint64_t position, uint64_t step, size_t frameCount, uint32_t sourceFrames, int channels) {
+    uint64_t firstIndex = position >> 32;
+    uint64_t lastIndex = (position + (frameCount - 1) * step) >> 32;
+    return firstIndex >= 1 && lastIndex + 2 < sourceFrames && (lastIndex + 2) * channels < INT32_MAX;
+}
+
+// offsets[lane] is where the lane's first tap sits in source; the others follow every channels samples.
+size_t fillResampleLanes(int32_t* offsets, float* fractions, uint64_t position, uint64_t step, size_t frameCount,
+    int channels) {
+    size_t lane = 0;
+    for (size_t frame = 0; frame < frameCount; frame++, position += step) {
+        int32_t base = static_cast<int32_t>(((position >> 32) - 1) * channels);
+        float fraction = getPositionFraction(position);
+        for (int channel = 0; channel < channels; channel++, lane++) {
+            offsets[lane] = base + channel;
+            fractions[lane] = fraction;
+        }
+    }
+    return lane;
+}
+
+void mixResampledLanesScalar(float* destination, const float* source, int channels, const int32_t* offsets,
+    const float* fractions, size_t firstLane, size_t laneCount, float gain) {
+    for (size_t lane = firstLane; lane < laneCount; lane++) {
+        const float* taps = source + offsets[lane];
+        destination[lane] += cubicHermite(taps[0], taps[channels], taps[2 * channels], taps[3 * channels],
+            fractions[lane]) * gain;
+    }
+}
+
+// Runs laneKernel over each interior block, or the scalar kernel at the edges.
+template <typename LaneKernel>
+void mixAddResampledBlocks(float* destination, const float* source, uint32_t sourceFrames, int channels,
+    uint64_t position, uint64_t step, size_t frameCount, float gain, LaneKernel laneKernel) {
+    if (channels > maxResampleChannels) {
+        mixAddResampledScalar(destination, source, sourceFrames, channels, position, step, frameCount, gain);
+        return;
+    }
+    int32_t offsets[resampleBlockFrames * maxResampleChannels];
+    float fractions[resampleBlockFrames * maxResampleChannels];
+    for (size_t frame = 0; frame < frameCount; frame += resampleBlockFrames) {
+        size_t blockFrames = std::min(resampleBlockFrames, frameCount - frame);
+        float* output = destination + frame * channels;
+        if (isInteriorBlock(position, step, blockFrames, sourceFrames, channels)) {
+            size_t laneCount = fillResampleLanes(offsets, fractions, position, step, blockFrames, channels);
+            size_t lane = laneKernel(output, source, channels, offsets, fractions, laneCount, gain);
+            mixResampledLanesScalar(output, source, channels, offsets, fractions, lane, laneCount, gain);
+        } else {
+            mixAddResampledScalar(output, source, sourceFrames, channels, position, step, blockFrames, gain);
+        }
+        position += blockFrames * step;
+    }
+}
+
+const MixKernelTable scalarKernels = {&mixAddScalar, &floatToS16Scalar, &clampFloatScalar, &mixAddS16Scalar,
+    &s16ToFloatScalar, &peakFloatScalar, &peakS16Scalar, &scaleFloatScalar, &scaleS16Scalar, &mixAddResampledScalar,
+    &dotFloatScalar, "scalar"};
+
+#if defined(MIX_KERNELS_X86) && defined(__SSE2__)
+// SSE Section
+//###################################################################################################################
+void mixAddSSE(float* destination, const float* source, size_t count, float gain) {
+    __m128 gainVector = _mm_set1_ps(gain);
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        __m128 low = _mm_add_ps(_mm_loadu_ps(destination + index),
+            _mm_mul_ps(_mm_loadu_ps(source + index), gainVector));
+        __m128 high = _mm_add_ps(_mm_loadu_ps(destination + index + 4),
+            _mm_mul_ps(_mm_loadu_ps(source + index + 4), gainVector));
+        _mm_storeu_ps(destination + index, low);
+        _mm_storeu_ps(destination + index + 4, high);
+    }
+    mixAddScalar(destination + index, source + index, count - index, gain);
+}
+
+void floatToS16SSE(int16_t* destination, const float* source, size_t count) {
+    const __m128 upper = _mm_set1_ps(1.0f);
+    const __m128 lower = _mm_set1_ps(-1.0f);
+    const __m128 scale = _mm_set1_ps(s16Scale);
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        __m128 low = _mm_min_ps(upper, _mm_max_ps(lower, _mm_loadu_ps(source + index)));
+        __m128 high = _mm_min_ps(upper, _mm_max_ps(lower, _mm_loadu_ps(source + index + 4)));
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(low, scale)),
+            _mm_cvtps_epi32(_mm_mul_ps(high, scale)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index), packed);
+    }
+    floatToS16Scalar(destination + index, source + index, count - index);
+}
+
+void clampFloatSSE(float* destination, const float* source, size_t count) {
+    const __m128 upper = _mm_set1_ps(1.0f);
+    const __m128 lower = _mm_set1_ps(-1.0f);
+    size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        _mm_storeu_ps(destination + index, _mm_min_ps(upper, _mm_max_ps(lower, _mm_loadu_ps(source + index))));
+    }
+    clampFloatScalar(destination + index, source + index, count - index);
+}
+
+// Widens eight 16-bit samples to two vectors of floats.
+inline void loadS16SSE(const int16_t* source, __m128& low, __m128& high) {
+    __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+    // SSE2 has no sign extension; put each sample in the top half and shift it back down.
+    low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16));
+    high = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16));
+}
+
+void mixAddS16SSE(float* destination, const int16_t* source, size_t count, float gain) {
+    __m128 gainVector = _mm_set1_ps(gain);
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        __m128 low, high;
+        loadS16SSE(source + index, low, high);
+        _mm_storeu_ps(destination + index, _mm_add_ps(_mm_loadu_ps(destination + index), _mm_mul_ps(low, gainVector)));
+        _mm_storeu_ps(destination + index + 4,
+            _mm_add_ps(_mm_loadu_ps(destination + index + 4), _mm_mul_ps(high, gainVector)));
+    }
+    mixAddS16Scalar(destination + index, source + index, count - index, gain);
+}
+
+void s16ToFloatSSE(float* destination, const int16_t* source, size_t count) {
+    __m128 scale = _mm_set1_ps(s16ToFloatScale);
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        __m128 low, high;
+        loadS16SSE(source + index, low, high);
+        _mm_storeu_ps(destination + index, _mm_mul_ps(low, scale));
+        _mm_storeu_ps(destination + index + 4, _mm_mul_ps(high, scale));
+    }
+    s16ToFloatScalar(destination + index, source + index, count - index);
+}
+
+float peakFloatSSE(const float* source, size_t count) {
+    const __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 peakVector = _mm_setzero_ps();
+    size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        peakVector = _mm_max_ps(peakVector, _mm_and_ps(_mm_loadu_ps(source + index), magnitude));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, peakVector);
+    float peak = peakFloatScalar(source + index, count - index);
+    for (float lane : lanes) {
+        peak = std::max(peak, lane);
+    }
+    return peak;
+}
+
+int32_t peakS16SSE(const int16_t* source, size_t count) {
+    // No 16-bit abs before SSSE3; track both extremes instead, -32768 has no positive twin anyway.
+    __m128i highest = _mm_setzero_si128();
+    __m128i lowest = _mm_setzero_si128();
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index));
+        highest = _mm_max_epi16(highest, packed);
+        lowest = _mm_min_epi16(lowest, packed);
+    }
+    int16_t highLanes[8];
+    int16_t lowLanes[8];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(highLanes), highest);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lowLanes), lowest);
+    int32_t peak = peakS16Scalar(source + index, count - index);
+    for (int lane = 0; lane < 8; lane++) {
+        peak = std::max(peak, std::max<int32_t>(highLanes[lane], -static_cast<int32_t>(lowLanes[lane])));
+    }
+    return peak;
+}
+
+void scaleFloatSSE(float* destination, const float* source, size_t count, float gain) {
+    __m128 gainVector = _mm_set1_ps(gain);
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        _mm_storeu_ps(destination + index, _mm_mul_ps(_mm_loadu_ps(source + index), gainVector));
+        _mm_storeu_ps(destination + index + 4, _mm_mul_ps(_mm_loadu_ps(source + index + 4), gainVector));
+    }
+    scaleFloatScalar(destination + index, source + index, count - index, gain);
+}
+
+void scaleS16SSE(int16_t* destination, const int16_t* source, size_t count, float gain) {
+    const __m128 gainVector = _mm_set1_ps(gain);
+    const __m128 upper = _mm_set1_ps(32767.0f);
+    const __m128 lower = _mm_set1_ps(-32768.0f);
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        __m128 low, high;
+        loadS16SSE(source + index, low, high);
+        // Clamp before converting; out of range conversions would wrap to INT_MIN.
+        low = _mm_min_ps(upper, _mm_max_ps(lower, _mm_mul_ps(low, gainVector)));
+        high = _mm_min_ps(upper, _mm_max_ps(lower, _mm_mul_ps(high, gainVector)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index),
+            _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high)));
+    }
+    scaleS16Scalar(destination + index, source + index, count - index, gain);
+}
+
+float dotFloatSSE(const float* a, const float* b, size_t count) {
+    __m128 sum = _mm_setzero_ps();
+    size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + index), _mm_loadu_ps(b + index)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, sum);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + dotFloatScalar(a + index, b + index, count - index);
+}
+
+inline __m128 cubicHermiteSSE(__m128 p0, __m128 p1, __m128 p2, __m128 p3, __m128 t) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 c1 = _mm_mul_ps(half, _mm_sub_ps(p2, p0));
+    __m128 c2 = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(p0, _mm_mul_ps(_mm_set1_ps(2.5f), p1)),
+        _mm_mul_ps(_mm_set1_ps(2.0f), p2)), _mm_mul_ps(half, p3));
+    __m128 c3 = _mm_add_ps(_mm_mul_ps(half, _mm_sub_ps(p3, p0)), _mm_mul_ps(_mm_set1_ps(1.5f), _mm_sub_ps(p1, p2)));
+    return _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(c3, t), c2), t), c1), t), p1);
+}
+
+size_t mixResampledLanesSSE(float* destination, const float* source, int channels, const int32_t* offsets,
+    const float* fractions, size_t laneCount, float gain) {
+    // No gather before AVX2; the taps are picked up one by one and the interpolation is vectorized.
+    __m128 gainVector = _mm_set1_ps(gain);
+    size_t lane = 0;
+    for (; lane + 4 <= laneCount; lane += 4) {
+        const float* a = source + offsets[lane];
+        const float* b = source + offsets[lane + 1];
+        const float* c = source + offsets[lane + 2];
+        const float* d = source + offsets[lane + 3];
+        __m128 p0 = _mm_setr_ps(a[0], b[0], c[0], d[0]);
+        __m128 p1 = _mm_setr_ps(a[channels], b[channels], c[channels], d[channels]);
+        __m128 p2 = _mm_setr_ps(a[2 * channels], b[2 * channels], c[2 * channels], d[2 * channels]);
+        __m128 p3 = _mm_setr_ps(a[3 * channels], b[3 * channels], c[3 * channels], d[3 * channels]);
+        __m128 value = cubicHermiteSSE(p0, p1, p2, p3, _mm_loadu_ps(fractions + lane));
+        _mm_storeu_ps(destination + lane, _mm_add_ps(_mm_loadu_ps(destination + lane), _mm_mul_ps(value, gainVector)));
+    }
+    return lane;
+}
+
+void mixAddResampledSSE(float* destination, const float* source, uint32_t sourceFrames, int channels,
+    uint64_t position, uint64_t step, size_t frameCount, float gain) {
+    mixAddResampledBlocks(destination, source, sourceFrames, channels, position, step, frameCount, gain,
+        &mixResampledLanesSSE);
+}
+
+const MixKernelTable sseKernels = {&mixAddSSE, &floatToS16SSE, &clampFloatSSE, &mixAddS16SSE,
+    &s16ToFloatSSE, &peakFloatSSE, &peakS16SSE, &scaleFloatSSE, &scaleS16SSE, &mixAddResampledSSE,
+    &dotFloatSSE, "sse2"};
+
+// AVX2 Section
+//###################################################################################################################
+// Each kernel clears the upper halves (_mm256_zeroupper) before handing its tail to
+// the SSE version; legacy SSE code after dirty ymm registers costs hundreds of cycles.
+__attribute__((target("avx2")))
+void mixAddAVX2(float* destination, const float* source, size_t count, float gain) {
+    __m256 gainVector = _mm256_set1_ps(gain);
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16) {
+        __m256 low = _mm256_add_ps(_mm256_loadu_ps(destination + index),
+            _mm256_mul_ps(_mm256_loadu_ps(source + index), gainVector));
+        __m256 high = _mm256_add_ps(_mm256_loadu_ps(destination + index + 8),
+            _mm256_mul_ps(_mm256_loadu_ps(source + index + 8), gainVector));
+        _mm256_storeu_ps(destination + index, low);
+        _mm256_storeu_ps(destination + index + 8, high);
+    }
+    _mm256_zeroupper();
+    mixAddSSE(destination + index, source + index, count - index, gain);
+}
+
+__attribute__((target("avx2")))
+void floatToS16AVX2(int16_t* destination, const float* source, size_t count) {
+    const __m256 upper = _mm256_set1_ps(1.0f);
+    const __m256 lower = _mm256_set1_ps(-1.0f);
+    const __m256 scale = _mm256_set1_ps(s16Scale);
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16) {
+        __m256 low = _mm256_min_ps(upper, _mm256_max_ps(lower, _mm256_loadu_ps(source + index)));
+        __m256 high = _mm256_min_ps(upper, _mm256_max_ps(lower, _mm256_loadu_ps(source + index + 8)));
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(low, scale)),
+            _mm256_cvtps_epi32(_mm256_mul_ps(high, scale)));
+        // packs works per 128-bit lane; put the quarters back in order.
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + index), packed);
+    }
+    _mm256_zeroupper();
+    floatToS16SSE(destination + index, source + index, count - index);
+}
+
+__attribute__((target("avx2")))
+void clampFloatAVX2(float* destination, const float* source, size_t count) {
+    const __m256 upper = _mm256_set1_ps(1.0f);
+    const __m256 lower = _mm256_set1_ps(-1.0f);
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        _mm256_storeu_ps(destination + index,
+            _mm256_min_ps(upper, _mm256_max_ps(lower, _mm256_loadu_ps(source + index))));
+    }
+    _mm256_zeroupper();
+    clampFloatSSE(destination + index, source + index, count - index);
+}
+
+__attribute__((target("avx2")))
+inline __m256 loadS16AVX2(const int16_t* source) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source))));
+}
+
+__attribute__((target("avx2")))
+void mixAddS16AVX2(float* destination, const int16_t* source, size_t count, float gain) {
+    __m256 gainVector = _mm256_set1_ps(gain);
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16) {
+        __m256 low = _mm256_add_ps(_mm256_loadu_ps(destination + index),
+            _mm256_mul_ps(loadS16AVX2(source + index), gainVector));
+        __m256 high = _mm256_add_ps(_mm256_loadu_ps(destination + index + 8),
+            _mm256_mul_ps(loadS16AVX2(source + index + 8), gainVector));
+        _mm256_storeu_ps(destination + index, low);
+        _mm256_storeu_ps(destination + index + 8, high);
+    }
+    _mm256_zeroupper();
+    mixAddS16SSE(destination + index, source + index, count - index, gain);
+}
+
+__attribute__((target("avx2")))
+void s16ToFloatAVX2(float* destination, const int16_t* source, size_t count) {
+    __m256 scale = _mm256_set1_ps(s16ToFloatScale);
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16) {
+        _mm256_storeu_ps(destination + index, _mm256_mul_ps(loadS16AVX2(source + index), scale));
+        _mm256_storeu_ps(destination + index + 8, _mm256_mul_ps(loadS16AVX2(source + index + 8), scale));
+    }
+    _mm256_zeroupper();
+    s16ToFloatSSE(destination + index, source + index, count - index);
+}
+
+__attribute__((target("avx2")))
+float peakFloatAVX2(const float* source, size_t count) {
+    const __m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 peakVector = _mm256_setzero_ps();
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        peakVector = _mm256_max_ps(peakVector, _mm256_and_ps(_mm256_loadu_ps(source + index), magnitude));
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, peakVector);
+    _mm256_zeroupper();
+    float peak = peakFloatSSE(source + index, count - index);
+    for (float lane : lanes) {
+        peak = std::max(peak, lane);
+    }
+    return peak;
+}
+
+__attribute__((target("avx2")))
+int32_t peakS16AVX2(const int16_t* source, size_t count) {
+    __m256i highest = _mm256_setzero_si256();
+    __m256i lowest = _mm256_setzero_si256();
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16) {
+        __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + index));
+        highest = _mm256_max_epi16(highest, packed);
+        lowest = _mm256_min_epi16(lowest, packed);
+    }
+    int16_t highLanes[16];
+    int16_t lowLanes[16];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(highLanes), highest);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lowLanes), lowest);
+    _mm256_zeroupper();
+    int32_t peak = peakS16SSE(source + index, count - index);
+    for (int lane = 0; lane < 16; lane++) {
+        peak = std::max(peak, std::max<int32_t>(highLanes[lane], -static_cast<int32_t>(lowLanes[lane])));
+    }
+    return peak;
+}
+
+__attribute__((target("avx2")))
+void scaleFloatAVX2(float* destination, const float* source, size_t count, float gain) {
+    __m256 gainVector = _mm256_set1_ps(gain);
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16) {
+        _mm256_storeu_ps(destination + index, _mm256_mul_ps(_mm256_loadu_ps(source + index), gainVector));
+        _mm256_storeu_ps(destination + index + 8, _mm256_mul_ps(_mm256_loadu_ps(source + index + 8), gainVector));
+    }
+    _mm256_zeroupper();
+    scaleFloatSSE(destination + index, source + index, count - index, gain);
+}
+
+__attribute__((target("avx2")))
+void scaleS16AVX2(int16_t* destination, const int16_t* source, size_t count, float gain) {
+    const __m256 gainVector = _mm256_set1_ps(gain);
+    const __m256 upper = _mm256_set1_ps(32767.0f);
+    const __m256 lower = _mm256_set1_ps(-32768.0f);
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16) {
+        __m256 low = _mm256_min_ps(upper, _mm256_max_ps(lower, _mm256_mul_ps(loadS16AVX2(source + index), gainVector)));
+        __m256 high = _mm256_min_ps(upper,
+            _mm256_max_ps(lower, _mm256_mul_ps(loadS16AVX2(source + index + 8), gainVector)));
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(low), _mm256_cvtps_epi32(high));
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + index), packed);
+    }
+    _mm256_zeroupper();
+    scaleS16SSE(destination + index, source + index, count - index, gain);
+}
+
+__attribute__((target("avx2")))
+float dotFloatAVX2(const float* a, const float* b, size_t count) {
+    // Two accumulators so consecutive adds do not wait on each other.
+    __m256 sum = _mm256_setzero_ps();
+    __m256 sumHigh = _mm256_setzero_ps();
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16) {
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + index), _mm256_loadu_ps(b + index)));
+        sumHigh = _mm256_add_ps(sumHigh, _mm256_mul_ps(_mm256_loadu_ps(a + index + 8), _mm256_loadu_ps(b + index + 8)));
+    }
+    for (; index + 8 <= count; index += 8) {
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + index), _mm256_loadu_ps(b + index)));
+    }
+    sum = _mm256_add_ps(sum, sumHigh);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    float lanes[4];
+    _mm_storeu_ps(lanes, half);
+    _mm256_zeroupper();
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + dotFloatSSE(a + index, b + index, count - index);
+}
+
+__attribute__((target("avx2")))
+inline __m256 cubicHermiteAVX2(__m256 p0, __m256 p1, __m256 p2, __m256 p3, __m256 t) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    __m256 c1 = _mm256_mul_ps(half, _mm256_sub_ps(p2, p0));
+    __m256 c2 = _mm256_sub_ps(_mm256_add_ps(_mm256_sub_ps(p0, _mm256_mul_ps(_mm256_set1_ps(2.5f), p1)),
+        _mm256_mul_ps(_mm256_set1_ps(2.0f), p2)), _mm256_mul_ps(half, p3));
+    __m256 c3 = _mm256_add_ps(_mm256_mul_ps(half, _mm256_sub_ps(p3, p0)),
+        _mm256_mul_ps(_mm256_set1_ps(1.5f), _mm256_sub_ps(p1, p2)));
+    return _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(c3, t), c2), t), c1), t),
+        p1);
+}
+
+__attribute__((target("avx2")))
+size_t mixResampledLanesAVX2(float* destination, const float* source, int channels, const int32_t* offsets,
+    const float* fractions, size_t laneCount, float gain) {
+    __m256 gainVector = _mm256_set1_ps(gain);
+    size_t lane = 0;
+    for (; lane + 8 <= laneCount; lane += 8) {
+        __m256i offsetVector = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets + lane));
+        __m256 p0 = _mm256_i32gather_ps(source, offsetVector, 4);
+        __m256 p1 = _mm256_i32gather_ps(source + channels, offsetVector, 4);
+        __m256 p2 = _mm256_i32gather_ps(source + 2 * channels, offsetVector, 4);
+        __m256 p3 = _mm256_i32gather_ps(source + 3 * channels, offsetVector, 4);
+        __m256 value = cubicHermiteAVX2(p0, p1, p2, p3, _mm256_loadu_ps(fractions + lane));
+        _mm256_storeu_ps(destination + lane,
+            _mm256_add_ps(_mm256_loadu_ps(destination + lane), _mm256_mul_ps(value, gainVector)));
+    }
+    _mm256_zeroupper();
+    return lane + mixResampledLanesSSE(destination + lane, source, channels, offsets + lane, fractions + lane,
+        laneCount - lane, gain);
+}
+
+__attribute__((target("avx2")))
+void mixAddResampledAVX2(float* destination, const float* source, uint32_t sourceFrames, int channels,
+    uint64_t position, uint64_t step, size_t frameCount, float gain) {
+    mixAddResampledBlocks(destination, source, sourceFrames, channels, position, step, frameCount, gain,
+        &mixResampledLanesAVX2);
+}
+
+const MixKernelTable avx2Kernels = {&mixAddAVX2, &floatToS16AVX2, &clampFloatAVX2, &mixAddS16AVX2,
+    &s16ToFloatAVX2, &peakFloatAVX2, &peakS16AVX2, &scaleFloatAVX2, &scaleS16AVX2, &mixAddResampledAVX2,
+    &dotFloatAVX2, "avx2"};
+#endif
+
+#if defined(MIX_KERNELS_NEON)
+// NEON Section
+//###################################################################################################################
+void mixAddNEON(float* destination, const float* source, size_t count, float gain) {
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        float32x4_t low = vmlaq_n_f32(vld1q_f32(destination + index), vld1q_f32(source + index), gain);
+        float32x4_t high = vmlaq_n_f32(vld1q_f32(destination + index + 4), vld1q_f32(source + index + 4), gain);
+        vst1q_f32(destination + index, low);
+        vst1q_f32(destination + index + 4, high);
+    }
+    mixAddScalar(destination + index, source + index, count - index, gain);
+}
+
+inline int32x4_t roundToInt(float32x4_t value) {
+#if defined(__aarch64__)
+    return vcvtnq_s32_f32(value);
+#else
+    // ARMv7 only truncates; add half away from zero first.
+    float32x4_t half = vbslq_f32(vcltq_f32(value, vdupq_n_f32(0.0f)), vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+    return vcvtq_s32_f32(vaddq_f32(value, half));
+#endif
+}
+
+void floatToS16NEON(int16_t* destination, const float* source, size_t count) {
+    const float32x4_t upper = vdupq_n_f32(1.0f);
+    const float32x4_t lower = vdupq_n_f32(-1.0f);
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        float32x4_t low = vminq_f32(upper, vmaxq_f32(lower, vld1q_f32(source + index)));
+        float32x4_t high = vminq_f32(upper, vmaxq_f32(lower, vld1q_f32(source + index + 4)));
+        int16x8_t packed = vcombine_s16(vqmovn_s32(roundToInt(vmulq_n_f32(low, s16Scale))),
+            vqmovn_s32(roundToInt(vmulq_n_f32(high, s16Scale))));
+        vst1q_s16(destination + index, packed);
+    }
+    floatToS16Scalar(destination + index, source + index, count - index);
+}
+
+void clampFloatNEON(float* destination, const float* source, size_t count) {
+    const float32x4_t upper = vdupq_n_f32(1.0f);
+    const float32x4_t lower = vdupq_n_f32(-1.0f);
+    size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        vst1q_f32(destination + index, vminq_f32(upper, vmaxq_f32(lower, vld1q_f32(source + index))));
+    }
+    clampFloatScalar(destination + index, source + index, count - index);
+}
+
+inline void loadS16NEON(const int16_t* source, float32x4_t& low, float32x4_t& high) {
+    int16x8_t packed = vld1q_s16(source);
+    low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(packed)));
+    high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(packed)));
+}
+
+void mixAddS16NEON(float* destination, const int16_t* source, size_t count, float gain) {
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        float32x4_t low, high;
+        loadS16NEON(source + index, low, high);
+        vst1q_f32(destination + index, vmlaq_n_f32(vld1q_f32(destination + index), low, gain));
+        vst1q_f32(destination + index + 4, vmlaq_n_f32(vld1q_f32(destination + index + 4), high, gain));
+    }
+    mixAddS16Scalar(destination + index, source + index, count - index, gain);
+}
+
+void s16ToFloatNEON(float* destination, const int16_t* source, size_t count) {
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        float32x4_t low, high;
+        loadS16NEON(source + index, low, high);
+        vst1q_f32(destination + index, vmulq_n_f32(low, s16ToFloatScale));
+        vst1q_f32(destination + index + 4, vmulq_n_f32(high, s16ToFloatScale));
+    }
+    s16ToFloatScalar(destination + index, source + index, count - index);
+}
+
+float peakFloatNEON(const float* source, size_t count) {
+    float32x4_t peakVector = vdupq_n_f32(0.0f);
+    size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        peakVector = vmaxq_f32(peakVector, vabsq_f32(vld1q_f32(source + index)));
+    }
+    float lanes[4];
+    vst1q_f32(lanes, peakVector);
+    float peak = peakFloatScalar(source + index, count - index);
+    for (float lane : lanes) {
+        peak = std::max(peak, lane);
+    }
+    return peak;
+}
+
+int32_t peakS16NEON(const int16_t* source, size_t count) {
+    int16x8_t highest = vdupq_n_s16(0);
+    int16x8_t lowest = vdupq_n_s16(0);
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        int16x8_t packed = vld1q_s16(source + index);
+        highest = vmaxq_s16(highest, packed);
+        lowest = vminq_s16(lowest, packed);
+    }
+    int16_t highLanes[8];
+    int16_t lowLanes[8];
+    vst1q_s16(highLanes, highest);
+    vst1q_s16(lowLanes, lowest);
+    int32_t peak = peakS16Scalar(source + index, count - index);
+    for (int lane = 0; lane < 8; lane++) {
+        peak = std::max(peak, std::max<int32_t>(highLanes[lane], -static_cast<int32_t>(lowLanes[lane])));
+    }
+    return peak;
+}
+
+void scaleFloatNEON(float* destination, const float* source, size_t count, float gain) {
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        vst1q_f32(destination + index, vmulq_n_f32(vld1q_f32(source + index), gain));
+        vst1q_f32(destination + index + 4, vmulq_n_f32(vld1q_f32(source + index + 4), gain));
+    }
+    scaleFloatScalar(destination + index, source + index, count - index, gain);
+}
+
+void scaleS16NEON(int16_t* destination, const int16_t* source, size_t count, float gain) {
+    const float32x4_t upper = vdupq_n_f32(32767.0f);
+    const float32x4_t lower = vdupq_n_f32(-32768.0f);
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        float32x4_t low, high;
+        loadS16NEON(source + index, low, high);
+        low = vminq_f32(upper, vmaxq_f32(lower, vmulq_n_f32(low, gain)));
+        high = vminq_f32(upper, vmaxq_f32(lower, vmulq_n_f32(high, gain)));
+        vst1q_s16(destination + index, vcombine_s16(vqmovn_s32(roundToInt(low)), vqmovn_s32(roundToInt(high))));
+    }
+    scaleS16Scalar(destination + index, source + index, count - index, gain);
+}
+
+float dotFloatNEON(const float* a, const float* b, size_t count) {
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        sum = vaddq_f32(sum, vmulq_f32(vld1q_f32(a + index), vld1q_f32(b + index)));
+    }
+    float lanes[4];
+    vst1q_f32(lanes, sum);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + dotFloatScalar(a + index, b + index, count - index);
+}
+
+inline float32x4_t cubicHermiteNEON(float32x4_t p0, float32x4_t p1, float32x4_t p2, float32x4_t p3, float32x4_t t) {
+    // Plain multiplies and adds, never fused, so the result matches the scalar kernel.
+    float32x4_t c1 = vmulq_n_f32(vsubq_f32(p2, p0), 0.5f);
+    float32x4_t c2 = vsubq_f32(vaddq_f32(vsubq_f32(p0, vmulq_n_f32(p1, 2.5f)), vmulq_n_f32(p2, 2.0f)),
+        vmulq_n_f32(p3, 0.5f));
+    float32x4_t c3 = vaddq_f32(vmulq_n_f32(vsubq_f32(p3, p0), 0.5f), vmulq_n_f32(vsubq_f32(p1, p2), 1.5f));
+    return vaddq_f32(vmulq_f32(vaddq_f32(vmulq_f32(vaddq_f32(vmulq_f32(c3, t), c2), t), c1), t), p1);
+}
+
+size_t mixResampledLanesNEON(float* destination, const float* source, int channels, const int32_t* offsets,
+    const float* fractions, size_t laneCount, float gain) {
+    size_t lane = 0;
+    for (; lane + 4 <= laneCount; lane += 4) {
+        float taps[4][4];
+        for (int index = 0; index < 4; index++) {
+            const float* tap = source + offsets[lane + index];
+            taps[0][index] = tap[0];
+            taps[1][index] = tap[channels];
+            taps[2][index] = tap[2 * channels];
+            taps[3][index] = tap[3 * channels];
+        }
+        float32x4_t value = cubicHermiteNEON(vld1q_f32(taps[0]), vld1q_f32(taps[1]), vld1q_f32(taps[2]),
+            vld1q_f32(taps[3]), vld1q_f32(fractions + lane));
+        vst1q_f32(destination + lane, vaddq_f32(vld1q_f32(destination + lane), vmulq_n_f32(value, gain)));
+    }
+    return lane;
+}
+
+void mixAddResampledNEON(float* destination, const float* source, uint32_t sourceFrames, int channels,
+    uint64_t position, uint64_t step, size_t frameCount, float gain) {
+    mixAddResampledBlocks(destination, source, sourceFrames, channels, position, step, frameCount, gain,
+        &mixResampledLanesNEON);
+}
+
+const MixKernelTable neonKernels = {&mixAddNEON, &floatToS16NEON, &clampFloatNEON, &mixAddS16NEON,
+    &s16ToFloatNEON, &peakFloatNEON, &peakS16NEON, &scaleFloatNEON, &scaleS16NEON, &mixAddResampledNEON,
+    &dotFloatNEON, "neon"};
+#endif
+
+const MixKernelTable& selectKernels() {
+#if defined(MIX_KERNELS_X86) && defined(__SSE2__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2Kernels;
+    }
+    return sseKernels;
+#elif defined(MIX_KERNELS_NEON)
+    return neonKernels;
+#else
+    return scalarKernels;
+#endif
+}
+}
+
+const MixKernelTable& MixKernels::get() {
+    static const MixKernelTable& kernels = selectKernels();
+    return kernels;
+}
+
+const MixKernelTable& MixKernels::getScalar() {
+    return scalarKernels;
+}
+
+std::vector<const MixKernelTable*> MixKernels::getSupported() {
+    std::vector<const MixKernelTable*> supported(1, &scalarKernels);
+#if defined(MIX_KERNELS_X86) && defined(__SSE2__)
+    supported.push_back(&sseKernels);
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        supported.push_back(&avx2Kernels);
+    }
+#elif defined(MIX_KERNELS_NEON)
+    supported.push_back(&neonKernels);
+#endif
+    return supported;
+}
@@ -0,0 +1,63 @@
+#ifndef MIX_KERNELS_H
+#define MIX_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 4-point, 3rd-order Hermite (Catmull-Rom) interpolation between p1 (t = 0)
+// and p2 (t = 1). The resampling kernels all evaluate it in this order.
+inline float cubicHermite(float p0, float p1, float p2, float p3, float t) {
+    float c1 = 0.5f * (p2 - p0);
+    float c2 = p0 - 2.5f * p1 + 2.0f * p2 - 0.5f * p3;
+    float c3 = 0.5f * (p3 - p0) + 1.5f * (p1 - p2);
+    return ((c3 * t + c2) * t + c1) * t + p1;
+}
+
+// Fraction of a 32.32 fixed-point frame position, to 24 bits so it is exact in a float.
+inline float getPositionFraction(uint64_t position) {
+    return static_cast<float>(static_cast<uint32_t>(position) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Inner loops of the voice mixer and the AudioProcessor. Every kernel handles
+// any count, including unaligned pointers and a scalar tail, and the vector
+// versions give the same results as the scalar ones, except dotFloat whose
+// vector sums are added in a different order.
+struct MixKernelTable {
+    // destination[i] += source[i] * gain
+    void (*mixAdd)(float* destination, const float* source, size_t count, float gain);
+    // Clamp to [-1, 1] and scale to 16-bit with saturation.
+    void (*floatToS16)(int16_t* destination, const float* source, size_t count);
+    // Clamp to [-1, 1].
+    void (*clampFloat)(float* destination, const float* source, size_t count);
+    // destination[i] += source[i] * gain, for 16-bit sources mixed into a float bus.
+    void (*mixAddS16)(float* destination, const int16_t* source, size_t count, float gain);
+    // 16-bit to float on a 1.0 full scale.
+    void (*s16ToFloat)(float* destination, const int16_t* source, size_t count);
+    // Largest absolute sample; 0..32768 for the 16-bit version.
+    float (*peakFloat)(const float* source, size_t count);
+    int32_t (*peakS16)(const int16_t* source, size_t count);
+    // destination[i] = source[i] * gain, in place is fine. The 16-bit version rounds and saturates.
+    void (*scaleFloat)(float* destination, const float* source, size_t count, float gain);
+    void (*scaleS16)(int16_t* destination, const int16_t* source, size_t count, float gain);
+    // Adds frameCount frames of source played at a different rate:
+    // destination[frame * channels + c] += cubicHermite(source around position + frame * step) * gain.
+    // position and step are 32.32 fixed-point frames; taps outside [0, sourceFrames) read as silence.
+    void (*mixAddResampled)(float* destination, const float* source, uint32_t sourceFrames, int channels,
+        uint64_t position, uint64_t step, size_t frameCount, float gain);
+    // Sum of a[i] * b[i], e.g. one phase of the sample-rate converter's filter.
+    float (*dotFloat)(const float* a, const float* b, size_t count);
+    const char* name;
+};
+
+// Picks the widest instruction set the CPU supports once, at first use:
+// AVX2 or SSE on x86, NEON on ARM, plain C++ elsewhere.
+class MixKernels {
+    public:
+        static const MixKernelTable& get();
+        static const MixKernelTable& getScalar();
+        // Every table this CPU can run, scalar first, for checking them against each other.
+        static std::vector<const MixKernelTable*> getSupported();
+};
+
+#endif // MIX_KERNELS_H
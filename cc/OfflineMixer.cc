@@ -0,0 +1,208 @@
+#include "OfflineMixer.h"
+#include <algorithm>
+#include <cstring>
+
+const size_t OfflineMixer::blockFrames;
+
+namespace {
+void writeLittleEndian(std::FILE* file, uint32_t value, size_t bytes) {
+    for (size_t index = 0; index < bytes; index++) {
+        std::fputc(static_cast<int>((value >> (8 * index)) & 0xFF), file);
+    }
+}
+}
+
+OfflineMixer::OfflineMixer(ClockSource& clockSource, bool verbose) :
+    clockSource(clockSource), voiceEngine(nullptr), verbose(verbose), kernels(MixKernels::get()), wavFile(nullptr),
+    frequency(0), channels(0), format(0), bytesPerSample(0),
+    renderedFrames(0), peakClipCount(0), nextVoiceId(1) {}
+
+OfflineMixer::~OfflineMixer() {
+    close();
+}
+// File Section
+//###################################################################################################################
+void OfflineMixer::setVoiceEngine(VoiceEngine* engine) {
+    voiceEngine = engine;
+}
+
+bool OfflineMixer::open(const std::string& filepath) {
+    if (voiceEngine != nullptr) {
+        frequency = voiceEngine->getFrequency();
+        format = voiceEngine->getFormat();
+        channels = voiceEngine->getChannels();
+    } else if (Mix_QuerySpec(&frequency, &format, &channels) == 0) {
+        printf("   ---OfflineMixer::open::Mixer not opened: %s\n", Mix_GetError());
+        return false;
+    }
+    if (format == AUDIO_S16SYS) {
+        bytesPerSample = sizeof(int16_t);
+    } else if (format == AUDIO_F32SYS) {
+        bytesPerSample = sizeof(float);
+    } else {
+        printf("   ---OfflineMixer::open::Unsupported mixer format 0x%x.\n", format);
+        return false;
+    }
+    wavFile = std::fopen(filepath.c_str(), "wb");
+    if (wavFile == nullptr) {
+        printf("   ---OfflineMixer::open::Could not open %s.\n", filepath.c_str());
+        return false;
+    }
+    // Sizes are patched in close() once the length is known.
+    writeHeader(0);
+    startTime = clockSource.now();
+    renderedFrames = 0;
+    peakClipCount = 0;
+    mixBuffer.assign(blockFrames * channels, 0.0f);
+    outputBuffer.assign(blockFrames * channels * bytesPerSample, 0);
+    if (verbose) {
+        printf("   OfflineMixer::open::%s at %d Hz, %d channels, %s.\n", filepath.c_str(), frequency,
+            channels, format == AUDIO_F32SYS ? "float" : "16-bit");
+    }
+    return true;
+}
+
+void OfflineMixer::close() {
+    if (wavFile == nullptr) {
+        return;
+    }
+    uint64_t dataBytes = renderedFrames * channels * bytesPerSample;
+    std::fseek(wavFile, 0, SEEK_SET);
+    writeHeader(static_cast<uint32_t>(std::min<uint64_t>(dataBytes, 0xFFFFFFFFu - 36)));
+    std::fclose(wavFile);
+    wavFile = nullptr;
+    printf("   OfflineMixer::close::Rendered %.2f s of audio.\n",
+        frequency > 0 ? static_cast<double>(renderedFrames) / frequency : 0.0);
+    if (peakClipCount > 0) {
+        printf("   ---OfflineMixer::close::%llu samples clipped.\n", static_cast<unsigned long long>(peakClipCount));
+    }
+}
+
+void OfflineMixer::writeHeader(uint32_t dataBytes) {
+    uint16_t formatTag = format == AUDIO_F32SYS ? 3 : 1; // IEEE float : PCM
+    uint32_t blockAlign = static_cast<uint32_t>(channels * bytesPerSample);
+    std::fwrite("RIFF", 1, 4, wavFile);
+    writeLittleEndian(wavFile, 36 + dataBytes, 4);
+    std::fwrite("WAVEfmt ", 1, 8, wavFile);
+    writeLittleEndian(wavFile, 16, 4);
+    writeLittleEndian(wavFile, formatTag, 2);
+    writeLittleEndian(wavFile, static_cast<uint32_t>(channels), 2);
+    writeLittleEndian(wavFile, static_cast<uint32_t>(frequency), 4);
+    writeLittleEndian(wavFile, static_cast<uint32_t>(frequency) * blockAlign, 4);
+    writeLittleEndian(wavFile, blockAlign, 2);
+    writeLittleEndian(wavFile, static_cast<uint32_t>(bytesPerSample * 8), 2);
+    std::fwrite("data", 1, 4, wavFile);
+    writeLittleEndian(wavFile, dataBytes, 4);
+}
+// Voice Section
+//###################################################################################################################
+uint32_t OfflineMixer::playChunk(const Mix_Chunk* chunk) {
+    if (chunk == nullptr || wavFile == nullptr) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(voicesMutex);
+    // Never start before what has already been written.
+    Voice voice = {chunk, std::max(getFrameAt(clockSource.now()), renderedFrames), 0, nextVoiceId++};
+    if (nextVoiceId == 0) {
+        nextVoiceId = 1;
+    }
+    voices.push_back(voice);
+    return voice.id;
+}
+
+void OfflineMixer::halt(uint32_t voiceId) {
+    std::lock_guard<std::mutex> lock(voicesMutex);
+    voices.erase(std::remove_if(voices.begin(), voices.end(), [voiceId](const Voice& voice) {
+        return voice.id == voiceId;
+    }), voices.end());
+}
+
+void OfflineMixer::haltChunk(const Mix_Chunk* chunk) {
+    std::lock_guard<std::mutex> lock(voicesMutex);
+    voices.erase(std::remove_if(voices.begin(), voices.end(), [chunk](const Voice& voice) {
+        return voice.chunk == chunk;
+    }), voices.end());
+}
+
+void OfflineMixer::haltAll() {
+    std::lock_guard<std::mutex> lock(voicesMutex);
+    voices.clear();
+}
+
+uint64_t OfflineMixer::getFrameAt(TimePoint time) const {
+    if (time <= startTime) {
+        return 0;
+    }
+    int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(time - startTime).count();
+    // Split to keep the product in range for long sessions.
+    return static_cast<uint64_t>(nanoseconds / 1000000000) * frequency +
+        static_cast<uint64_t>(nanoseconds % 1000000000) * frequency / 1000000000;
+}
+
+uint64_t OfflineMixer::getRenderedFrames() const {
+    return renderedFrames;
+}
+// Render Section
+//###################################################################################################################
+void OfflineMixer::renderUntil(TimePoint time) {
+    if (wavFile == nullptr) {
+        return;
+    }
+    uint64_t targetFrame = getFrameAt(time);
+    std::lock_guard<std::mutex> lock(voicesMutex);
+    while (renderedFrames < targetFrame) {
+        size_t frameCount = static_cast<size_t>(std::min<uint64_t>(blockFrames, targetFrame - renderedFrames));
+        if (voiceEngine != nullptr) {
+            voiceEngine->render(mixBuffer.data(), frameCount);
+        } else {
+            mixBlock(renderedFrames, frameCount);
+        }
+        writeBlock(frameCount);
+        renderedFrames += frameCount;
+    }
+}
+
+void OfflineMixer::mixBlock(uint64_t blockStart, size_t frameCount) {
+    std::fill(mixBuffer.begin(), mixBuffer.begin() + frameCount * channels, 0.0f);
+    size_t frameBytes = channels * bytesPerSample;
+    for (Voice& voice : voices) {
+        if (voice.startFrame >= blockStart + frameCount) {
+            continue;
+        }
+        uint64_t totalFrames = voice.chunk->alen / frameBytes;
+        size_t offset = static_cast<size_t>(voice.startFrame > blockStart ? voice.startFrame - blockStart : 0);
+        size_t count = static_cast<size_t>(std::min<uint64_t>(frameCount - offset, totalFrames - voice.position));
+        size_t sampleCount = count * channels;
+        float* destination = &mixBuffer[offset * channels];
+        if (format == AUDIO_F32SYS) {
+            const float* source = reinterpret_cast<const float*>(voice.chunk->abuf) + voice.position * channels;
+            kernels.mixAdd(destination, source, sampleCount, 1.0f);
+        } else {
+            const int16_t* source = reinterpret_cast<const int16_t*>(voice.chunk->abuf) + voice.position * channels;
+            kernels.mixAddS16(destination, source, sampleCount, 1.0f / 32768.0f);
+        }
+        voice.position += count;
+    }
+    // Drop finished voices.
+    voices.erase(std::remove_if(voices.begin(), voices.end(), [frameBytes](const Voice& voice) {
+        return voice.position >= voice.chunk->alen / frameBytes;
+    }), voices.end());
+}
+
+void OfflineMixer::writeBlock(size_t frameCount) {
+    size_t sampleCount = frameCount * channels;
+    for (size_t index = 0; index < sampleCount; index++) {
+        float sample = mixBuffer[index];
+        if (sample > 1.0f || sample < -1.0f) {
+            peakClipCount++;
+            sample = std::min(1.0f, std::max(-1.0f, sample));
+        }
+        if (format == AUDIO_F32SYS) {
+            std::memcpy(&outputBuffer[index * sizeof(float)], &sample, sizeof(float));
+        } else {
+            int16_t value = static_cast<int16_t>(sample * 32767.0f);
+            std::memcpy(&outputBuffer[index * sizeof(int16_t)], &value, sizeof(int16_t));
+        }
+    }
+    std::fwrite(outputBuffer.data(), 1, sampleCount * bytesPerSample, wavFile);
+}
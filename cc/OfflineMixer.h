@@ -0,0 +1,78 @@
+#ifndef OFFLINE_MIXER_H
+#define OFFLINE_MIXER_H
+
+#ifdef _WIN32
+#include <SDL.h> // Include path for Windows
+#include <SDL_mixer.h>
+#else
+#include <SDL2/SDL.h> // Include path for Linux
+#include <SDL2/SDL_mixer.h>
+#endif
+#include "ClockSource.h"
+#include "MixKernels.h"
+#include "VoiceEngine.h"
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Stand-in for the audio device while rendering offline. With a VoiceEngine
+// the render pulls mixed blocks from its voice pool. Otherwise players hand
+// it their SDL_mixer chunks instead of calling Mix_PlayChannel; each chunk
+// starts at the sample frame matching the clock's current time. Either way
+// the file uses the output's rate, channel count and sample format.
+class OfflineMixer {
+    public:
+        OfflineMixer(ClockSource& clockSource, bool verbose = false);
+        ~OfflineMixer();
+
+        // Call before open(); the file then takes the engine's spec.
+        void setVoiceEngine(VoiceEngine* engine);
+        bool open(const std::string& filepath);
+        void close();
+        // Returns an id for halt(), never 0.
+        uint32_t playChunk(const Mix_Chunk* chunk);
+        void halt(uint32_t voiceId);
+        // Drops every voice of chunk so it can be freed.
+        void haltChunk(const Mix_Chunk* chunk);
+        void haltAll();
+        // Mixes and writes every frame before the given time.
+        void renderUntil(TimePoint time);
+        uint64_t getRenderedFrames() const;
+
+    private:
+        struct Voice {
+            const Mix_Chunk* chunk;
+            uint64_t startFrame;
+            uint64_t position; // frames already mixed
+            uint32_t id;
+        };
+
+        static const size_t blockFrames = 1024;
+
+        uint64_t getFrameAt(TimePoint time) const;
+        void mixBlock(uint64_t blockStart, size_t frameCount);
+        void writeBlock(size_t frameCount);
+        void writeHeader(uint32_t dataBytes);
+
+        ClockSource& clockSource;
+        VoiceEngine* voiceEngine;
+        bool verbose;
+        const MixKernelTable& kernels;
+        std::FILE* wavFile;
+        TimePoint startTime;
+        int frequency;
+        int channels;
+        Uint16 format;
+        size_t bytesPerSample;
+        uint64_t renderedFrames;
+        uint64_t peakClipCount;
+        uint32_t nextVoiceId;
+        std::vector<Voice> voices;
+        std::vector<float> mixBuffer;
+        std::vector<uint8_t> outputBuffer;
+        std::mutex voicesMutex;
+};
+
+#endif // OFFLINE_MIXER_H
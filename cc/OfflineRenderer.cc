@@ -0,0 +1,60 @@
+#include "OfflineRenderer.h"
+#include <cstdio>
+
+OfflineRenderer::OfflineRenderer(MasterClock& mc, VirtualClockSource& virtualClock, Manager& manager,
+    OfflineMixer& mixer, bool verbose) :
+    masterClock(mc), virtualClock(virtualClock), manager(manager), mixer(mixer),
+    verbose(verbose), events(nullptr), nextEvent(0) {}
+
+OfflineRenderer::~OfflineRenderer() {
+    virtualClock.setAdvanceHandler(nullptr);
+}
+
+bool OfflineRenderer::render(const std::vector<SessionEvent>& sessionEvents, Duration tail) {
+    events = &sessionEvents;
+    nextEvent = 0;
+    TimePoint startTime = masterClock.getStartTime();
+    Duration lastEvent = sessionEvents.empty() ? Duration(0)
+        : std::chrono::duration_cast<Duration>(std::chrono::nanoseconds(sessionEvents.back().time));
+    endTime = startTime + lastEvent + tail;
+    if (verbose) {
+        printf("   OfflineRenderer::render::%zu events, %.2f s.\n", sessionEvents.size(),
+            std::chrono::duration<double>(endTime - startTime).count());
+    }
+    virtualClock.setAdvanceHandler([this](TimePoint from, TimePoint to) {
+        advance(from, to);
+    });
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    masterClock.executeScheduledBatches();
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    virtualClock.setAdvanceHandler(nullptr);
+    mixer.renderUntil(endTime);
+
+    double sessionSeconds = std::chrono::duration<double>(endTime - startTime).count();
+    printf("   OfflineRenderer::render::Rendered %.2f s in %.2f s (%.1fx real time).\n",
+        sessionSeconds, wallSeconds, wallSeconds > 0.0 ? sessionSeconds / wallSeconds : 0.0);
+    return nextEvent == sessionEvents.size();
+}
+
+void OfflineRenderer::advance(TimePoint from, TimePoint to) {
+    TimePoint startTime = masterClock.getStartTime();
+    // Step through the jump one event at a time so each key lands, and its
+    // audio starts, at the recorded offset rather than at the next deadline.
+    while (nextEvent < events->size()) {
+        const SessionEvent& event = (*events)[nextEvent];
+        TimePoint eventTime = startTime + std::chrono::duration_cast<Duration>(std::chrono::nanoseconds(event.time));
+        if (eventTime > to) {
+            break;
+        }
+        if (eventTime > from) {
+            virtualClock.setTime(eventTime);
+        }
+        mixer.renderUntil(virtualClock.now());
+        manager.injectKeyEvent(event.scancode, event.down);
+        nextEvent++;
+    }
+    mixer.renderUntil(to);
+    if (to >= endTime) {
+        masterClock.stop();
+    }
+}
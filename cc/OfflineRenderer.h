@@ -0,0 +1,40 @@
+#ifndef OFFLINE_RENDERER_H
+#define OFFLINE_RENDERER_H
+
+#include "ClockSource.h"
+#include "Manager.h"
+#include "MasterClock.h"
+#include "OfflineMixer.h"
+#include "SessionRecorder.h"
+#include <string>
+#include <vector>
+
+// Replays a recorded session into a WAV file faster than real time. The
+// MasterClock runs on a VirtualClockSource, so every wait returns at once;
+// while the clock jumps to its next deadline the renderer injects the key
+// events that fall inside the jump and mixes audio up to each of them. The
+// clock loop runs on the calling thread and batches run inline, so the same
+// session and config always produce the same file.
+class OfflineRenderer {
+    public:
+        OfflineRenderer(MasterClock& mc, VirtualClockSource& virtualClock, Manager& manager,
+            OfflineMixer& mixer, bool verbose = false);
+        ~OfflineRenderer();
+
+        // Blocks until the last event plus the tail has been rendered.
+        bool render(const std::vector<SessionEvent>& events, Duration tail);
+
+    private:
+        void advance(TimePoint from, TimePoint to);
+
+        MasterClock& masterClock;
+        VirtualClockSource& virtualClock;
+        Manager& manager;
+        OfflineMixer& mixer;
+        bool verbose;
+        const std::vector<SessionEvent>* events;
+        size_t nextEvent;
+        TimePoint endTime;
+};
+
+#endif // OFFLINE_RENDERER_H
@@ -0,0 +1,251 @@
+#include "PrecisionWait.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <cstring>
+#endif
+
+const size_t PrecisionWait::histogramBuckets;
+
+namespace {
+const Duration calibrationSleep = std::chrono::milliseconds(1);
+// Extra headroom on top of the measured overshoot before switching to spinning.
+const Duration calibrationSafety = std::chrono::microseconds(50);
+// Spin mode only spins this close to a deadline; an idle clock waits on the condition variable.
+const Duration maxSpinDuration = std::chrono::milliseconds(2);
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#endif
+}
+}
+
+PrecisionWait::PrecisionWait(bool verbose) :
+    mode(WaitMode::Sleep), spinYield(true), verbose(verbose),
+    realtimePriority(0), cpuCore(-1), calibrationSamples(100),
+    sleepMargin(std::chrono::microseconds(500)),
+    wakeupErrorHistogram(histogramBuckets, 0), wakeupCount(0), interruptedWakeupCount(0), wakeupErrorSum(0),
+    maxWakeupError(Duration(0)), interrupted(false) {}
+
+PrecisionWait::~PrecisionWait() {}
+// Config Section
+//###################################################################################################################
+void PrecisionWait::configure(WaitMode newMode, bool newSpinYield, int newRealtimePriority,
+    int newCpuCore, int newCalibrationSamples) {
+    mode = newMode;
+    spinYield = newSpinYield;
+    realtimePriority = newRealtimePriority;
+    cpuCore = newCpuCore;
+    calibrationSamples = std::max(1, newCalibrationSamples);
+}
+
+WaitMode PrecisionWait::parseWaitMode(const std::string& modeName) {
+    if (modeName == "hybrid") {
+        return WaitMode::Hybrid;
+    } else if (modeName == "spin") {
+        return WaitMode::Spin;
+    } else if (modeName != "sleep") {
+        printf("   ---PrecisionWait::parseWaitMode::Unknown wait_mode '%s', using sleep.\n", modeName.c_str());
+    }
+    return WaitMode::Sleep;
+}
+
+const char* PrecisionWait::getWaitModeName(WaitMode waitMode) {
+    switch (waitMode) {
+        case WaitMode::Hybrid:
+            return "hybrid";
+        case WaitMode::Spin:
+            return "spin";
+        default:
+            return "sleep";
+    }
+}
+
+void PrecisionWait::applyThreadPolicy() {
+#ifdef __linux__
+    setRealtimePriority(realtimePriority, verbose);
+    if (cpuCore >= 0) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpuCore, &cpuSet);
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+        if (result != 0) {
+            printf("   ---PrecisionWait::applyThreadPolicy::Pinning to core %d failed: %s\n",
+                cpuCore, strerror(result));
+        } else if (verbose) {
+            printf("   PrecisionWait::applyThreadPolicy::Pinned to core %d.\n", cpuCore);
+        }
+    }
+#else
+    if (realtimePriority > 0 || cpuCore >= 0) {
+        printf("   ---PrecisionWait::applyThreadPolicy::Thread priority/affinity only supported on Linux.\n");
+    }
+#endif
+}
+
+bool PrecisionWait::setRealtimePriority(int priority, bool verbose) {
+    if (priority <= 0) {
+        return false;
+    }
+#ifdef __linux__
+    sched_param param;
+    param.sched_priority = std::min(priority, sched_get_priority_max(SCHED_FIFO));
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (result != 0) {
+        printf("   ---PrecisionWait::setRealtimePriority::SCHED_FIFO %d failed: %s\n",
+            param.sched_priority, strerror(result));
+        return false;
+    }
+    if (verbose) {
+        printf("   PrecisionWait::setRealtimePriority::SCHED_FIFO priority %d.\n", param.sched_priority);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PrecisionWait::calibrate() {
+    if (mode != WaitMode::Hybrid) {
+        return;
+    }
+    // Measure how late the OS wakes us from a short sleep and keep that much
+    // of every wait for spinning.
+    std::vector<Duration> overshoots;
+    overshoots.reserve(calibrationSamples);
+    for (int i = 0; i < calibrationSamples; i++) {
+        TimePoint requested = std::chrono::high_resolution_clock::now() + calibrationSleep;
+        std::this_thread::sleep_until(requested);
+        overshoots.push_back(std::chrono::high_resolution_clock::now() - requested);
+    }
+    std::sort(overshoots.begin(), overshoots.end());
+    size_t p99Index = std::min(overshoots.size() - 1, overshoots.size() * 99 / 100);
+    sleepMargin = overshoots[p99Index] + calibrationSafety;
+    printf("   PrecisionWait::calibrate::Sleep overshoot p50 %lld us, p99 %lld us, margin %lld us.\n",
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(overshoots[overshoots.size() / 2]).count()),
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(overshoots[p99Index]).count()),
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(sleepMargin).count()));
+}
+// Wait Section
+//###################################################################################################################
+Duration PrecisionWait::waitUntil(TimePoint deadline) {
+    TimePoint now = std::chrono::high_resolution_clock::now();
+    if (deadline <= now) {
+        return Duration(0);
+    }
+    switch (mode) {
+        case WaitMode::Hybrid:
+            sleepUntil(deadline - sleepMargin);
+            spinUntil(deadline);
+            break;
+        case WaitMode::Spin:
+            if (deadline - now > maxSpinDuration) {
+                sleepUntil(deadline - maxSpinDuration);
+            }
+            spinUntil(deadline);
+            break;
+        default:
+            sleepUntil(deadline);
+            break;
+    }
+    if (interrupted.exchange(false, std::memory_order_acq_rel)) {
+        // Woken for new work rather than by the deadline, so this is not a wakeup error sample.
+        interruptedWakeupCount.fetch_add(1, std::memory_order_relaxed);
+        return Duration(0);
+    }
+    Duration error = std::chrono::high_resolution_clock::now() - deadline;
+    recordWakeupError(error);
+    return error;
+}
+
+void PrecisionWait::interrupt() {
+    if (interrupted.load(std::memory_order_acquire)) {
+        // Already notified; the waiter has not consumed that wakeup yet.
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        interrupted.store(true, std::memory_order_release);
+    }
+    wakeCondition.notify_one();
+}
+
+void PrecisionWait::sleepUntil(TimePoint deadline) {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeCondition.wait_until(lock, deadline, [this]() {
+        return interrupted.load(std::memory_order_acquire);
+    });
+}
+
+void PrecisionWait::spinUntil(TimePoint deadline) const {
+    while (std::chrono::high_resolution_clock::now() < deadline && !interrupted.load(std::memory_order_acquire)) {
+        if (spinYield) {
+            std::this_thread::yield();
+        } else {
+            cpuRelax();
+        }
+    }
+}
+
+Duration PrecisionWait::getSleepMargin() const {
+    return sleepMargin;
+}
+// Report Section
+//###################################################################################################################
+void PrecisionWait::recordWakeupError(Duration error) {
+    int64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(error).count();
+    size_t bucket = static_cast<size_t>(std::min<int64_t>(std::max<int64_t>(microseconds, 0), histogramBuckets - 1));
+    wakeupErrorHistogram[bucket]++;
+    wakeupCount.fetch_add(1, std::memory_order_relaxed);
+    wakeupErrorSum += microseconds;
+    maxWakeupError = std::max(maxWakeupError, error);
+}
+
+Duration PrecisionWait::getWakeupErrorPercentile(double percentile) const {
+    uint64_t wakeups = getWakeupCount();
+    if (wakeups == 0) {
+        return Duration(0);
+    }
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * wakeups)));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < wakeupErrorHistogram.size(); bucket++) {
+        seen += wakeupErrorHistogram[bucket];
+        if (seen >= target) {
+            return std::chrono::microseconds(bucket);
+        }
+    }
+    return maxWakeupError;
+}
+
+Duration PrecisionWait::getMaxWakeupError() const {
+    return maxWakeupError;
+}
+
+uint64_t PrecisionWait::getWakeupCount() const {
+    return wakeupCount.load(std::memory_order_relaxed);
+}
+
+uint64_t PrecisionWait::getInterruptedWakeupCount() const {
+    return interruptedWakeupCount.load(std::memory_order_relaxed);
+}
+
+void PrecisionWait::printReport() const {
+    uint64_t wakeups = getWakeupCount();
+    if (wakeups == 0) {
+        return;
+    }
+    printf("   PrecisionWait::Report::Mode: %s, wakeups: %llu, interrupted wakeups: %llu\n", getWaitModeName(mode),
+        static_cast<unsigned long long>(wakeups), static_cast<unsigned long long>(getInterruptedWakeupCount()));
+    printf("   PrecisionWait::Report::Wakeup error mean %lld us, p50 %lld us, p99 %lld us, max %lld us.\n",
+        static_cast<long long>(wakeupErrorSum / static_cast<int64_t>(wakeups)),
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(getWakeupErrorPercentile(50.0)).count()),
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(getWakeupErrorPercentile(99.0)).count()),
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(maxWakeupError).count()));
+}
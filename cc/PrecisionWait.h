@@ -0,0 +1,79 @@
+#ifndef PRECISION_WAIT_H
+#define PRECISION_WAIT_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using Duration = std::chrono::high_resolution_clock::duration;
+using TimePoint = std::chrono::high_resolution_clock::time_point;
+
+enum class WaitMode {
+    Sleep,  // plain sleep_until; cheapest, least precise
+    Hybrid, // sleep until the calibrated margin before the deadline, then spin
+    Spin    // spin for the whole wait; most precise, burns a core while a deadline is near
+};
+
+// Waits for scheduler deadlines with a selectable precision/CPU trade-off and
+// keeps a histogram of the achieved wakeup error so the modes can be compared.
+// applyThreadPolicy and calibrate must be called from the thread that waits.
+class PrecisionWait {
+    public:
+        explicit PrecisionWait(bool verbose = false);
+        ~PrecisionWait();
+
+        void configure(WaitMode mode, bool spinYield, int realtimePriority, int cpuCore, int calibrationSamples);
+        static WaitMode parseWaitMode(const std::string& modeName);
+        static const char* getWaitModeName(WaitMode mode);
+
+        void applyThreadPolicy();
+        // SCHED_FIFO for the calling thread; also used for the clock's worker threads.
+        static bool setRealtimePriority(int priority, bool verbose);
+        void calibrate();
+        // Returns the wakeup error (actual wakeup - deadline), or zero when interrupted.
+        // Spin mode sleeps first when the deadline is unbounded or far away.
+        Duration waitUntil(TimePoint deadline);
+        // Ends the current wait early, or the next one if the waiter is busy. Any thread;
+        // interrupts that arrive before the waiter has seen the first one are merged into it.
+        void interrupt();
+
+        Duration getSleepMargin() const;
+        Duration getWakeupErrorPercentile(double percentile) const;
+        Duration getMaxWakeupError() const;
+        // Deadline wakeups; only these feed the wakeup error histogram.
+        uint64_t getWakeupCount() const;
+        // Waits ended early by interrupt().
+        uint64_t getInterruptedWakeupCount() const;
+        void printReport() const;
+
+    private:
+        void sleepUntil(TimePoint deadline);
+        void spinUntil(TimePoint deadline) const;
+        void recordWakeupError(Duration error);
+
+        static const size_t histogramBuckets = 20000; // 1 us buckets, last one is overflow
+
+        WaitMode mode;
+        bool spinYield;
+        bool verbose;
+        int realtimePriority;
+        int cpuCore;
+        int calibrationSamples;
+        Duration sleepMargin;
+
+        std::vector<uint32_t> wakeupErrorHistogram;
+        std::atomic<uint64_t> wakeupCount;
+        std::atomic<uint64_t> interruptedWakeupCount;
+        int64_t wakeupErrorSum;
+        Duration maxWakeupError;
+
+        std::mutex wakeMutex;
+        std::condition_variable wakeCondition;
+        std::atomic<bool> interrupted;
+};
+
+#endif // PRECISION_WAIT_H
@@ -0,0 +1,307 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <unordered_map>
+
+const size_t Profiler::maxProbes;
+const size_t Profiler::maxThreads;
+const size_t Profiler::histogramBuckets;
+const ProbeId Profiler::invalidProbe = std::numeric_limits<ProbeId>::max();
+
+namespace {
+std::atomic<uint64_t> nextInstanceId(1);
+
+// Profilers still alive, so a thread exiting after its profiler is gone does not touch freed memory.
+// Leaked on purpose: threads may still exit after static destructors have run.
+std::mutex& getLiveProfilersMutex() {
+    static std::mutex* mutex = new std::mutex();
+    return *mutex;
+}
+
+std::unordered_map<uint64_t, Profiler*>& getLiveProfilers() {
+    static std::unordered_map<uint64_t, Profiler*>* profilers = new std::unordered_map<uint64_t, Profiler*>();
+    return *profilers;
+}
+}
+
+struct Profiler::ThreadSlotCache {
+    static const size_t maxClaims = 8;
+
+    struct Claim {
+        const Profiler* owner;
+        uint64_t instanceId;
+        size_t index;
+    };
+
+    // The profiler used last, checked before the claims.
+    const Profiler* owner;
+    uint64_t instanceId;
+    ThreadSlot* slot;
+    Claim claims[maxClaims];
+    size_t claimCount;
+
+    ~ThreadSlotCache() {
+        std::lock_guard<std::mutex> lock(getLiveProfilersMutex());
+        for (size_t claim = 0; claim < claimCount; claim++) {
+            auto live = getLiveProfilers().find(claims[claim].instanceId);
+            if (live != getLiveProfilers().end()) {
+                live->second->releaseThreadSlot(claims[claim].index);
+            }
+        }
+    }
+};
+
+const size_t Profiler::ThreadSlotCache::maxClaims;
+thread_local Profiler::ThreadSlotCache Profiler::threadSlotCache = {nullptr, 0, nullptr, {}, 0};
+
+Profiler::Profiler() :
+    instanceId(nextInstanceId.fetch_add(1, std::memory_order_relaxed)),
+    threadSlots(new ThreadSlot[maxThreads]), claimedThreadSlots(0),
+    registeredProbes(0), droppedSamples(0) {
+    for (size_t thread = 0; thread < maxThreads; thread++) {
+        for (size_t probe = 0; probe < maxProbes; probe++) {
+            ProbeSlot& slot = threadSlots[thread].probes[probe];
+            slot.lastDuration = Duration(-1);
+            slot.count.store(0, std::memory_order_relaxed);
+            slot.minNanoseconds.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+            slot.maxNanoseconds.store(0, std::memory_order_relaxed);
+            for (size_t bucket = 0; bucket < histogramBuckets; bucket++) {
+                slot.buckets[bucket].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(getLiveProfilersMutex());
+    getLiveProfilers()[instanceId] = this;
+}
+
+Profiler::~Profiler() {
+    std::lock_guard<std::mutex> lock(getLiveProfilersMutex());
+    getLiveProfilers().erase(instanceId);
+}
+// Probe Section
+//###################################################################################################################
+ProbeId Profiler::registerProbe(const std::string& name) {
+    std::lock_guard<std::mutex> lock(registerMutex);
+    uint32_t count = registeredProbes.load(std::memory_order_relaxed);
+    for (uint32_t probe = 0; probe < count; probe++) {
+        if (probeNames[probe] == name) {
+            return probe;
+        }
+    }
+    if (count >= maxProbes) {
+        printf("   ---Profiler::registerProbe::Probe limit reached, '%s' not registered.\n", name.c_str());
+        return invalidProbe;
+    }
+    probeNames[count] = name;
+    registeredProbes.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+std::string Profiler::getProbeName(ProbeId probe) const {
+    if (probe >= registeredProbes.load(std::memory_order_acquire)) {
+        return "";
+    }
+    return probeNames[probe];
+}
+
+Profiler::ThreadSlot* Profiler::getThreadSlot() {
+    ThreadSlotCache& cache = threadSlotCache;
+    if (cache.owner == this && cache.instanceId == instanceId) {
+        return cache.slot;
+    }
+    for (size_t claim = 0; claim < cache.claimCount; claim++) {
+        if (cache.claims[claim].owner == this && cache.claims[claim].instanceId == instanceId) {
+            cache.owner = this;
+            cache.instanceId = instanceId;
+            cache.slot = &threadSlots[cache.claims[claim].index];
+            return cache.slot;
+        }
+    }
+    return claimThreadSlot();
+}
+
+Profiler::ThreadSlot* Profiler::claimThreadSlot() {
+    ThreadSlotCache& cache = threadSlotCache;
+    if (cache.claimCount == ThreadSlotCache::maxClaims) {
+        // Forget claims on profilers that are gone; their slots went with them.
+        std::lock_guard<std::mutex> lock(getLiveProfilersMutex());
+        size_t kept = 0;
+        for (size_t claim = 0; claim < cache.claimCount; claim++) {
+            if (getLiveProfilers().count(cache.claims[claim].instanceId) != 0) {
+                cache.claims[kept++] = cache.claims[claim];
+            }
+        }
+        cache.claimCount = kept;
+        if (kept == ThreadSlotCache::maxClaims) {
+            return nullptr;
+        }
+    }
+    uint32_t claimed = claimedThreadSlots.load(std::memory_order_relaxed);
+    size_t index;
+    do {
+        if (claimed == (1u << maxThreads) - 1) {
+            return nullptr;
+        }
+        index = static_cast<size_t>(__builtin_ctz(~claimed));
+    } while (!claimedThreadSlots.compare_exchange_weak(claimed, claimed | (1u << index),
+        std::memory_order_acq_rel, std::memory_order_relaxed));
+    // The statistics stay in the slot; only the per-thread last duration starts over.
+    for (size_t probe = 0; probe < maxProbes; probe++) {
+        threadSlots[index].probes[probe].lastDuration = Duration(-1);
+    }
+    cache.claims[cache.claimCount++] = ThreadSlotCache::Claim{this, instanceId, index};
+    cache.owner = this;
+    cache.instanceId = instanceId;
+    cache.slot = &threadSlots[index];
+    return cache.slot;
+}
+
+void Profiler::releaseThreadSlot(size_t index) {
+    claimedThreadSlots.fetch_and(~(1u << index), std::memory_order_release);
+}
+// Timer Section
+//###################################################################################################################
+void Profiler::startTimer(ProbeId probe) {
+    ThreadSlot* threadSlot = getThreadSlot();
+    if (threadSlot == nullptr || probe >= maxProbes) {
+        return;
+    }
+    threadSlot->probes[probe].startTime = std::chrono::high_resolution_clock::now();
+}
+
+Duration Profiler::stopTimer(ProbeId probe) {
+    TimePoint stopTime = std::chrono::high_resolution_clock::now();
+    ThreadSlot* threadSlot = getThreadSlot();
+    if (threadSlot == nullptr || probe >= maxProbes) {
+        droppedSamples.fetch_add(1, std::memory_order_relaxed);
+        return Duration(-1);
+    }
+    ProbeSlot& slot = threadSlot->probes[probe];
+    Duration duration = stopTime - slot.startTime;
+    slot.lastDuration = duration;
+
+    // Only the owning thread writes these, so plain load/store pairs are enough;
+    // the atomics exist so snapshot() can read them concurrently.
+    uint64_t nanoseconds = static_cast<uint64_t>(std::max<int64_t>(0,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+    std::atomic<uint32_t>& bucket = slot.buckets[getBucketIndex(nanoseconds)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (nanoseconds < slot.minNanoseconds.load(std::memory_order_relaxed)) {
+        slot.minNanoseconds.store(nanoseconds, std::memory_order_relaxed);
+    }
+    if (nanoseconds > slot.maxNanoseconds.load(std::memory_order_relaxed)) {
+        slot.maxNanoseconds.store(nanoseconds, std::memory_order_relaxed);
+    }
+    slot.count.store(slot.count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return duration;
+}
+
+Duration Profiler::getLastDuration(ProbeId probe) {
+    ThreadSlot* threadSlot = getThreadSlot();
+    if (threadSlot == nullptr || probe >= maxProbes) {
+        return Duration(-1);
+    }
+    return threadSlot->probes[probe].lastDuration;
+}
+// Histogram Section
+//###################################################################################################################
+size_t Profiler::getBucketIndex(uint64_t nanoseconds) {
+    if (nanoseconds < 4) {
+        return static_cast<size_t>(nanoseconds);
+    }
+    size_t highestBit = 63 - __builtin_clzll(nanoseconds);
+    if (highestBit > 41) {
+        return histogramBuckets - 1;
+    }
+    size_t subBucket = (nanoseconds >> (highestBit - 2)) & 3;
+    return 4 * (highestBit - 1) + subBucket;
+}
+
+uint64_t Profiler::getBucketMidpoint(size_t bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+    size_t highestBit = bucket / 4 + 1;
+    uint64_t width = 1ULL << (highestBit - 2);
+    uint64_t lowerBound = (4 + bucket % 4) * width;
+    return lowerBound + width / 2;
+}
+
+std::vector<ProbeSnapshot> Profiler::snapshot() const {
+    std::vector<ProbeSnapshot> snapshots;
+    uint32_t probeCount = registeredProbes.load(std::memory_order_acquire);
+    std::vector<uint64_t> buckets(histogramBuckets);
+    for (uint32_t probe = 0; probe < probeCount; probe++) {
+        ProbeSnapshot probeSnapshot;
+        probeSnapshot.name = probeNames[probe];
+        probeSnapshot.count = 0;
+        uint64_t minNanoseconds = std::numeric_limits<uint64_t>::max();
+        uint64_t maxNanoseconds = 0;
+        std::fill(buckets.begin(), buckets.end(), 0);
+        // Released slots still hold what their threads measured.
+        for (size_t thread = 0; thread < maxThreads; thread++) {
+            const ProbeSlot& slot = threadSlots[thread].probes[probe];
+            if (slot.count.load(std::memory_order_acquire) == 0) {
+                continue;
+            }
+            minNanoseconds = std::min(minNanoseconds, slot.minNanoseconds.load(std::memory_order_relaxed));
+            maxNanoseconds = std::max(maxNanoseconds, slot.maxNanoseconds.load(std::memory_order_relaxed));
+            for (size_t bucket = 0; bucket < histogramBuckets; bucket++) {
+                buckets[bucket] += slot.buckets[bucket].load(std::memory_order_relaxed);
+            }
+        }
+        // Count from the buckets so percentiles are consistent with what was summed.
+        for (uint64_t bucketCount : buckets) {
+            probeSnapshot.count += bucketCount;
+        }
+        if (probeSnapshot.count == 0) {
+            probeSnapshot.min = probeSnapshot.p50 = probeSnapshot.p99 = probeSnapshot.max = Duration(0);
+            snapshots.push_back(probeSnapshot);
+            continue;
+        }
+        uint64_t p50Target = (probeSnapshot.count * 50 + 99) / 100;
+        uint64_t p99Target = (probeSnapshot.count * 99 + 99) / 100;
+        uint64_t p50 = 0;
+        uint64_t p99 = 0;
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < histogramBuckets; bucket++) {
+            uint64_t previous = seen;
+            seen += buckets[bucket];
+            if (previous < p50Target && seen >= p50Target) {
+                p50 = getBucketMidpoint(bucket);
+            }
+            if (previous < p99Target && seen >= p99Target) {
+                p99 = getBucketMidpoint(bucket);
+            }
+        }
+        // Clamp bucket midpoints to the exact extremes.
+        p50 = std::min(std::max(p50, minNanoseconds), maxNanoseconds);
+        p99 = std::min(std::max(p99, minNanoseconds), maxNanoseconds);
+        probeSnapshot.min = std::chrono::nanoseconds(minNanoseconds);
+        probeSnapshot.p50 = std::chrono::nanoseconds(p50);
+        probeSnapshot.p99 = std::chrono::nanoseconds(p99);
+        probeSnapshot.max = std::chrono::nanoseconds(maxNanoseconds);
+        snapshots.push_back(probeSnapshot);
+    }
+    return snapshots;
+}
+
+void Profiler::printReport() const {
+    for (const ProbeSnapshot& probe : snapshot()) {
+        if (probe.count == 0) {
+            continue;
+        }
+        printf("   Profiler::Report::%s: count %llu, min %lld us, p50 %lld us, p99 %lld us, max %lld us.\n",
+            probe.name.c_str(), static_cast<unsigned long long>(probe.count),
+            static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(probe.min).count()),
+            static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(probe.p50).count()),
+            static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(probe.p99).count()),
+            static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(probe.max).count()));
+    }
+    uint64_t dropped = droppedSamples.load(std::memory_order_relaxed);
+    if (dropped > 0) {
+        printf("   Profiler::Report::Dropped %llu samples (no free thread slot).\n",
+            static_cast<unsigned long long>(dropped));
+    }
+}
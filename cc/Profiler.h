@@ -0,0 +1,89 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using Duration = std::chrono::high_resolution_clock::duration;
+using TimePoint = std::chrono::high_resolution_clock::time_point;
+typedef uint32_t ProbeId;
+
+struct ProbeSnapshot {
+    std::string name;
+    uint64_t count;
+    Duration min;
+    Duration p50;
+    Duration p99;
+    Duration max;
+};
+
+// Zero-contention section timer. Probes are registered once up front and
+// referred to by integer id afterwards. Each thread claims its own slot on
+// first use, so timing a section only touches memory owned by the calling
+// thread: no locks, no string compares, no allocation. Every slot keeps a
+// log-scale latency histogram per probe that can be snapshotted from any
+// thread while the timed threads keep running. A slot goes back to the
+// profiler when its thread exits, so short-lived threads do not use them up.
+class Profiler {
+    public:
+        static const size_t maxProbes = 32;
+        static const size_t maxThreads = 16;
+        static const ProbeId invalidProbe;
+
+        Profiler();
+        ~Profiler();
+
+        ProbeId registerProbe(const std::string& name);
+        std::string getProbeName(ProbeId probe) const;
+        void startTimer(ProbeId probe);
+        Duration stopTimer(ProbeId probe);
+        // Last duration measured for this probe by the calling thread.
+        Duration getLastDuration(ProbeId probe);
+
+        std::vector<ProbeSnapshot> snapshot() const;
+        void printReport() const;
+
+    private:
+        // Four sub-buckets per power of two from 1 ns up to 2^41 ns (~37 min).
+        static const size_t histogramBuckets = 164;
+
+        struct ProbeSlot {
+            TimePoint startTime;
+            Duration lastDuration;
+            std::atomic<uint64_t> count;
+            std::atomic<uint64_t> minNanoseconds;
+            std::atomic<uint64_t> maxNanoseconds;
+            std::atomic<uint32_t> buckets[histogramBuckets];
+        };
+
+        struct ThreadSlot {
+            ProbeSlot probes[maxProbes];
+        };
+
+        // The calling thread's claims, released by its destructor at thread exit.
+        struct ThreadSlotCache;
+
+        ThreadSlot* getThreadSlot();
+        ThreadSlot* claimThreadSlot();
+        void releaseThreadSlot(size_t index);
+        static size_t getBucketIndex(uint64_t nanoseconds);
+        static uint64_t getBucketMidpoint(size_t bucket);
+
+        static thread_local ThreadSlotCache threadSlotCache;
+
+        // Never reused, so a new profiler at a freed one's address is told apart.
+        uint64_t instanceId;
+        std::unique_ptr<ThreadSlot[]> threadSlots;
+        std::atomic<uint32_t> claimedThreadSlots; // bit per slot
+        std::atomic<uint32_t> registeredProbes;
+        std::atomic<uint64_t> droppedSamples;
+        std::string probeNames[maxProbes];
+        std::mutex registerMutex;
+};
+
+#endif // PROFILER_H
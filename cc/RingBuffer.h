@@ -0,0 +1,162 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Bounded single-producer/single-consumer queue. Storage is allocated once in
+// the constructor; push and pop never block, never allocate and fail instead
+// of waiting when the buffer is full or empty.
+template <typename T>
+class SPSCRingBuffer {
+    public:
+        explicit SPSCRingBuffer(size_t requestedCapacity)
+            : buffer(roundUpToPowerOfTwo(requestedCapacity)), mask(buffer.size() - 1),
+            head(0), tail(0) {}
+
+        SPSCRingBuffer(const SPSCRingBuffer&) = delete;
+        SPSCRingBuffer& operator=(const SPSCRingBuffer&) = delete;
+
+        // Producer side.
+        bool push(const T& item) {
+            size_t currentTail = tail.load(std::memory_order_relaxed);
+            if (currentTail - head.load(std::memory_order_acquire) > mask) {
+                return false;
+            }
+            buffer[currentTail & mask] = item;
+            tail.store(currentTail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool push(T&& item) {
+            size_t currentTail = tail.load(std::memory_order_relaxed);
+            if (currentTail - head.load(std::memory_order_acquire) > mask) {
+                return false;
+            }
+            buffer[currentTail & mask] = std::move(item);
+            tail.store(currentTail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side.
+        bool pop(T& item) {
+            size_t currentHead = head.load(std::memory_order_relaxed);
+            if (currentHead == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = std::move(buffer[currentHead & mask]);
+            head.store(currentHead + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool empty() const {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const {
+            return buffer.size();
+        }
+
+    private:
+        static size_t roundUpToPowerOfTwo(size_t value) {
+            size_t capacity = 2;
+            while (capacity < value) {
+                capacity <<= 1;
+            }
+            return capacity;
+        }
+
+        std::vector<T> buffer;
+        size_t mask;
+        // Keep the consumer and producer indices on separate cache lines.
+        char headPadding[64];
+        std::atomic<size_t> head;
+        char tailPadding[64];
+        std::atomic<size_t> tail;
+};
+
+// Bounded multi-producer/single-consumer queue (Vyukov's sequence-numbered
+// ring). Producers claim a cell with one CAS on the enqueue index and publish
+// it through the cell's sequence number, so a producer that stalls mid-push
+// never blocks the consumer from draining the cells before it. Storage is
+// allocated once; push and pop never block and fail when full or empty.
+template <typename T>
+class MPSCRingBuffer {
+    public:
+        explicit MPSCRingBuffer(size_t requestedCapacity)
+            : capacityValue(roundUpToPowerOfTwo(requestedCapacity)), mask(capacityValue - 1),
+            cells(new Cell[capacityValue]), enqueuePosition(0), dequeuePosition(0) {
+            for (size_t index = 0; index < capacityValue; index++) {
+                cells[index].sequence.store(index, std::memory_order_relaxed);
+            }
+        }
+
+        MPSCRingBuffer(const MPSCRingBuffer&) = delete;
+        MPSCRingBuffer& operator=(const MPSCRingBuffer&) = delete;
+
+        // Producer side; safe from any number of threads.
+        bool push(T&& item) {
+            size_t position = enqueuePosition.load(std::memory_order_relaxed);
+            while (true) {
+                Cell& cell = cells[position & mask];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+                if (difference == 0) {
+                    if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        cell.item = std::move(item);
+                        cell.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (difference < 0) {
+                    return false;
+                } else {
+                    position = enqueuePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Consumer side; one thread only.
+        bool pop(T& item) {
+            Cell& cell = cells[dequeuePosition & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(dequeuePosition + 1) < 0) {
+                return false;
+            }
+            item = std::move(cell.item);
+            cell.sequence.store(dequeuePosition + capacityValue, std::memory_order_release);
+            dequeuePosition++;
+            return true;
+        }
+
+        size_t capacity() const {
+            return capacityValue;
+        }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T item;
+        };
+
+        static size_t roundUpToPowerOfTwo(size_t value) {
+            size_t capacity = 2;
+            while (capacity < value) {
+                capacity <<= 1;
+            }
+            return capacity;
+        }
+
+        size_t capacityValue;
+        size_t mask;
+        std::unique_ptr<Cell[]> cells;
+        char enqueuePadding[64];
+        std::atomic<size_t> enqueuePosition;
+        char dequeuePadding[64];
+        size_t dequeuePosition;
+};
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,547 @@
+#include "SampleBankManager.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+
+const int SampleBankManager::maxTriggerBank;
+
+namespace {
+const uint32_t noTriggerNote = std::numeric_limits<uint32_t>::max();
+const size_t triggerSlotCount = (SampleBankManager::maxTriggerBank + 1) * static_cast<size_t>(SDL_NUM_SCANCODES);
+
+double toMegabytes(size_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+double secondsSince(TimePoint start) {
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+}
+
+SampleBankManager::SampleBankManager(AudioProcessor& audioProcessor, const YAML::Node& audioMixerConfig,
+    bool verbose, bool playerVerbose) :
+    audioProcessor(audioProcessor), voiceEngine(nullptr), sampleCache(nullptr), sampleIndex(nullptr), offlineMixer(nullptr),
+    verbose(verbose), playerVerbose(playerVerbose),
+    lazyLoading(audioMixerConfig["bank_loading"].as<std::string>("eager") == "lazy"),
+    skipLeadingSilence(audioMixerConfig["skip_leading_silence"].as<bool>(false)),
+    prefetchBanks(std::max(0, audioMixerConfig["bank_prefetch"].as<int>(1))),
+    memoryBudget(static_cast<size_t>(std::max(0.0, audioMixerConfig["sample_memory_mb"].as<double>(0.0)) * 1024.0 * 1024.0)),
+    loaderThreads(audioMixerConfig["loader_threads"].as<int>(0)),
+    triggerTable(new TriggerSlot[triggerSlotCount]), tableReaders(0), activeBank(0), currentBankNumber(0), selectCounter(0), residentBytes(0), peakResidentBytes(0),
+    bulkLoadTotal(0), bulkLoadFinished(0) {
+    std::string loading = audioMixerConfig["bank_loading"].as<std::string>("eager");
+    if (loading != "eager" && loading != "lazy") {
+        printf("   ---SampleBankManager::Unknown bank_loading '%s', loading every bank at start up.\n", loading.c_str());
+    }
+    for (size_t slot = 0; slot < triggerSlotCount; slot++) {
+        triggerTable[slot].player.store(nullptr, std::memory_order_relaxed);
+        triggerTable[slot].note = noTriggerNote;
+    }
+    if (lazyLoading) {
+        printf("   SampleBankManager::Lazy bank loading, prefetching %d bank(s) either side, budget %s.\n",
+            prefetchBanks, memoryBudget > 0 ? (std::to_string(memoryBudget >> 20) + " MB").c_str() : "unlimited");
+    }
+}
+
+SampleBankManager::~SampleBankManager() {
+    clear();
+    loader.reset();
+}
+// Setup Section
+//###################################################################################################################
+void SampleBankManager::setSampleSources(VoiceEngine* engine, SampleCache* cache, SampleIndex* index) {
+    std::lock_guard<std::mutex> lock(bankMutex);
+    voiceEngine = engine;
+    sampleCache = cache;
+    sampleIndex = index;
+}
+
+void SampleBankManager::setOfflineMixer(OfflineMixer* mixer) {
+    if (loader) {
+        // Players still loading would miss the mixer.
+        loader->waitIdle();
+    }
+    std::lock_guard<std::mutex> lock(bankMutex);
+    offlineMixer = mixer;
+    for (Bank& bank : banks) {
+        for (BankNote& note : bank.notes) {
+            if (note.player) {
+                note.player->setOfflineMixer(mixer);
+            }
+        }
+    }
+}
+
+void SampleBankManager::addNotes(const std::vector<NoteSample>& notes, const std::vector<VoiceOptions>& options) {
+    std::lock_guard<std::mutex> lock(bankMutex);
+    for (size_t index = 0; index < notes.size(); index++) {
+        Bank& bank = getOrAddBank(notes[index].config.functionAssignment);
+        BankNote note = {notes[index], options[index], nullptr, false, -1.0, bank.notes.size()};
+        for (size_t noteIndex = 0; noteIndex < bank.notes.size(); noteIndex++) {
+            if (bank.notes[noteIndex].sample.filepath == note.sample.filepath) {
+                note.rootNote = noteIndex;
+                break;
+            }
+        }
+        // The first note of a key answers for it, as the old linear search did.
+        TriggerSlot* slot = getTriggerSlot(bank.number, note.sample.config.keycode);
+        if (slot != nullptr && slot->note == noTriggerNote) {
+            slot->note = static_cast<uint32_t>(bankIndices[bank.name] << 16 | bank.notes.size());
+        } else if (slot == nullptr && bank.number == 0 && verbose) {
+            printf("   ---SampleBankManager::addNotes::%s is in bank %s, which no function key selects.\n",
+                note.sample.config.noteName.c_str(), bank.name.c_str());
+        }
+        bank.notes.push_back(note);
+    }
+}
+
+int SampleBankManager::getBankNumber(const std::string& bankName) {
+    if (bankName.size() < 3 || (bankName[0] != 'f' && bankName[0] != 'F') || (bankName[1] != 'n' && bankName[1] != 'N')) {
+        return 0;
+    }
+    return std::atoi(bankName.c_str() + 2);
+}
+
+SampleBankManager::Bank& SampleBankManager::getOrAddBank(const std::string& bankName) {
+    auto found = bankIndices.find(bankName);
+    if (found != bankIndices.end()) {
+        return banks[found->second];
+    }
+    Bank bank;
+    bank.name = bankName;
+    bank.number = getBankNumber(bankName);
+    bank.state = BankState::Unloaded;
+    bank.pendingLoads = 0;
+    bank.bytes = 0;
+    bank.lastSelected = 0;
+    bank.lastLoadSeconds = 0.0;
+    bank.loadCount = 0;
+    bank.evictionCount = 0;
+    bankIndices.emplace(bankName, banks.size());
+    banks.push_back(bank);
+    return banks.back();
+}
+
+void SampleBankManager::ensureLoader() {
+    if (loader) {
+        return;
+    }
+    size_t noteCount = 0;
+    for (const Bank& bank : banks) {
+        noteCount += bank.notes.size();
+    }
+    size_t threadCount = loaderThreads > 0 ? static_cast<size_t>(loaderThreads) :
+        std::max(1u, std::thread::hardware_concurrency());
+    // Sized so a full load never falls back to running on the selecting thread.
+    loader.reset(new ThreadPool(threadCount, nullptr, std::max<size_t>(64, noteCount)));
+}
+// Loading Section
+//###################################################################################################################
+bool SampleBankManager::isLazy() const {
+    return lazyLoading;
+}
+
+size_t SampleBankManager::loadAllBanks() {
+    std::vector<size_t> loadQueue;
+    size_t threadCount;
+    {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        if (lazyLoading) {
+            printf("   SampleBankManager::loadAllBanks::%zu banks registered, each loads when first selected.\n",
+                banks.size());
+            return 0;
+        }
+        ensureLoader();
+        threadCount = loader->getThreadCount();
+        for (size_t bankIndex = 0; bankIndex < banks.size(); bankIndex++) {
+            queueBankLoad(bankIndex, loadQueue);
+        }
+        bulkLoadTotal = loadQueue.size();
+        bulkLoadFinished = 0;
+    }
+    printf("   SampleBankManager::loadAllBanks::Loading %zu samples on %zu threads.\n", loadQueue.size(), threadCount);
+    TimePoint loadStart = std::chrono::high_resolution_clock::now();
+    runLoads(loadQueue, true);
+    double totalSeconds = secondsSince(loadStart);
+    if (sampleIndex != nullptr) {
+        sampleIndex->save();
+    }
+
+    std::lock_guard<std::mutex> lock(bankMutex);
+    bulkLoadTotal = 0;
+    size_t loaded = 0;
+    double fileSeconds = 0.0;
+    size_t noteCount = 0;
+    std::vector<const BankNote*> slowest;
+    for (const Bank& bank : banks) {
+        noteCount += bank.notes.size();
+        for (const BankNote& note : bank.notes) {
+            if (note.player) {
+                loaded++;
+                fileSeconds += note.loadSeconds;
+                if (note.loadSeconds > 0.0) {
+                    // Notes sharing another's sample took no file time of their own.
+                    slowest.push_back(&note);
+                }
+            }
+        }
+    }
+    printf("   SampleBankManager::loadAllBanks::Loaded %zu of %zu notes from %zu samples (%.1f MB) in %.2f s (%.2f s of file time, %.1fx).\n",
+        loaded, noteCount, loadQueue.size(), toMegabytes(residentBytes), totalSeconds, fileSeconds,
+        totalSeconds > 0.0 ? fileSeconds / totalSeconds : 0.0);
+    size_t slowestCount = std::min<size_t>(5, slowest.size());
+    std::partial_sort(slowest.begin(), slowest.begin() + slowestCount, slowest.end(),
+        [](const BankNote* a, const BankNote* b) {
+            return a->loadSeconds > b->loadSeconds;
+        });
+    for (size_t rank = 0; rank < slowestCount; rank++) {
+        printf("      SampleBankManager::loadAllBanks::Slowest: %s %.1f ms.\n",
+            slowest[rank]->sample.filepath.c_str(), slowest[rank]->loadSeconds * 1000.0);
+    }
+    return loaded;
+}
+
+void SampleBankManager::selectBank(const std::string& bankName) {
+    std::vector<size_t> loadQueue;
+    std::vector<std::shared_ptr<AudioPlayer>> released;
+    bool wait = false;
+    {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        currentBankName = bankName;
+        currentBankNumber = getBankNumber(bankName);
+        activeBank.store(currentBankNumber, std::memory_order_release);
+        selectCounter++;
+        auto found = bankIndices.find(bankName);
+        if (found != bankIndices.end()) {
+            banks[found->second].lastSelected = selectCounter;
+        }
+        if (!lazyLoading) {
+            return;
+        }
+        ensureLoader();
+        // The selected bank is queued first so its samples are decoded before the neighbours'.
+        if (found != bankIndices.end()) {
+            queueBankLoad(found->second, loadQueue);
+        }
+        for (int distance = 1; distance <= prefetchBanks && currentBankNumber > 0; distance++) {
+            for (int number : {currentBankNumber - distance, currentBankNumber + distance}) {
+                char neighbour[16];
+                snprintf(neighbour, sizeof(neighbour), "fn%02d", number);
+                auto prefetch = bankIndices.find(neighbour);
+                if (prefetch != bankIndices.end()) {
+                    queueBankLoad(prefetch->second, loadQueue);
+                }
+            }
+        }
+        // Banks that just left the prefetch window can go now.
+        evictOverBudget(released);
+        wait = offlineMixer != nullptr;
+    }
+    if (!released.empty()) {
+        // Freeing a bank can take a while (munmap, large frees); keep it off the caller's thread.
+        std::vector<std::shared_ptr<AudioPlayer>>* garbage = new std::vector<std::shared_ptr<AudioPlayer>>();
+        garbage->swap(released);
+        loader->enqueue([garbage] {
+            delete garbage;
+        });
+    }
+    runLoads(loadQueue, wait);
+}
+
+void SampleBankManager::queueBankLoad(size_t bankIndex, std::vector<size_t>& loadQueue) {
+    Bank& bank = banks[bankIndex];
+    if (bank.state != BankState::Unloaded) {
+        return;
+    }
+    bank.loadStart = std::chrono::high_resolution_clock::now();
+    bank.pendingLoads = 0;
+    // One load per file; it fills every note sharing that file.
+    std::vector<bool> queued(bank.notes.size(), false);
+    for (size_t noteIndex = 0; noteIndex < bank.notes.size(); noteIndex++) {
+        const BankNote& note = bank.notes[noteIndex];
+        if (!note.player && !note.failed && !queued[note.rootNote]) {
+            queued[note.rootNote] = true;
+            loadQueue.push_back(bankIndex << 16 | note.rootNote);
+            bank.pendingLoads++;
+        }
+    }
+    bank.state = bank.pendingLoads > 0 ? BankState::Loading : BankState::Resident;
+}
+
+void SampleBankManager::runLoads(const std::vector<size_t>& loadQueue, bool wait) {
+    if (loadQueue.empty()) {
+        return;
+    }
+    for (size_t load : loadQueue) {
+        loader->enqueue([this, load] {
+            loadNote(load >> 16, load & 0xFFFF);
+        });
+    }
+    if (wait) {
+        loader->waitIdle();
+    }
+}
+
+void SampleBankManager::loadNote(size_t bankIndex, size_t rootNote) {
+    std::string filepath;
+    std::vector<size_t> noteIndices;
+    std::vector<VoiceOptions> options;
+    std::vector<double> semitones;
+    VoiceEngine* engine;
+    SampleCache* cache;
+    SampleIndex* index;
+    {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        const Bank& bank = banks[bankIndex];
+        filepath = bank.notes[rootNote].sample.filepath;
+        for (size_t noteIndex = rootNote; noteIndex < bank.notes.size(); noteIndex++) {
+            const BankNote& note = bank.notes[noteIndex];
+            if (note.rootNote == rootNote && !note.player && !note.failed) {
+                noteIndices.push_back(noteIndex);
+                options.push_back(note.options);
+                semitones.push_back(note.sample.config.semitones);
+            }
+        }
+        engine = voiceEngine;
+        cache = sampleCache;
+        index = sampleIndex;
+    }
+    TimePoint fileStart = std::chrono::high_resolution_clock::now();
+    // The first note owns the sample; the rest play it through their own players.
+    std::vector<std::shared_ptr<AudioPlayer>> players;
+    try {
+        for (size_t member = 0; member < noteIndices.size(); member++) {
+            std::shared_ptr<AudioPlayer> player = member == 0 ?
+                std::make_shared<AudioPlayer>(playerVerbose, filepath.c_str(), audioProcessor, engine, cache, index) :
+                std::make_shared<AudioPlayer>(playerVerbose, players.front());
+            player->setVoiceOptions(options[member]);
+            player->setSkipLeadingSilence(skipLeadingSilence);
+            player->setPitch(semitones[member]);
+            players.push_back(std::move(player));
+        }
+    } catch (const std::exception& e) {
+        printf("      ---SampleBankManager::loadNote::Failed to create AudioPlayer for %s: %s\n",
+            filepath.c_str(), e.what());
+        players.clear();
+    }
+    double fileSeconds = secondsSince(fileStart);
+
+    std::vector<std::shared_ptr<AudioPlayer>> released;
+    bool bankLoaded = false;
+    {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        Bank& bank = banks[bankIndex];
+        for (size_t member = 0; member < noteIndices.size(); member++) {
+            BankNote& note = bank.notes[noteIndices[member]];
+            note.loadSeconds = member == 0 ? fileSeconds : 0.0;
+            if (players.empty()) {
+                note.failed = true;
+                continue;
+            }
+            note.player = players[member];
+            note.player->setOfflineMixer(offlineMixer);
+            TriggerSlot* slot = getNoteSlot(bankIndex, noteIndices[member]);
+            if (slot != nullptr) {
+                slot->player.store(note.player.get(), std::memory_order_release);
+            }
+            size_t bytes = note.player->getSampleBytes();
+            bank.bytes += bytes;
+            residentBytes += bytes;
+        }
+        peakResidentBytes = std::max(peakResidentBytes, residentBytes);
+        if (verbose && !players.empty()) {
+            const BankNote& note = bank.notes[noteIndices.front()];
+            const SampleAnalysis& analysis = note.player->getAnalysis();
+            printf("      SampleBankManager::loadNote::%s %.1f ms: peak %.2f, %.1f LUFS, silence %.1f ms, onset %.1f ms, %.2f s, %zu note(s).\n",
+                note.sample.config.noteName.c_str(), fileSeconds * 1000.0, analysis.peak, analysis.loudnessDb,
+                analysis.leadingSilence * 1000.0, analysis.onset * 1000.0, analysis.soundLength, noteIndices.size());
+        }
+        if (bulkLoadTotal > 0) {
+            bulkLoadFinished++;
+            if (bulkLoadFinished % std::max<size_t>(1, bulkLoadTotal / 10) == 0 || bulkLoadFinished == bulkLoadTotal) {
+                printf("   SampleBankManager::loadAllBanks::%zu/%zu samples.\n", bulkLoadFinished, bulkLoadTotal);
+            }
+        }
+        if (bank.state == BankState::Loading && --bank.pendingLoads == 0) {
+            bank.state = BankState::Resident;
+            bank.lastLoadSeconds = secondsSince(bank.loadStart);
+            bank.loadCount++;
+            if (lazyLoading) {
+                printf("   SampleBankManager::Bank %s loaded: %zu samples, %.1f MB in %.0f ms (%.1f MB resident).\n",
+                    bank.name.c_str(), bank.notes.size(), toMegabytes(bank.bytes), bank.lastLoadSeconds * 1000.0,
+                    toMegabytes(residentBytes));
+                evictOverBudget(released);
+                bankLoaded = true;
+            }
+        }
+    }
+    // Out of the lock, still on this loader thread: released players go and new analysis is saved.
+    if (bankLoaded && index != nullptr) {
+        index->save();
+    }
+}
+
+bool SampleBankManager::isProtected(const Bank& bank) const {
+    if (bank.name == currentBankName) {
+        return true;
+    }
+    return currentBankNumber > 0 && bank.number > 0 && std::abs(bank.number - currentBankNumber) <= prefetchBanks;
+}
+
+void SampleBankManager::evictOverBudget(std::vector<std::shared_ptr<AudioPlayer>>& released) {
+    while (memoryBudget > 0 && residentBytes > memoryBudget) {
+        Bank* victim = nullptr;
+        for (Bank& bank : banks) {
+            if (bank.state == BankState::Resident && bank.bytes > 0 && !isProtected(bank) &&
+                (victim == nullptr || bank.lastSelected < victim->lastSelected)) {
+                victim = &bank;
+            }
+        }
+        if (victim == nullptr) {
+            if (verbose) {
+                printf("   ---SampleBankManager::evictOverBudget::%.1f MB resident is over budget, nothing left to evict.\n",
+                    toMegabytes(residentBytes));
+            }
+            return;
+        }
+        size_t victimIndex = static_cast<size_t>(victim - banks.data());
+        for (size_t noteIndex = 0; noteIndex < victim->notes.size(); noteIndex++) {
+            BankNote& note = victim->notes[noteIndex];
+            if (note.player) {
+                // Loopers still holding a player keep it alive until they stop.
+                unpublishPlayer(victimIndex, noteIndex);
+                released.push_back(std::move(note.player));
+            }
+        }
+        waitForTableReaders();
+        residentBytes -= victim->bytes;
+        printf("   SampleBankManager::Evicted bank %s (%.1f MB, %.1f MB resident).\n", victim->name.c_str(),
+            toMegabytes(victim->bytes), toMegabytes(residentBytes));
+        victim->bytes = 0;
+        victim->state = BankState::Unloaded;
+        victim->evictionCount++;
+    }
+}
+// Player Section
+//###################################################################################################################
+std::shared_ptr<AudioPlayer> SampleBankManager::getPlayer(int bankNumber, SDL_Scancode keycode) {
+    TriggerSlot* slot = getTriggerSlot(bankNumber, keycode);
+    if (slot == nullptr) {
+        return nullptr;
+    }
+    // Counted before the load, so a slot cleared after it waits for this reader to take its reference.
+    tableReaders.fetch_add(1);
+    AudioPlayer* player = slot->player.load();
+    std::shared_ptr<AudioPlayer> shared = player != nullptr ? player->shared_from_this() : nullptr;
+    tableReaders.fetch_sub(1, std::memory_order_release);
+    return shared;
+}
+
+std::shared_ptr<AudioPlayer> SampleBankManager::getActivePlayer(SDL_Scancode keycode) {
+    return getPlayer(activeBank.load(std::memory_order_acquire), keycode);
+}
+
+int SampleBankManager::getActiveBank() const {
+    return activeBank.load(std::memory_order_acquire);
+}
+
+bool SampleBankManager::removeNote(int bankNumber, SDL_Scancode keycode) {
+    TriggerSlot* slot = getTriggerSlot(bankNumber, keycode);
+    if (slot == nullptr) {
+        return false;
+    }
+    std::shared_ptr<AudioPlayer> released;
+    std::lock_guard<std::mutex> lock(bankMutex);
+    if (slot->note == noTriggerNote) {
+        return false;
+    }
+    size_t bankIndex = slot->note >> 16;
+    size_t noteIndex = slot->note & 0xFFFF;
+    Bank& bank = banks[bankIndex];
+    BankNote& note = bank.notes[noteIndex];
+    if (note.failed) {
+        return false;
+    }
+    // Kept in place, as in-flight loads address notes by index.
+    if (note.player) {
+        size_t bytes = note.player->getSampleBytes();
+        bank.bytes -= bytes;
+        residentBytes -= bytes;
+        unpublishPlayer(bankIndex, noteIndex);
+        waitForTableReaders();
+        released = std::move(note.player);
+    }
+    note.failed = true;
+    return true;
+}
+
+SampleBankManager::TriggerSlot* SampleBankManager::getTriggerSlot(int bankNumber, SDL_Scancode keycode) const {
+    if (bankNumber < 1 || bankNumber > maxTriggerBank || keycode < 0 || keycode >= SDL_NUM_SCANCODES) {
+        return nullptr;
+    }
+    return &triggerTable[static_cast<size_t>(bankNumber) * SDL_NUM_SCANCODES + keycode];
+}
+
+SampleBankManager::TriggerSlot* SampleBankManager::getNoteSlot(size_t bankIndex, size_t noteIndex) const {
+    const Bank& bank = banks[bankIndex];
+    TriggerSlot* slot = getTriggerSlot(bank.number, bank.notes[noteIndex].sample.config.keycode);
+    if (slot == nullptr || slot->note != static_cast<uint32_t>(bankIndex << 16 | noteIndex)) {
+        return nullptr;
+    }
+    return slot;
+}
+
+void SampleBankManager::unpublishPlayer(size_t bankIndex, size_t noteIndex) {
+    TriggerSlot* slot = getNoteSlot(bankIndex, noteIndex);
+    if (slot != nullptr) {
+        slot->player.store(nullptr);
+    }
+}
+
+void SampleBankManager::waitForTableReaders() const {
+    // Readers hold the count for one load and one reference increment, so this spins for nanoseconds.
+    while (tableReaders.load() != 0) {
+        std::this_thread::yield();
+    }
+}
+
+void SampleBankManager::clear() {
+    if (loader) {
+        loader->waitIdle();
+    }
+    std::vector<std::shared_ptr<AudioPlayer>> released;
+    std::lock_guard<std::mutex> lock(bankMutex);
+    for (size_t bankIndex = 0; bankIndex < banks.size(); bankIndex++) {
+        Bank& bank = banks[bankIndex];
+        for (size_t noteIndex = 0; noteIndex < bank.notes.size(); noteIndex++) {
+            if (bank.notes[noteIndex].player) {
+                unpublishPlayer(bankIndex, noteIndex);
+                released.push_back(std::move(bank.notes[noteIndex].player));
+            }
+        }
+        bank.bytes = 0;
+        bank.pendingLoads = 0;
+        bank.state = BankState::Unloaded;
+    }
+    residentBytes = 0;
+    waitForTableReaders();
+}
+// Report Section
+//###################################################################################################################
+void SampleBankManager::printReport() const {
+    std::lock_guard<std::mutex> lock(bankMutex);
+    printf("   SampleBankManager::Report::%.1f MB resident, peak %.1f MB, budget %s.\n", toMegabytes(residentBytes),
+        toMegabytes(peakResidentBytes), memoryBudget > 0 ? (std::to_string(memoryBudget >> 20) + " MB").c_str() : "unlimited");
+    for (const Bank& bank : banks) {
+        if (bank.loadCount == 0) {
+            continue;
+        }
+        printf("      SampleBankManager::Report::%s %s, %.1f MB, loaded %llu time(s), evicted %llu, last load %.0f ms.\n",
+            bank.name.c_str(), bank.state == BankState::Resident ? "resident" :
+            (bank.state == BankState::Loading ? "loading" : "unloaded"), toMegabytes(bank.bytes),
+            static_cast<unsigned long long>(bank.loadCount), static_cast<unsigned long long>(bank.evictionCount),
+            bank.lastLoadSeconds * 1000.0);
+    }
+}
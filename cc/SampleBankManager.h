@@ -0,0 +1,142 @@
+#ifndef SAMPLE_BANK_MANAGER_H
+#define SAMPLE_BANK_MANAGER_H
+
+#include "AudioPlayer.h"
+#include "AudioProcessor.h"
+#include "OfflineMixer.h"
+#include "SampleCache.h"
+#include "SampleIndex.h"
+#include "Structures.h"
+#include "ThreadPool.h"
+#include "VoiceEngine.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Owns the AudioPlayers of every function bank (fn01..fn12) and decides
+// which banks are in memory. With bank_loading "eager" everything loads at
+// start up, as before. With "lazy" a bank loads in the background the first
+// time it is selected, together with bank_prefetch neighbours on either
+// side, and the least recently selected banks are dropped once the loaded
+// samples exceed sample_memory_mb. Players are shared with the loopers that
+// play them, so dropping a bank never pulls a sample out from under a loop.
+// Notes of a bank that name the same file (the keys of an instrument) load
+// it once; the first note's player owns the sample and the others share it,
+// each at its own pitch.
+//
+// Key presses find their player in a trigger table: one slot per function
+// bank and scancode, filled in as players load and cleared as they go, so a
+// lookup is an index and an atomic load with no lock and no string work.
+// Readers announce themselves in a counter; whoever clears a slot waits for
+// it to drain before the player can be freed.
+class SampleBankManager {
+    public:
+        SampleBankManager(AudioProcessor& audioProcessor, const YAML::Node& audioMixerConfig,
+            bool verbose, bool playerVerbose);
+        ~SampleBankManager();
+
+        // Where players decode to; call before any bank is loaded.
+        void setSampleSources(VoiceEngine* voiceEngine, SampleCache* sampleCache, SampleIndex* sampleIndex);
+        // Players created afterwards render into mixer too. While it is set banks
+        // load synchronously, so an offline render does not depend on load timing.
+        void setOfflineMixer(OfflineMixer* mixer);
+
+        void addNotes(const std::vector<NoteSample>& notes, const std::vector<VoiceOptions>& options);
+        // Eager mode only: loads every bank now and prints the load report. Returns the players loaded.
+        size_t loadAllBanks();
+        bool isLazy() const;
+        // Called when the function key changes.
+        void selectBank(const std::string& bankName);
+        // 1..12 for fn01..fn12, 0 for other names; only numbered banks are in the trigger table.
+        static int getBankNumber(const std::string& bankName);
+        // Lock-free from any thread. nullptr if the note is unknown or its bank is not loaded (yet).
+        std::shared_ptr<AudioPlayer> getPlayer(int bankNumber, SDL_Scancode keycode);
+        // The same in the bank last passed to selectBank.
+        std::shared_ptr<AudioPlayer> getActivePlayer(SDL_Scancode keycode);
+        int getActiveBank() const;
+        bool removeNote(int bankNumber, SDL_Scancode keycode);
+        // Drops every player, e.g. on shutdown.
+        void clear();
+        void printReport() const;
+
+        static const int maxTriggerBank = 12;
+
+    private:
+        enum class BankState { Unloaded, Loading, Resident };
+
+        struct TriggerSlot {
+            std::atomic<AudioPlayer*> player; // owned by the note's shared_ptr
+            uint32_t note;                    // bank index << 16 | note index, or noTriggerNote
+        };
+
+        struct BankNote {
+            NoteSample sample;
+            VoiceOptions options;
+            std::shared_ptr<AudioPlayer> player;
+            bool failed;
+            double loadSeconds;
+            size_t rootNote; // first note of the bank with the same file; loads for all of them
+        };
+
+        struct Bank {
+            std::string name;
+            int number; // 1..12 for fnNN banks, 0 otherwise
+            std::vector<BankNote> notes;
+            BankState state;
+            size_t pendingLoads;
+            size_t bytes;
+            uint64_t lastSelected;
+            TimePoint loadStart;
+            double lastLoadSeconds;
+            uint64_t loadCount;
+            uint64_t evictionCount;
+        };
+
+        Bank& getOrAddBank(const std::string& bankName);
+        bool isProtected(const Bank& bank) const;
+        void queueBankLoad(size_t bankIndex, std::vector<size_t>& loadQueue);
+        void runLoads(const std::vector<size_t>& loadQueue, bool wait);
+        void loadNote(size_t bankIndex, size_t rootNote);
+        void evictOverBudget(std::vector<std::shared_ptr<AudioPlayer>>& released);
+        void ensureLoader();
+        TriggerSlot* getTriggerSlot(int bankNumber, SDL_Scancode keycode) const;
+        // The slot this note answers for, nullptr if another note of the key came first.
+        TriggerSlot* getNoteSlot(size_t bankIndex, size_t noteIndex) const;
+        // Clears the note's slot; call waitForTableReaders() before its player may be freed.
+        void unpublishPlayer(size_t bankIndex, size_t noteIndex);
+        void waitForTableReaders() const;
+
+        AudioProcessor& audioProcessor;
+        VoiceEngine* voiceEngine;
+        SampleCache* sampleCache;
+        SampleIndex* sampleIndex;
+        OfflineMixer* offlineMixer;
+        bool verbose;
+        bool playerVerbose;
+        bool lazyLoading;
+        bool skipLeadingSilence;
+        int prefetchBanks;
+        size_t memoryBudget; // bytes, 0 = unlimited
+        int loaderThreads;
+
+        std::vector<Bank> banks;
+        std::unordered_map<std::string, size_t> bankIndices;
+        std::unique_ptr<TriggerSlot[]> triggerTable; // [maxTriggerBank + 1][SDL_NUM_SCANCODES]
+        mutable std::atomic<uint32_t> tableReaders;
+        std::atomic<int> activeBank;
+        int currentBankNumber;
+        std::string currentBankName;
+        uint64_t selectCounter;
+        size_t residentBytes;
+        size_t peakResidentBytes;
+        size_t bulkLoadTotal; // progress of loadAllBanks, 0 outside of it
+        size_t bulkLoadFinished;
+        mutable std::mutex bankMutex;
+        std::unique_ptr<ThreadPool> loader;
+};
+
+#endif // SAMPLE_BANK_MANAGER_H
@@ -0,0 +1,254 @@
+#include "SampleCache.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const char cacheMagic[8] = {'M', 'E', 'L', 'Y', 'D', 'Y', 'S', 'C'};
+// Bump whenever the layout or the preprocessing changes. Version 2 stores the
+// frames as decoded; normalization is a gain from the SampleIndex. Version 3
+// resamples with Melydy's own converter and records its setting.
+const uint32_t cacheVersion = 3;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t channels;
+    uint32_t frequency;
+    uint32_t pathLength; // source path follows the header
+    uint32_t conversion;
+    uint64_t frameCount;
+    int64_t sourceModified;
+    uint64_t sourceSize;
+    uint64_t dataOffset; // page aligned
+};
+}
+// Cached Sample Section
+//###################################################################################################################
+CachedSample::CachedSample() : mapping(nullptr), mappingLength(0), frames(nullptr), frameCount(0) {}
+
+CachedSample::CachedSample(CachedSample&& other) noexcept :
+    mapping(other.mapping), mappingLength(other.mappingLength), frames(other.frames), frameCount(other.frameCount) {
+    other.mapping = nullptr;
+    other.frames = nullptr;
+    other.frameCount = 0;
+}
+
+CachedSample& CachedSample::operator=(CachedSample&& other) noexcept {
+    if (this != &other) {
+        reset();
+        mapping = other.mapping;
+        mappingLength = other.mappingLength;
+        frames = other.frames;
+        frameCount = other.frameCount;
+        other.mapping = nullptr;
+        other.frames = nullptr;
+        other.frameCount = 0;
+    }
+    return *this;
+}
+
+CachedSample::~CachedSample() {
+    reset();
+}
+
+void CachedSample::reset() {
+#ifndef _WIN32
+    if (mapping != nullptr) {
+        munmap(mapping, mappingLength);
+    }
+#endif
+    mapping = nullptr;
+    mappingLength = 0;
+    frames = nullptr;
+    frameCount = 0;
+}
+
+const float* CachedSample::getFrames() const {
+    return frames;
+}
+
+uint32_t CachedSample::getFrameCount() const {
+    return frameCount;
+}
+
+bool CachedSample::isMapped() const {
+    return mapping != nullptr;
+}
+// Cache Section
+//###################################################################################################################
+SampleCache::SampleCache(const std::string& directory, bool verbose) :
+    directory(directory), verbose(verbose), enabled(false), pageSize(4096), conversion(0),
+    hitCount(0), missCount(0), storeCount(0), nextTemporaryId(0) {
+    if (directory.empty()) {
+        return;
+    }
+#ifndef _WIN32
+    pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        printf("   ---SampleCache::SampleCache::Cannot create %s: %s\n", directory.c_str(), strerror(errno));
+        return;
+    }
+    enabled = true;
+    printf("   SampleCache::SampleCache::Using %s.\n", directory.c_str());
+#else
+    printf("   ---SampleCache::SampleCache::The sample cache needs mmap and is disabled on Windows.\n");
+#endif
+}
+
+bool SampleCache::isEnabled() const {
+    return enabled;
+}
+
+uint64_t SampleCache::hashPath(const std::string& filepath) {
+    // FNV-1a; only has to spread file names, entries keep the full path.
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char character : filepath) {
+        hash = (hash ^ character) * 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string SampleCache::getEntryPath(const std::string& filepath, int frequency, int channels) const {
+    char name[64];
+    snprintf(name, sizeof(name), "/%016llx_%d_%d.pcm", static_cast<unsigned long long>(hashPath(filepath)),
+        frequency, channels);
+    return directory + name;
+}
+
+bool SampleCache::getSourceInfo(const std::string& filepath, SourceInfo& info) {
+#ifndef _WIN32
+    struct stat status;
+    if (stat(filepath.c_str(), &status) != 0) {
+        return false;
+    }
+    info.modified = static_cast<int64_t>(status.st_mtime);
+    info.size = static_cast<uint64_t>(status.st_size);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SampleCache::setConversion(uint32_t newConversion) {
+    conversion = newConversion;
+}
+
+bool SampleCache::load(const std::string& filepath, int frequency, int channels, CachedSample& sample) {
+    if (!enabled) {
+        return false;
+    }
+#ifndef _WIN32
+    SourceInfo source;
+    if (!getSourceInfo(filepath, source)) {
+        missCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::string entryPath = getEntryPath(filepath, frequency, channels);
+    int file = open(entryPath.c_str(), O_RDONLY);
+    if (file < 0) {
+        missCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    struct stat status;
+    void* mapping = MAP_FAILED;
+    size_t length = 0;
+    if (fstat(file, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(CacheHeader)) {
+        length = static_cast<size_t>(status.st_size);
+        mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    // The mapping stays valid after the descriptor is closed.
+    ::close(file);
+    if (mapping == MAP_FAILED) {
+        missCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    CacheHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    const char* storedPath = static_cast<const char*>(mapping) + sizeof(header);
+    bool valid = std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+        header.version == cacheVersion && header.conversion == conversion &&
+        header.channels == static_cast<uint32_t>(channels) && header.frequency == static_cast<uint32_t>(frequency) &&
+        header.sourceModified == source.modified && header.sourceSize == source.size &&
+        header.pathLength == filepath.size() && sizeof(header) + header.pathLength <= header.dataOffset &&
+        header.dataOffset % pageSize == 0 && header.frameCount <= UINT32_MAX &&
+        header.dataOffset + header.frameCount * channels * sizeof(float) == length &&
+        std::memcmp(storedPath, filepath.data(), filepath.size()) == 0;
+    if (!valid) {
+        munmap(mapping, length);
+        missCount.fetch_add(1, std::memory_order_relaxed);
+        if (verbose) {
+            printf("      SampleCache::load::Stale entry for %s.\n", filepath.c_str());
+        }
+        return false;
+    }
+    sample.reset();
+    sample.mapping = mapping;
+    sample.mappingLength = length;
+    sample.frames = reinterpret_cast<const float*>(static_cast<const char*>(mapping) + header.dataOffset);
+    sample.frameCount = static_cast<uint32_t>(header.frameCount);
+    hitCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool SampleCache::store(const std::string& filepath, int frequency, int channels, const std::vector<float>& frames) {
+    SourceInfo source;
+    if (!enabled || channels <= 0 || !getSourceInfo(filepath, source)) {
+        return false;
+    }
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.channels = static_cast<uint32_t>(channels);
+    header.frequency = static_cast<uint32_t>(frequency);
+    header.pathLength = static_cast<uint32_t>(filepath.size());
+    header.conversion = conversion;
+    header.frameCount = frames.size() / channels;
+    header.sourceModified = source.modified;
+    header.sourceSize = source.size;
+    header.dataOffset = (sizeof(header) + filepath.size() + pageSize - 1) / pageSize * pageSize;
+
+    // Write beside the entry and rename, so a reader never maps a half written file.
+    std::string entryPath = getEntryPath(filepath, frequency, channels);
+    std::string temporaryPath = entryPath + ".tmp" +
+        std::to_string(nextTemporaryId.fetch_add(1, std::memory_order_relaxed));
+    std::FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr) {
+        printf("      ---SampleCache::store::Cannot write %s.\n", temporaryPath.c_str());
+        return false;
+    }
+    std::vector<char> padding(header.dataOffset - sizeof(header) - filepath.size(), 0);
+    size_t dataBytes = header.frameCount * channels * sizeof(float);
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+        std::fwrite(filepath.data(), 1, filepath.size(), file) == filepath.size() &&
+        std::fwrite(padding.data(), 1, padding.size(), file) == padding.size() &&
+        std::fwrite(frames.data(), 1, dataBytes, file) == dataBytes;
+    written = std::fclose(file) == 0 && written;
+    if (!written || std::rename(temporaryPath.c_str(), entryPath.c_str()) != 0) {
+        printf("      ---SampleCache::store::Failed to write the entry for %s.\n", filepath.c_str());
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    storeCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void SampleCache::printReport() const {
+    if (!enabled) {
+        return;
+    }
+    printf("   SampleCache::Report::%llu hits, %llu misses, %llu entries written.\n",
+        static_cast<unsigned long long>(hitCount.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(missCount.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(storeCount.load(std::memory_order_relaxed)));
+}
@@ -0,0 +1,78 @@
+#ifndef SAMPLE_CACHE_H
+#define SAMPLE_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only view of a cached sample, backed by a memory mapping of its cache
+// file. Pages are only read in when a voice first plays them, so banks that
+// are never used take no resident memory. Move-only; unmaps on destruction.
+class CachedSample {
+    public:
+        CachedSample();
+        CachedSample(CachedSample&& other) noexcept;
+        CachedSample& operator=(CachedSample&& other) noexcept;
+        CachedSample(const CachedSample&) = delete;
+        CachedSample& operator=(const CachedSample&) = delete;
+        ~CachedSample();
+
+        const float* getFrames() const;
+        uint32_t getFrameCount() const;
+        bool isMapped() const;
+
+    private:
+        friend class SampleCache;
+        void reset();
+
+        void* mapping;
+        size_t mappingLength;
+        const float* frames;
+        uint32_t frameCount;
+};
+
+// Directory of converted samples so a warm start maps files
+// instead of decoding them. One file per source path and output spec:
+// a header naming the source (path, size, modification time) followed by the
+// interleaved float frames on a page boundary. An entry whose source changed
+// is a miss and is rewritten by the next store(). An empty directory
+// disables the cache. Safe to use from several loader threads.
+class SampleCache {
+    public:
+        SampleCache(const std::string& directory, bool verbose = false);
+
+        bool isEnabled() const;
+        // Identifies how frames were converted (the resampler quality); entries
+        // written another way are misses. Call before the first load.
+        void setConversion(uint32_t conversion);
+        // True with sample mapped if an up to date entry exists.
+        bool load(const std::string& filepath, int frequency, int channels, CachedSample& sample);
+        // Writes frames (already converted to the output spec) for the next start.
+        bool store(const std::string& filepath, int frequency, int channels, const std::vector<float>& frames);
+        void printReport() const;
+
+        // What an entry is validated against; a changed size or time means a stale entry.
+        struct SourceInfo {
+            int64_t modified;
+            uint64_t size;
+        };
+        static bool getSourceInfo(const std::string& filepath, SourceInfo& info);
+        static uint64_t hashPath(const std::string& filepath);
+
+    private:
+        std::string getEntryPath(const std::string& filepath, int frequency, int channels) const;
+
+        std::string directory;
+        bool verbose;
+        bool enabled;
+        size_t pageSize;
+        uint32_t conversion;
+        std::atomic<uint64_t> hitCount;
+        std::atomic<uint64_t> missCount;
+        std::atomic<uint64_t> storeCount;
+        std::atomic<uint32_t> nextTemporaryId;
+};
+
+#endif // SAMPLE_CACHE_H
@@ -0,0 +1,163 @@
+#include "SampleIndex.h"
+#include <cstdio>
+#include <fstream>
+#include <yaml-cpp/yaml.h>
+
+namespace {
+// Bump whenever an analysis field changes meaning; older indexes are then ignored.
+const int indexVersion = 1;
+}
+
+SampleIndex::SampleIndex(const std::string& directory, bool verbose) :
+    verbose(verbose), enabled(false), dirty(false), hitCount(0), missCount(0) {
+    if (directory.empty()) {
+        return;
+    }
+#ifndef _WIN32
+    // The SampleCache has already created the directory.
+    indexPath = directory + "/analysis.yml";
+    enabled = true;
+    loadIndex();
+#endif
+}
+
+SampleIndex::~SampleIndex() {
+    save();
+}
+
+bool SampleIndex::isEnabled() const {
+    return enabled;
+}
+
+std::string SampleIndex::getKey(const std::string& filepath) {
+    char key[32];
+    snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(SampleCache::hashPath(filepath)));
+    return key;
+}
+// Index File Section
+//###################################################################################################################
+void SampleIndex::loadIndex() {
+    YAML::Node index;
+    try {
+        index = YAML::LoadFile(indexPath);
+    } catch (const YAML::Exception&) {
+        // No index yet; it is written after the first load.
+        return;
+    }
+    try {
+        if (index["version"].as<int>(0) != indexVersion) {
+            printf("   SampleIndex::loadIndex::%s is from another version, analysing again.\n", indexPath.c_str());
+            return;
+        }
+        for (const auto& item : index["samples"]) {
+            const YAML::Node& node = item.second;
+            Entry entry;
+            entry.filepath = node["path"].as<std::string>();
+            entry.source.size = node["size"].as<uint64_t>();
+            entry.source.modified = node["modified"].as<int64_t>();
+            entry.analysis.peak = node["peak"].as<float>();
+            entry.analysis.rmsDb = node["rms_db"].as<double>();
+            entry.analysis.loudnessDb = node["loudness_db"].as<double>();
+            entry.analysis.leadingSilence = node["leading_silence"].as<double>();
+            entry.analysis.onset = node["onset"].as<double>();
+            entry.analysis.soundLength = node["sound_length"].as<double>();
+            entry.analysis.duration = node["duration"].as<double>();
+            entries[item.first.as<std::string>()] = entry;
+        }
+    } catch (const YAML::Exception& e) {
+        printf("   ---SampleIndex::loadIndex::Ignoring %s: %s\n", indexPath.c_str(), e.what());
+        entries.clear();
+        return;
+    }
+    printf("   SampleIndex::loadIndex::%zu analysed samples in %s.\n", entries.size(), indexPath.c_str());
+}
+
+bool SampleIndex::save() {
+    YAML::Emitter emitter;
+    {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        if (!enabled || !dirty) {
+            return false;
+        }
+        emitter.SetDoublePrecision(9);
+        emitter.SetFloatPrecision(9);
+        emitter << YAML::BeginMap << YAML::Key << "version" << YAML::Value << indexVersion;
+        emitter << YAML::Key << "samples" << YAML::Value << YAML::BeginMap;
+        for (const auto& item : entries) {
+            const Entry& entry = item.second;
+            emitter << YAML::Key << item.first << YAML::Value << YAML::BeginMap;
+            emitter << YAML::Key << "path" << YAML::Value << entry.filepath;
+            emitter << YAML::Key << "size" << YAML::Value << entry.source.size;
+            emitter << YAML::Key << "modified" << YAML::Value << entry.source.modified;
+            emitter << YAML::Key << "peak" << YAML::Value << entry.analysis.peak;
+            emitter << YAML::Key << "rms_db" << YAML::Value << entry.analysis.rmsDb;
+            emitter << YAML::Key << "loudness_db" << YAML::Value << entry.analysis.loudnessDb;
+            emitter << YAML::Key << "leading_silence" << YAML::Value << entry.analysis.leadingSilence;
+            emitter << YAML::Key << "onset" << YAML::Value << entry.analysis.onset;
+            emitter << YAML::Key << "sound_length" << YAML::Value << entry.analysis.soundLength;
+            emitter << YAML::Key << "duration" << YAML::Value << entry.analysis.duration;
+            emitter << YAML::EndMap;
+        }
+        emitter << YAML::EndMap << YAML::EndMap;
+        dirty = false;
+    }
+    // Written beside the index and renamed, as the sample cache does.
+    std::string temporaryPath = indexPath + ".tmp";
+    {
+        std::ofstream file(temporaryPath);
+        file << emitter.c_str() << "\n";
+        if (!file) {
+            printf("   ---SampleIndex::save::Cannot write %s.\n", temporaryPath.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporaryPath.c_str(), indexPath.c_str()) != 0) {
+        printf("   ---SampleIndex::save::Cannot replace %s.\n", indexPath.c_str());
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    if (verbose) {
+        printf("   SampleIndex::save::Wrote %s.\n", indexPath.c_str());
+    }
+    return true;
+}
+// Lookup Section
+//###################################################################################################################
+bool SampleIndex::find(const std::string& filepath, SampleAnalysis& analysis) {
+    SampleCache::SourceInfo source;
+    if (!enabled || !SampleCache::getSourceInfo(filepath, source)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(indexMutex);
+    auto found = entries.find(getKey(filepath));
+    if (found == entries.end() || found->second.filepath != filepath ||
+        found->second.source.size != source.size || found->second.source.modified != source.modified) {
+        missCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    analysis = found->second.analysis;
+    hitCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void SampleIndex::store(const std::string& filepath, const SampleAnalysis& analysis) {
+    Entry entry;
+    if (!enabled || !SampleCache::getSourceInfo(filepath, entry.source)) {
+        return;
+    }
+    entry.filepath = filepath;
+    entry.analysis = analysis;
+    std::lock_guard<std::mutex> lock(indexMutex);
+    entries[getKey(filepath)] = entry;
+    dirty = true;
+}
+
+void SampleIndex::printReport() const {
+    if (!enabled) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(indexMutex);
+    printf("   SampleIndex::Report::%llu hits, %llu analysed, %zu entries.\n",
+        static_cast<unsigned long long>(hitCount.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(missCount.load(std::memory_order_relaxed)), entries.size());
+}
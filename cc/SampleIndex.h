@@ -0,0 +1,49 @@
+#ifndef SAMPLE_INDEX_H
+#define SAMPLE_INDEX_H
+
+#include "AudioProcessor.h"
+#include "SampleCache.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Sidecar index of the load-time SampleAnalysis, one YAML file (analysis.yml)
+// in the sample cache directory. Entries are keyed by the hash of the source
+// path and hold its size and modification time; a changed file is analysed
+// again. Lookups are safe from several loader threads, and save() only
+// writes when something was added.
+class SampleIndex {
+    public:
+        SampleIndex(const std::string& directory, bool verbose = false);
+        ~SampleIndex();
+
+        bool isEnabled() const;
+        // True with analysis filled if an up to date entry exists.
+        bool find(const std::string& filepath, SampleAnalysis& analysis);
+        void store(const std::string& filepath, const SampleAnalysis& analysis);
+        bool save();
+        void printReport() const;
+
+    private:
+        struct Entry {
+            std::string filepath;
+            SampleCache::SourceInfo source;
+            SampleAnalysis analysis;
+        };
+
+        static std::string getKey(const std::string& filepath);
+        void loadIndex();
+
+        std::string indexPath;
+        bool verbose;
+        bool enabled;
+        bool dirty;
+        std::unordered_map<std::string, Entry> entries;
+        mutable std::mutex indexMutex;
+        std::atomic<uint64_t> hitCount;
+        std::atomic<uint64_t> missCount;
+};
+
+#endif // SAMPLE_INDEX_H
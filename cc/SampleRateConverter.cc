@@ -0,0 +1,211 @@
+#include "SampleRateConverter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+struct QualitySpec {
+    size_t taps;    // per phase when not downsampling
+    double rolloff; // cutoff as a fraction of the lower Nyquist
+    double beta;    // Kaiser window shape; larger trades transition width for stopband
+};
+
+const QualitySpec qualitySpecs[] = {
+    {8, 0.85, 5.0},
+    {16, 0.91, 7.0},
+    {32, 0.95, 9.0},
+};
+
+// Rates sample packs are usually recorded at; their tables are built up front.
+const int commonRates[] = {22050, 32000, 44100, 48000, 88200, 96000, 192000};
+// Rates reducing to more phases than this (e.g. 44099 Hz) share the nearest of maxPhases.
+const uint32_t maxPhases = 1024;
+const double pi = 3.14159265358979323846;
+
+uint32_t getGcd(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        uint32_t remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
+
+// Modified Bessel function of the first kind, order 0, for the Kaiser window.
+double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+        double factor = x / (2.0 * k);
+        term *= factor * factor;
+        sum += term;
+    }
+    return sum;
+}
+}
+
+SampleRateConverter::SampleRateConverter(bool verbose) :
+    verbose(verbose), kernels(MixKernels::get()), outputRate(0), quality(ResamplerQuality::Medium),
+    convertedCount(0), convertedFrames(0), convertNanoseconds(0) {}
+// Setup Section
+//###################################################################################################################
+void SampleRateConverter::prepare(int newOutputRate, ResamplerQuality newQuality) {
+    {
+        std::lock_guard<std::mutex> lock(tableMutex);
+        outputRate = newOutputRate;
+        quality = newQuality;
+        tables.clear();
+    }
+    size_t tableBytes = 0;
+    for (int inputRate : commonRates) {
+        if (inputRate != newOutputRate) {
+            tableBytes += getTable(inputRate)->coefficients.size() * sizeof(float);
+        }
+    }
+    if (verbose) {
+        printf("   SampleRateConverter::prepare::%s quality into %d Hz, %.1f KB of filter tables.\n",
+            getQualityName(newQuality), newOutputRate, tableBytes / 1024.0);
+    }
+}
+
+ResamplerQuality SampleRateConverter::parseQuality(const std::string& qualityName) {
+    if (qualityName == "fast") {
+        return ResamplerQuality::Fast;
+    } else if (qualityName == "best") {
+        return ResamplerQuality::Best;
+    } else if (qualityName != "medium") {
+        printf("   ---SampleRateConverter::parseQuality::Unknown resampler_quality '%s', using medium.\n",
+            qualityName.c_str());
+    }
+    return ResamplerQuality::Medium;
+}
+
+const char* SampleRateConverter::getQualityName(ResamplerQuality quality) {
+    switch (quality) {
+        case ResamplerQuality::Fast:
+            return "fast";
+        case ResamplerQuality::Best:
+            return "best";
+        default:
+            return "medium";
+    }
+}
+
+ResamplerQuality SampleRateConverter::getQuality() const {
+    std::lock_guard<std::mutex> lock(tableMutex);
+    return quality;
+}
+// Filter Section
+//###################################################################################################################
+std::shared_ptr<const SampleRateConverter::FilterTable> SampleRateConverter::getTable(int inputRate) {
+    {
+        std::lock_guard<std::mutex> lock(tableMutex);
+        auto found = tables.find(inputRate);
+        if (found != tables.end()) {
+            return found->second;
+        }
+    }
+    // Built outside the lock; two threads meeting a new rate at once both build it and one copy is kept.
+    std::shared_ptr<const FilterTable> table = buildTable(inputRate);
+    std::lock_guard<std::mutex> lock(tableMutex);
+    return tables.emplace(inputRate, table).first->second;
+}
+
+std::shared_ptr<const SampleRateConverter::FilterTable> SampleRateConverter::buildTable(int inputRate) const {
+    const QualitySpec& spec = qualitySpecs[static_cast<int>(quality)];
+    std::shared_ptr<FilterTable> table = std::make_shared<FilterTable>();
+    uint32_t gcd = getGcd(static_cast<uint32_t>(outputRate), static_cast<uint32_t>(inputRate));
+    table->upFactor = static_cast<uint32_t>(outputRate) / gcd;
+    table->downFactor = static_cast<uint32_t>(inputRate) / gcd;
+    table->phaseCount = std::min(table->upFactor, maxPhases);
+    // Downsampling lowers the cutoff, so the filter spans more input samples for the same shape.
+    double scale = std::min(1.0, static_cast<double>(outputRate) / inputRate);
+    table->taps = (static_cast<size_t>(std::ceil(spec.taps / scale)) + 7) / 8 * 8;
+    double cutoff = spec.rolloff * scale;
+    double halfWidth = table->taps / 2.0;
+    double windowScale = 1.0 / besselI0(spec.beta);
+    table->coefficients.resize(table->phaseCount * table->taps);
+    for (uint32_t phase = 0; phase < table->phaseCount; phase++) {
+        // Tap k reads input frame index - (taps / 2 - 1) + k for an output at index + fraction.
+        double fraction = static_cast<double>(phase) / table->phaseCount;
+        float* row = table->coefficients.data() + phase * table->taps;
+        double sum = 0.0;
+        std::vector<double> values(table->taps);
+        for (size_t tap = 0; tap < table->taps; tap++) {
+            double distance = fraction + halfWidth - 1.0 - static_cast<double>(tap);
+            double x = cutoff * distance;
+            double sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+            double position = distance / halfWidth;
+            double window = position * position < 1.0 ?
+                besselI0(spec.beta * std::sqrt(1.0 - position * position)) * windowScale : 0.0;
+            values[tap] = cutoff * sinc * window;
+            sum += values[tap];
+        }
+        // Every phase passes DC at unity, so a constant stays constant whatever the fraction.
+        for (size_t tap = 0; tap < table->taps; tap++) {
+            row[tap] = static_cast<float>(values[tap] / sum);
+        }
+    }
+    return table;
+}
+// Conversion Section
+//###################################################################################################################
+bool SampleRateConverter::convert(const float* input, size_t frameCount, int channels, int inputRate,
+    std::vector<float>& output) {
+    if (outputRate <= 0 || inputRate <= 0 || channels <= 0) {
+        printf("      ---SampleRateConverter::convert::Cannot convert %d Hz to %d Hz.\n", inputRate, outputRate);
+        return false;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::shared_ptr<const FilterTable> table = getTable(inputRate);
+    uint64_t up = table->upFactor;
+    uint64_t down = table->downFactor;
+    size_t taps = table->taps;
+    size_t outputFrames = static_cast<size_t>((static_cast<uint64_t>(frameCount) * up + down - 1) / down);
+    output.assign(outputFrames * channels, 0.0f);
+
+    // One channel at a time, padded with silence so every phase reads a full row of taps.
+    size_t padding = taps / 2;
+    std::vector<float> planar(frameCount + 2 * padding, 0.0f);
+    for (int channel = 0; channel < channels; channel++) {
+        for (size_t frame = 0; frame < frameCount; frame++) {
+            planar[padding + frame] = input[frame * channels + channel];
+        }
+        size_t index = 0;
+        uint64_t remainder = 0;
+        for (size_t frame = 0; frame < outputFrames; frame++) {
+            uint32_t phase = static_cast<uint32_t>(table->phaseCount == up ? remainder :
+                remainder * table->phaseCount / up);
+            // The row starts taps / 2 - 1 frames before index, i.e. at planar[index + 1].
+            output[frame * channels + channel] =
+                kernels.dotFloat(table->coefficients.data() + phase * taps, planar.data() + index + 1, taps);
+            remainder += down;
+            index += static_cast<size_t>(remainder / up);
+            remainder %= up;
+        }
+    }
+    uint64_t nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    convertedCount.fetch_add(1, std::memory_order_relaxed);
+    convertedFrames.fetch_add(outputFrames, std::memory_order_relaxed);
+    convertNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    if (verbose) {
+        printf("      SampleRateConverter::convert::%zu frames at %d Hz to %zu at %d Hz in %.2f ms.\n",
+            frameCount, inputRate, outputFrames, outputRate, nanoseconds / 1e6);
+    }
+    return true;
+}
+// Report Section
+//###################################################################################################################
+void SampleRateConverter::printReport() const {
+    uint64_t count = convertedCount.load(std::memory_order_relaxed);
+    if (count == 0 || outputRate <= 0) {
+        return;
+    }
+    double audioSeconds = static_cast<double>(convertedFrames.load(std::memory_order_relaxed)) / outputRate;
+    double convertSeconds = convertNanoseconds.load(std::memory_order_relaxed) / 1e9;
+    printf("   SampleRateConverter::Report::%llu samples resampled (%s), %.1f s of audio in %.0f ms of thread time, %.0fx real time.\n",
+        static_cast<unsigned long long>(count), getQualityName(getQuality()), audioSeconds, convertSeconds * 1000.0,
+        convertSeconds > 0.0 ? audioSeconds / convertSeconds : 0.0);
+}
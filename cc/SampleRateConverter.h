@@ -0,0 +1,65 @@
+#ifndef SAMPLE_RATE_CONVERTER_H
+#define SAMPLE_RATE_CONVERTER_H
+
+#include "MixKernels.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class ResamplerQuality {
+    Fast,   // 8 taps per phase, passband to 85% of Nyquist
+    Medium, // 16 taps, 91%
+    Best    // 32 taps, 95%
+};
+
+// Converts samples recorded at another rate (44.1, 96 kHz packs) to the
+// output rate at load time, so the voice engine only ever plays frames in
+// its own rate. A polyphase windowed-sinc filter: with the rates reduced to
+// up / down, the table holds up phases of a Kaiser-windowed sinc, and each
+// output sample is one dot product (a MixKernels kernel) of a phase with the
+// input around it. Downsampling widens the filter so the cutoff follows the
+// lower Nyquist. Tables are built once per input rate, the usual ones in
+// prepare(), and shared read-only by the loader threads.
+class SampleRateConverter {
+    public:
+        explicit SampleRateConverter(bool verbose = false);
+
+        // Drops the tables of an earlier output rate and builds the common ones for this one.
+        void prepare(int outputRate, ResamplerQuality quality);
+        static ResamplerQuality parseQuality(const std::string& qualityName);
+        static const char* getQualityName(ResamplerQuality quality);
+        ResamplerQuality getQuality() const;
+
+        // Interleaved float frames at inputRate to the prepared output rate. Safe from several threads.
+        bool convert(const float* input, size_t frameCount, int channels, int inputRate, std::vector<float>& output);
+        void printReport() const;
+
+    private:
+        struct FilterTable {
+            uint32_t upFactor;   // output rate / gcd
+            uint32_t downFactor; // input rate / gcd
+            uint32_t phaseCount; // upFactor, or fewer for odd rates
+            size_t taps;         // per phase, a multiple of 8
+            std::vector<float> coefficients; // phaseCount rows of taps
+        };
+
+        std::shared_ptr<const FilterTable> getTable(int inputRate);
+        std::shared_ptr<const FilterTable> buildTable(int inputRate) const;
+
+        bool verbose;
+        const MixKernelTable& kernels;
+        int outputRate;
+        ResamplerQuality quality;
+        std::map<int, std::shared_ptr<const FilterTable>> tables;
+        mutable std::mutex tableMutex;
+        std::atomic<uint64_t> convertedCount;
+        std::atomic<uint64_t> convertedFrames;      // output frames
+        std::atomic<uint64_t> convertNanoseconds;
+};
+
+#endif // SAMPLE_RATE_CONVERTER_H
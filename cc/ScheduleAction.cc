@@ -1,13 +1,20 @@
 #include "ScheduleAction.h"
 #include <cstdio>
+#include <exception>
+#include <utility>
+
+// Empty action; fills the unused entries of a batch's inline action array
+ScheduleAction::ScheduleAction()
+    : verbose(false), hasTimeCorrection(false), timeCorrection(0), priority(ActionPriority::Normal) {}
 
 // Constructor for functions that don't need time correction
-ScheduleAction::ScheduleAction(std::function<void()> function, bool verbose)
-    : verbose(verbose), func(function), hasTimeCorrection(false), timeCorrection(0) {}
+ScheduleAction::ScheduleAction(ActionFunction function, bool verbose, ActionPriority priority)
+    : func(std::move(function)), verbose(verbose), hasTimeCorrection(false), timeCorrection(0), priority(priority) {}
 
 // Constructor for functions that need time correction
-ScheduleAction::ScheduleAction(std::function<void(Duration)> function, bool verbose, Duration timeCorrection)
-    : verbose(verbose), funcWithTimeCorrection(function), hasTimeCorrection(true), timeCorrection(timeCorrection) {
+ScheduleAction::ScheduleAction(CorrectedActionFunction function, bool verbose, Duration timeCorrection)
+    : funcWithTimeCorrection(std::move(function)), verbose(verbose), hasTimeCorrection(true), timeCorrection(timeCorrection),
+    priority(ActionPriority::Normal) {
 }
 
 void ScheduleAction::setTimeCorrection(Duration timeCorrectionValue) {
@@ -19,6 +26,10 @@ void ScheduleAction::setTimeCorrectionFlagFalse() {
     hasTimeCorrection = false;
 }
 
+ActionPriority ScheduleAction::getPriority() const {
+    return priority;
+}
+
 void ScheduleAction::execute() const {
     if (hasTimeCorrection && funcWithTimeCorrection) {
         try {
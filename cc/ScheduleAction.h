@@ -1,27 +1,49 @@
 #ifndef SCHEDULE_ACTION_H
 #define SCHEDULE_ACTION_H
 
-#include <functional>
 #include <string>
 #include <chrono> // Include the necessary header for Duration
+#include "InlineFunction.h"
 
 using Duration = std::chrono::high_resolution_clock::duration;
 
+// Actions in a batch run highest priority first, and a batch is handed to the
+// worker pool ahead of queued work when its highest priority action is High.
+enum class ActionPriority {
+    Low,
+    Normal,
+    High
+};
+
+// Scheduled callables live inline in the action, so creating, moving and
+// running actions never allocates.
+typedef InlineFunction<void()> ActionFunction;
+typedef InlineFunction<void(Duration)> CorrectedActionFunction;
+
 class ScheduleAction {
 public:
-    explicit ScheduleAction(std::function<void()> function, bool verbose = false);
-    explicit ScheduleAction(std::function<void(Duration)> funcWithDuration,
+    ScheduleAction();
+    explicit ScheduleAction(ActionFunction function, bool verbose = false,
+                            ActionPriority priority = ActionPriority::Normal);
+    explicit ScheduleAction(CorrectedActionFunction funcWithDuration,
                             bool verbose = false, Duration timeCorrection = Duration(0));
+    ScheduleAction(ScheduleAction&& other) = default;
+    ScheduleAction& operator=(ScheduleAction&& other) = default;
+    ScheduleAction(const ScheduleAction&) = delete;
+    ScheduleAction& operator=(const ScheduleAction&) = delete;
+
     void execute() const;
     void setTimeCorrection(Duration timeCorrectionValue);
     void setTimeCorrectionFlagFalse();
+    ActionPriority getPriority() const;
 
 private:
-    std::function<void()> func;
-    std::function<void(Duration)> funcWithTimeCorrection;
+    ActionFunction func;
+    CorrectedActionFunction funcWithTimeCorrection;
     bool verbose;
     bool hasTimeCorrection;
     Duration timeCorrection;
+    ActionPriority priority;
 };
 
 #endif // SCHEDULE_ACTION_H
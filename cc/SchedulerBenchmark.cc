@@ -0,0 +1,264 @@
+// SchedulerBenchmark.cc
+// Drives MasterClock with synthetic looping batches and add/remove churn, then
+// reports scheduler time per tick, wakeup jitter and add/remove throughput.
+// Needs no window or audio device; build.sh links it as scheduler_benchmark.
+#include "MasterClock.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct BenchmarkOptions {
+    std::vector<size_t> batchCounts;
+    double seconds;
+    double bpm;
+    double beatDivisions;
+    int workerThreads;
+    int churnThreads;
+    int workMicroseconds;
+    std::string waitMode;
+};
+
+struct BenchmarkResult {
+    size_t batchCount;
+    uint64_t ticks;
+    uint64_t interruptedWakeups;
+    double processingPerTickMicroseconds;
+    ProbeSnapshot tickProcessing;
+    Duration wakeupP50;
+    Duration wakeupP90;
+    Duration wakeupP99;
+    Duration wakeupP999;
+    Duration wakeupMax;
+    uint64_t actionsRun;
+    double fillAddsPerSecond;
+    uint64_t churnOperations;
+    double churnOperationsPerSecond;
+    uint64_t overruns;
+    uint64_t lateStarts;
+};
+
+// Loop lengths in grid divisions; mixed so batches fall due on different ticks.
+const int intervalDivisions[] = {1, 2, 3, 4, 6, 8, 12, 16};
+const size_t intervalCount = sizeof(intervalDivisions) / sizeof(intervalDivisions[0]);
+// Distinct tags the churn threads cycle through.
+const size_t churnTagCount = 64;
+
+void printUsage(const char* program) {
+    printf("Usage: %s [--batches 1,10,100,1000,10000] [--seconds 5] [--bpm 120] [--divisions 8]\n", program);
+    printf("          [--workers 2] [--churn-threads 1] [--work-us 0] [--wait-mode sleep|hybrid|spin]\n");
+}
+
+std::vector<size_t> parseBatchCounts(const std::string& list) {
+    std::vector<size_t> counts;
+    size_t position = 0;
+    while (position < list.size()) {
+        size_t comma = list.find(',', position);
+        if (comma == std::string::npos) {
+            comma = list.size();
+        }
+        long count = std::atol(list.substr(position, comma - position).c_str());
+        if (count > 0) {
+            counts.push_back(static_cast<size_t>(count));
+        }
+        position = comma + 1;
+    }
+    return counts;
+}
+
+bool argumentHandler(int argc, char* argv[], BenchmarkOptions& options) {
+    options.batchCounts = {1, 10, 100, 1000, 10000};
+    options.seconds = 5.0;
+    options.bpm = 120.0;
+    options.beatDivisions = 8.0;
+    options.workerThreads = 2;
+    options.churnThreads = 1;
+    options.workMicroseconds = 0;
+    options.waitMode = "hybrid";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            printf("Error: %s needs a value.\n", arg.c_str());
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--batches") {
+            options.batchCounts = parseBatchCounts(value);
+        } else if (arg == "--seconds") {
+            options.seconds = std::max(0.1, std::atof(value.c_str()));
+        } else if (arg == "--bpm") {
+            options.bpm = std::max(1.0, std::atof(value.c_str()));
+        } else if (arg == "--divisions") {
+            options.beatDivisions = std::max(1.0, std::atof(value.c_str()));
+        } else if (arg == "--workers") {
+            options.workerThreads = std::max(0, std::atoi(value.c_str()));
+        } else if (arg == "--churn-threads") {
+            options.churnThreads = std::max(0, std::atoi(value.c_str()));
+        } else if (arg == "--work-us") {
+            options.workMicroseconds = std::max(0, std::atoi(value.c_str()));
+        } else if (arg == "--wait-mode") {
+            options.waitMode = value;
+        } else {
+            printf("Error: unknown option %s.\n", arg.c_str());
+            return false;
+        }
+    }
+    return !options.batchCounts.empty();
+}
+
+// Stand-in for a playback action: bump a counter and optionally burn some CPU.
+void syntheticWork(std::atomic<uint64_t>& actionsRun, int workMicroseconds) {
+    if (workMicroseconds > 0) {
+        TimePoint until = std::chrono::high_resolution_clock::now() + std::chrono::microseconds(workMicroseconds);
+        while (std::chrono::high_resolution_clock::now() < until) {}
+    }
+    actionsRun.fetch_add(1, std::memory_order_relaxed);
+}
+
+BenchmarkResult runScenario(const BenchmarkOptions& options, size_t batchCount) {
+    BenchmarkResult result;
+    result.batchCount = batchCount;
+
+    MasterClock masterClock(options.bpm, options.beatDivisions);
+    YAML::Node clockConfig;
+    clockConfig["wait_mode"] = options.waitMode;
+    clockConfig["worker_threads"] = options.workerThreads;
+    clockConfig["calibration_samples"] = 20;
+    masterClock.setClockConfig(clockConfig);
+    masterClock.start();
+    Duration division = masterClock.fetchDivisionDurationAsDuration();
+
+    // The clock has to be running before the fill: adds wait on its command
+    // queue once more than a queue's worth is outstanding.
+    std::thread clockThread([&]() {
+        masterClock.executeScheduledBatches();
+    });
+
+    std::atomic<uint64_t> actionsRun(0);
+    int workMicroseconds = options.workMicroseconds;
+    TimePoint fillStart = std::chrono::high_resolution_clock::now();
+    for (size_t index = 0; index < batchCount; index++) {
+        masterClock.addItemToBatchAtInterval([&actionsRun, workMicroseconds]() {
+            syntheticWork(actionsRun, workMicroseconds);
+        }, division * intervalDivisions[index % intervalCount], "bench" + std::to_string(index), true);
+    }
+    double fillSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - fillStart).count();
+    result.fillAddsPerSecond = fillSeconds > 0.0 ? batchCount / fillSeconds : 0.0;
+
+    // Churn: each thread keeps adding and removing its own set of tags.
+    std::atomic<bool> churning(true);
+    std::atomic<uint64_t> churnOperations(0);
+    std::vector<std::thread> churnThreads;
+    TimePoint churnStart = std::chrono::high_resolution_clock::now();
+    for (int thread = 0; thread < options.churnThreads; thread++) {
+        churnThreads.emplace_back([&, thread]() {
+            std::vector<std::string> tags;
+            for (size_t tag = 0; tag < churnTagCount; tag++) {
+                tags.push_back("churn" + std::to_string(thread) + "_" + std::to_string(tag));
+            }
+            size_t next = 0;
+            while (churning.load(std::memory_order_relaxed)) {
+                const std::string& tag = tags[next % churnTagCount];
+                if (masterClock.containsBatchActions(tag)) {
+                    masterClock.removeBatchFromQueue(tag);
+                } else {
+                    masterClock.addItemToBatchAtInterval([&actionsRun, workMicroseconds]() {
+                        syntheticWork(actionsRun, workMicroseconds);
+                    }, division * intervalDivisions[next % intervalCount], tag, true);
+                }
+                churnOperations.fetch_add(1, std::memory_order_relaxed);
+                next++;
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+    churning.store(false, std::memory_order_relaxed);
+    for (std::thread& thread : churnThreads) {
+        thread.join();
+    }
+    double churnSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - churnStart).count();
+    masterClock.stop();
+    clockThread.join();
+
+    // Every pass through the clock loop, whether a deadline or a post woke it; the
+    // wakeup percentiles below only cover the deadline wakeups.
+    result.ticks = masterClock.getTickCount();
+    result.interruptedWakeups = masterClock.getInterruptedWakeupCount();
+    // Only the tick processing itself: calibration and the wait policy's sleeping or
+    // spinning are left out, so this moves with scheduler cost alone.
+    result.processingPerTickMicroseconds = result.ticks > 0 ?
+        std::chrono::duration<double, std::micro>(masterClock.getTotalProcessingTime()).count() / result.ticks : 0.0;
+    result.tickProcessing = ProbeSnapshot();
+    for (const ProbeSnapshot& probe : masterClock.getProfileSnapshot()) {
+        if (probe.name == "ScheduleThreadProcess") {
+            result.tickProcessing = probe;
+        }
+    }
+    result.wakeupP50 = masterClock.getWakeupErrorPercentile(50.0);
+    result.wakeupP90 = masterClock.getWakeupErrorPercentile(90.0);
+    result.wakeupP99 = masterClock.getWakeupErrorPercentile(99.0);
+    result.wakeupP999 = masterClock.getWakeupErrorPercentile(99.9);
+    result.wakeupMax = masterClock.getMaxWakeupError();
+    result.actionsRun = actionsRun.load(std::memory_order_relaxed);
+    result.churnOperations = churnOperations.load(std::memory_order_relaxed);
+    result.churnOperationsPerSecond = churnSeconds > 0.0 ? result.churnOperations / churnSeconds : 0.0;
+    result.overruns = masterClock.getOverrunCount();
+    result.lateStarts = masterClock.getLateStartCount();
+    return result;
+}
+
+long long toMicroseconds(Duration duration) {
+    return static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+
+void printResults(const std::vector<BenchmarkResult>& results) {
+    printf("\n%8s %8s %8s %10s %10s %10s | %8s %8s %8s %8s %8s | %10s %12s %12s %8s %8s\n",
+        "batches", "ticks", "woken", "tick mean", "tick p50", "tick p99",
+        "wake p50", "p90", "p99", "p99.9", "max",
+        "actions", "fill add/s", "churn op/s", "overrun", "late");
+    printf("%8s %8s %8s %10s %10s %10s | %8s %8s %8s %8s %8s | %10s %12s %12s %8s %8s\n",
+        "", "", "early", "(us)", "(us)", "(us)", "(us)", "(us)", "(us)", "(us)", "(us)", "", "", "", "", "");
+    for (const BenchmarkResult& result : results) {
+        printf("%8zu %8llu %8llu %10.2f %10.2f %10.2f | %8lld %8lld %8lld %8lld %8lld | %10llu %12.0f %12.0f %8llu %8llu\n",
+            result.batchCount, static_cast<unsigned long long>(result.ticks),
+            static_cast<unsigned long long>(result.interruptedWakeups), result.processingPerTickMicroseconds,
+            std::chrono::duration<double, std::micro>(result.tickProcessing.p50).count(),
+            std::chrono::duration<double, std::micro>(result.tickProcessing.p99).count(),
+            toMicroseconds(result.wakeupP50), toMicroseconds(result.wakeupP90),
+            toMicroseconds(result.wakeupP99), toMicroseconds(result.wakeupP999),
+            toMicroseconds(result.wakeupMax),
+            static_cast<unsigned long long>(result.actionsRun), result.fillAddsPerSecond,
+            result.churnOperationsPerSecond,
+            static_cast<unsigned long long>(result.overruns), static_cast<unsigned long long>(result.lateStarts));
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    if (!argumentHandler(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    printf("SchedulerBenchmark::%.1f s per scenario, %g bpm, %g divisions, %d workers, %d churn threads, "
+        "%d us work, %s wait.\n", options.seconds, options.bpm, options.beatDivisions, options.workerThreads,
+        options.churnThreads, options.workMicroseconds, options.waitMode.c_str());
+
+    std::vector<BenchmarkResult> results;
+    for (size_t batchCount : options.batchCounts) {
+        printf("SchedulerBenchmark::Running %zu batches.\n", batchCount);
+        results.push_back(runScenario(options, batchCount));
+    }
+    printResults(results);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "SessionRecorder.h"
+#include <algorithm>
+#include <cstring>
+
+SessionRecorder::SessionRecorder(bool verbose) :
+    verbose(verbose), sessionFile(nullptr), eventCount(0) {}
+
+SessionRecorder::~SessionRecorder() {
+    stop();
+}
+
+bool SessionRecorder::start(const std::string& filepath, double bpm, double beatDivisions) {
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    sessionFile = std::fopen(filepath.c_str(), "w");
+    if (sessionFile == nullptr) {
+        printf("   ---SessionRecorder::start::Could not open %s.\n", filepath.c_str());
+        return false;
+    }
+    std::fprintf(sessionFile, "# melydy session 1 bpm %f divisions %f\n", bpm, beatDivisions);
+    eventCount = 0;
+    if (verbose) {
+        printf("   SessionRecorder::start::Recording to %s.\n", filepath.c_str());
+    }
+    return true;
+}
+
+void SessionRecorder::stop() {
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    if (sessionFile != nullptr) {
+        std::fclose(sessionFile);
+        sessionFile = nullptr;
+        printf("   SessionRecorder::stop::Recorded %llu key events.\n", static_cast<unsigned long long>(eventCount));
+    }
+}
+
+bool SessionRecorder::isRecording() const {
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    return sessionFile != nullptr;
+}
+
+void SessionRecorder::recordKeyEvent(int64_t time, SDL_Scancode scancode, bool down) {
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    if (sessionFile == nullptr) {
+        return;
+    }
+    std::fprintf(sessionFile, "%lld %s %d\n", static_cast<long long>(time), down ? "down" : "up",
+        static_cast<int>(scancode));
+    eventCount++;
+}
+
+bool SessionRecorder::loadSession(const std::string& filepath, std::vector<SessionEvent>& events,
+    double& bpm, double& beatDivisions) {
+    std::FILE* file = std::fopen(filepath.c_str(), "r");
+    if (file == nullptr) {
+        printf("   ---SessionRecorder::loadSession::Could not open %s.\n", filepath.c_str());
+        return false;
+    }
+    char line[256];
+    int version = 0;
+    events.clear();
+    while (std::fgets(line, sizeof(line), file) != nullptr) {
+        if (line[0] == '#') {
+            std::sscanf(line, "# melydy session %d bpm %lf divisions %lf", &version, &bpm, &beatDivisions);
+            continue;
+        }
+        long long time;
+        char direction[8];
+        int scancode;
+        if (std::sscanf(line, "%lld %7s %d", &time, direction, &scancode) != 3) {
+            continue;
+        }
+        if (scancode < 0 || scancode >= SDL_NUM_SCANCODES) {
+            continue;
+        }
+        SessionEvent event;
+        event.time = time;
+        event.scancode = static_cast<SDL_Scancode>(scancode);
+        event.down = std::strcmp(direction, "down") == 0;
+        events.push_back(event);
+    }
+    std::fclose(file);
+    if (version != 1) {
+        printf("   ---SessionRecorder::loadSession::%s is not a session file.\n", filepath.c_str());
+        return false;
+    }
+    std::stable_sort(events.begin(), events.end(), [](const SessionEvent& lhs, const SessionEvent& rhs) {
+        return lhs.time < rhs.time;
+    });
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef SESSION_RECORDER_H
+#define SESSION_RECORDER_H
+
+#ifdef _WIN32
+#include <SDL.h> // Include path for Windows
+#else
+#include <SDL2/SDL.h> // Include path for Linux
+#endif
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One key transition, timed from the MasterClock start.
+struct SessionEvent {
+    int64_t time; // nanoseconds since clock start
+    SDL_Scancode scancode;
+    bool down;
+};
+
+// Records a performance as the key transitions that drove it. Loop starts and
+// stops are not stored: they follow from the keys, so replaying the keys
+// against the same config reproduces them.
+//
+// Text format, one event per line after the header:
+//   # melydy session 1 bpm <bpm> divisions <divisions>
+//   <nanoseconds> <down|up> <scancode>
+class SessionRecorder {
+    public:
+        explicit SessionRecorder(bool verbose = false);
+        ~SessionRecorder();
+
+        bool start(const std::string& filepath, double bpm, double beatDivisions);
+        void stop();
+        bool isRecording() const;
+        void recordKeyEvent(int64_t time, SDL_Scancode scancode, bool down);
+
+        static bool loadSession(const std::string& filepath, std::vector<SessionEvent>& events,
+            double& bpm, double& beatDivisions);
+
+    private:
+        bool verbose;
+        std::FILE* sessionFile;
+        uint64_t eventCount;
+        mutable std::mutex recorderMutex;
+};
+
+#endif // SESSION_RECORDER_H
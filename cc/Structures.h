@@ -10,6 +10,7 @@
 #include <SDL2/SDL_mixer.h>
 #endif
 // #include "ThreadPool.h"
+#include <array>
 #include <condition_variable>
 #include <mutex>
 #include <thread>
@@ -24,8 +25,20 @@ struct NoteConfiguration {
     std::string noteName;
     SDL_Scancode keycode;
     std::string functionAssignment;
+    int polyphony = 0;      // 0 = the audioMixer note_polyphony default
+    std::string chokeGroup; // empty = not choked
+    double semitones = 0.0; // pitch shift from the recorded sample, voice engine only
 };
 
+// One entry of the notes map, as handed to AudioManager::addAudioPlayers.
+struct NoteSample {
+    std::string filepath;
+    NoteConfiguration config;
+};
+
+// Loop length of the loopers held by KP1..KP9, from kp1LoopDuration..kp9LoopDuration.
+typedef std::array<double, 9> KeypadLoopDurations;
+
 struct ManagerThreadings {
     std::thread managerThread;
     std::mutex managerThreadMutex;
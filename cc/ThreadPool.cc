@@ -1,22 +1,77 @@
 #include "ThreadPool.h"
 
-ThreadPool::ThreadPool(size_t numThreads) : stop(false) {
+namespace {
+// Polls before parking so back-to-back submissions do not pay a futex wakeup.
+const int spinIterations = 64;
+}
+
+ThreadPool::WorkerQueue::WorkerQueue(size_t capacity) : inbox(capacity), head(0), count(0) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    slots.resize(size);
+    mask = size - 1;
+}
+
+bool ThreadPool::WorkerQueue::pushFront(Task& task) {
+    if (count == slots.size()) {
+        return false;
+    }
+    head = (head - 1) & mask;
+    slots[head] = std::move(task);
+    count++;
+    return true;
+}
+
+bool ThreadPool::WorkerQueue::pushBack(Task& task) {
+    if (count == slots.size()) {
+        return false;
+    }
+    slots[(head + count) & mask] = std::move(task);
+    count++;
+    return true;
+}
+
+bool ThreadPool::WorkerQueue::popFront(Task& task) {
+    if (count == 0) {
+        return false;
+    }
+    task = std::move(slots[head]);
+    head = (head + 1) & mask;
+    count--;
+    return true;
+}
+
+bool ThreadPool::WorkerQueue::popBack(Task& task) {
+    if (count == 0) {
+        return false;
+    }
+    count--;
+    task = std::move(slots[(head + count) & mask]);
+    return true;
+}
+
+void ThreadPool::WorkerQueue::drainInbox() {
+    Submission submission;
+    while (count < slots.size() && inbox.pop(submission)) {
+        if (submission.highPriority) {
+            pushFront(submission.task);
+        } else {
+            pushBack(submission.task);
+        }
+    }
+}
+
+ThreadPool::ThreadPool(size_t numThreads, std::function<void(size_t)> threadInit, size_t queueCapacity) :
+    nextQueue(0), pendingTasks(0), activeTasks(0), stolenTasks(0), sleepingWorkers(0), stop(false) {
+    for (size_t i = 0; i < numThreads; ++i) {
+        queues.emplace_back(new WorkerQueue(queueCapacity));
+    }
     for (size_t i = 0; i < numThreads; ++i) {
         workers.emplace_back(
-            [this] {
-                while (true) {
-                    std::function<void()> task;
-                    {
-                        std::unique_lock<std::mutex> lock(queueMutex);
-                        queueCV.wait(lock, [this] { return stop || !tasks.empty(); });
-                        if (stop && tasks.empty()) {
-                            return;
-                        }
-                        task = std::move(tasks.front());
-                        tasks.pop();
-                    }
-                    task();
-                }
+            [this, i, threadInit] {
+                workerLoop(i, threadInit);
             }
         );
     }
@@ -24,8 +79,8 @@ ThreadPool::ThreadPool(size_t numThreads) : stop(false) {
 
 ThreadPool::~ThreadPool() {
     {
-        std::unique_lock<std::mutex> lock(queueMutex);
-        stop = true;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        stop.store(true, std::memory_order_release);
     }
     queueCV.notify_all();
     for (std::thread &worker : workers) {
@@ -33,10 +88,125 @@ ThreadPool::~ThreadPool() {
     }
 }
 
-void ThreadPool::enqueue(std::function<void()> task) {
+void ThreadPool::enqueue(Task task) {
+    enqueue(std::move(task), false);
+}
+
+void ThreadPool::enqueue(Task task, bool highPriority) {
+    // Counted before it is visible, so a worker that takes it never sees the count underflow.
+    pendingTasks.fetch_add(1);
+    Submission submission;
+    submission.task = std::move(task);
+    submission.highPriority = highPriority;
+    bool queued = false;
+    size_t first = nextQueue.fetch_add(1, std::memory_order_relaxed);
+    for (size_t offset = 0; offset < queues.size() && !queued; offset++) {
+        queued = queues[(first + offset) % queues.size()]->inbox.push(std::move(submission));
+    }
+    if (!queued) {
+        // No worker threads, or every inbox is full. Counted as active while it runs
+        // inline, like a worker's task, so waitIdle is woken when it finishes.
+        activeTasks.fetch_add(1, std::memory_order_relaxed);
+        pendingTasks.fetch_sub(1, std::memory_order_release);
+        runTask(submission.task);
+        return;
+    }
+    // Both sides are sequentially consistent: either the parking worker sees
+    // the new task in its predicate, or this sees it parked and wakes it.
+    if (sleepingWorkers.load() == 0) {
+        return;
+    }
     {
-        std::unique_lock<std::mutex> lock(queueMutex);
-        tasks.emplace(std::move(task));
+        std::lock_guard<std::mutex> lock(sleepMutex);
     }
     queueCV.notify_one();
 }
+
+void ThreadPool::waitIdle() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    idleCV.wait(lock, [this] {
+        return pendingTasks.load(std::memory_order_acquire) == 0 &&
+            activeTasks.load(std::memory_order_acquire) == 0;
+    });
+}
+
+size_t ThreadPool::getThreadCount() const {
+    return workers.size();
+}
+
+uint64_t ThreadPool::getStolenTaskCount() const {
+    return stolenTasks.load(std::memory_order_relaxed);
+}
+
+void ThreadPool::workerLoop(size_t index, const std::function<void(size_t)>& threadInit) {
+    if (threadInit) {
+        threadInit(index);
+    }
+    Task task;
+    while (true) {
+        if (popTask(index, task) || stealTask(index, task)) {
+            runTask(task);
+            continue;
+        }
+        bool found = false;
+        for (int spin = 0; spin < spinIterations && !found; spin++) {
+            std::this_thread::yield();
+            found = pendingTasks.load(std::memory_order_acquire) > 0;
+        }
+        if (found) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1);
+        queueCV.wait(lock, [this] {
+            return stop.load(std::memory_order_acquire) || pendingTasks.load() > 0;
+        });
+        sleepingWorkers.fetch_sub(1);
+        if (stop.load(std::memory_order_acquire) && pendingTasks.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::popTask(size_t index, Task& task) {
+    WorkerQueue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.drainInbox();
+    if (!queue.popFront(task)) {
+        return false;
+    }
+    // Count the task as active before it stops being pending so waitIdle
+    // never sees both counters at zero while it is in hand.
+    activeTasks.fetch_add(1, std::memory_order_relaxed);
+    pendingTasks.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+bool ThreadPool::stealTask(size_t index, Task& task) {
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        WorkerQueue& victim = *queues[(index + offset) % queues.size()];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            continue;
+        }
+        victim.drainInbox();
+        if (!victim.popBack(task)) {
+            continue;
+        }
+        activeTasks.fetch_add(1, std::memory_order_relaxed);
+        pendingTasks.fetch_sub(1, std::memory_order_release);
+        stolenTasks.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::runTask(Task& task) {
+    task();
+    task = nullptr;
+    if (activeTasks.fetch_sub(1, std::memory_order_acq_rel) == 1 &&
+        pendingTasks.load(std::memory_order_acquire) == 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        idleCV.notify_all();
+    }
+}
@@ -1,27 +1,85 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include "InlineFunction.h"
+#include "RingBuffer.h"
+#include <atomic>
 #include <vector>
-#include <queue>
+#include <memory>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
 
+// Work-stealing pool. Every worker owns a deque: it takes work from the front
+// of its own deque and, once that is empty, steals from the back of the
+// others. Tasks submitted from outside are spread round-robin over the
+// deques; high priority tasks go to the front so they run before anything
+// already waiting on that worker.
+//
+// Tasks are stored inline in fixed-capacity rings, so submitting work never
+// allocates. Submitters never lock a deque: they push into the worker's
+// lock-free inbox, which is moved into the deque by whichever thread next
+// holds that deque's mutex (the owner, or a thief). The sleep mutex is only
+// taken when a worker is parked. If every inbox is full the task runs on the
+// caller.
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t numThreads);
+    typedef InlineFunction<void(), 48> Task;
+
+    // threadInit runs once on each worker (with its index) before it takes work.
+    explicit ThreadPool(size_t numThreads, std::function<void(size_t)> threadInit = nullptr,
+        size_t queueCapacity = 256);
     ~ThreadPool();
 
-    void enqueue(std::function<void()> task);
+    void enqueue(Task task);
+    void enqueue(Task task, bool highPriority);
+    // Blocks until every submitted task has finished.
+    void waitIdle();
+    size_t getThreadCount() const;
+    uint64_t getStolenTaskCount() const;
 
 private:
+    struct Submission {
+        Task task;
+        bool highPriority;
+    };
+
+    // Ring buffer used as a deque; capacity is a power of two.
+    struct WorkerQueue {
+        explicit WorkerQueue(size_t capacity);
+        bool pushFront(Task& task);
+        bool pushBack(Task& task);
+        bool popFront(Task& task);
+        bool popBack(Task& task);
+        // Caller holds mutex, which makes it the inbox's only consumer.
+        void drainInbox();
+
+        MPSCRingBuffer<Submission> inbox;
+        std::mutex mutex;
+        std::vector<Task> slots;
+        size_t mask;
+        size_t head;
+        size_t count;
+    };
+
+    void workerLoop(size_t index, const std::function<void(size_t)>& threadInit);
+    bool popTask(size_t index, Task& task);
+    bool stealTask(size_t index, Task& task);
+    void runTask(Task& task);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
+    std::atomic<size_t> nextQueue;
+    std::atomic<size_t> pendingTasks;
+    std::atomic<size_t> activeTasks;
+    std::atomic<uint64_t> stolenTasks;
+    std::atomic<size_t> sleepingWorkers;
 
-    std::mutex queueMutex;
+    std::mutex sleepMutex;
     std::condition_variable queueCV;
-    bool stop;
+    std::condition_variable idleCV;
+    std::atomic<bool> stop;
 };
 
 #endif // THREADPOOL_H
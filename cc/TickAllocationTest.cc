@@ -0,0 +1,148 @@
+// TickAllocationTest.cc
+// Counts heap allocations made by the clock thread while MasterClock runs a
+// warmed-up set of looping batches, once on simulated time with the batches
+// run inline and once in real time with a worker pool. Any allocation on the
+// tick path fails the test. Needs no window or audio device; build.sh links
+// it as tick_allocation_test and runs it.
+#include "ClockSource.h"
+#include "MasterClock.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Only the thread that runs executeScheduledBatches sets this.
+thread_local bool isClockThread = false;
+std::atomic<bool> countingAllocations(false);
+std::atomic<uint64_t> clockThreadAllocations(0);
+
+void* countedAllocate(size_t size) {
+    if (isClockThread && countingAllocations.load(std::memory_order_relaxed)) {
+        clockThreadAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+// Kept out of line so GCC does not pair the inlined free with operator new.
+__attribute__((noinline)) void countedRelease(void* pointer) {
+    std::free(pointer);
+}
+
+}
+
+void* operator new(size_t size) {
+    void* pointer = countedAllocate(size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    countedRelease(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    countedRelease(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    countedRelease(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    countedRelease(pointer);
+}
+
+namespace {
+
+const uint64_t warmupTicks = 64;
+const uint64_t measuredTicks = 512;
+// Loop lengths in grid divisions; the first one falls due on every tick.
+const int intervalDivisions[] = {1, 2, 3, 4, 8};
+const size_t intervalCount = sizeof(intervalDivisions) / sizeof(intervalDivisions[0]);
+
+void waitForTicks(const std::atomic<uint64_t>& ticks, uint64_t target) {
+    while (ticks.load(std::memory_order_acquire) < target) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+// Returns the number of allocations the clock thread made over measuredTicks.
+uint64_t runScenario(const char* name, bool simulated) {
+    // A 3 ms division keeps the real-time run to a couple of seconds.
+    MasterClock masterClock(1250.0, 16.0);
+    YAML::Node clockConfig;
+    clockConfig["worker_threads"] = simulated ? 0 : 2;
+    clockConfig["calibration_samples"] = 20;
+    masterClock.setClockConfig(clockConfig);
+    VirtualClockSource virtualClock;
+    if (simulated) {
+        masterClock.setClockSource(&virtualClock);
+    }
+    masterClock.start();
+    Duration division = masterClock.fetchDivisionDurationAsDuration();
+
+    std::atomic<uint64_t> ticks(0);
+    std::atomic<uint64_t> actionsRun(0);
+    for (size_t index = 0; index < intervalCount; index++) {
+        std::string tag = "alloc" + std::to_string(index);
+        if (index == 0) {
+            masterClock.addItemToBatchAtInterval([&ticks]() {
+                ticks.fetch_add(1, std::memory_order_release);
+            }, division, tag, true, ActionPriority::High);
+        }
+        // A second action on the same tag shares the batch.
+        for (int action = 0; action < 2; action++) {
+            masterClock.addItemToBatchAtInterval([&actionsRun]() {
+                actionsRun.fetch_add(1, std::memory_order_relaxed);
+            }, division * intervalDivisions[index], tag, true);
+        }
+    }
+
+    std::thread clockThread([&masterClock]() {
+        isClockThread = true;
+        masterClock.executeScheduledBatches();
+    });
+    waitForTicks(ticks, warmupTicks);
+    clockThreadAllocations.store(0, std::memory_order_relaxed);
+    countingAllocations.store(true, std::memory_order_release);
+    waitForTicks(ticks, ticks.load(std::memory_order_acquire) + measuredTicks);
+    countingAllocations.store(false, std::memory_order_release);
+    uint64_t allocations = clockThreadAllocations.load(std::memory_order_relaxed);
+    masterClock.stop();
+    clockThread.join();
+
+    printf("TickAllocationTest::%s: %llu allocations on the clock thread over %llu ticks (%llu actions run).\n",
+        name, static_cast<unsigned long long>(allocations), static_cast<unsigned long long>(measuredTicks),
+        static_cast<unsigned long long>(actionsRun.load(std::memory_order_relaxed)));
+    return allocations;
+}
+
+}
+
+int main() {
+    uint64_t allocations = runScenario("simulated", true) + runScenario("realtime", false);
+    if (allocations != 0) {
+        printf("TickAllocationTest::FAILED: the tick path allocated.\n");
+        return 1;
+    }
+    printf("TickAllocationTest::Passed.\n");
+    return 0;
+}
@@ -0,0 +1,649 @@
+#include "VoiceEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+const VoiceHandle VoiceEngine::noVoice;
+
+namespace {
+const uint32_t slotMask = 0xFFFF;
+const uint64_t unitStep = 1ull << 32;
+const float minimumRate = 1.0f / 16.0f;
+const float maximumRate = 16.0f;
+const size_t commandQueueSize = 1024;
+// stopSample's count reads this until the stop has been applied.
+const size_t pendingStop = std::numeric_limits<size_t>::max();
+
+uint64_t getSteadyNanoseconds() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+}
+
+VoiceEngine::VoiceEngine(bool verbose) :
+    verbose(verbose), kernels(MixKernels::get()), device(0), deviceRunning(false),
+    frequency(0), channels(0), format(0), bufferFrames(0),
+    stealMode(StealMode::Oldest), fadeMilliseconds(5.0), resamplerQuality(ResamplerQuality::Medium),
+    sampleRateConverter(verbose), fadeFrames(0), maxSoundingVoices(0),
+    nextStartOrder(0), soundingVoiceCount(0), voiceCommands(commandQueueSize), nextHandle(1), mixerBusy(false),
+    activeVoiceCount(0), peakVoiceCount(0), stolenVoiceCount(0), chokedVoiceCount(0),
+    droppedVoiceCount(0), droppedCommandCount(0), appliedCommandCount(0), commandLatencyNanoseconds(0),
+    maxCommandLatencyNanoseconds(0), callbackCount(0) {}
+
+VoiceEngine::~VoiceEngine() {
+    close();
+}
+// Device Section
+//###################################################################################################################
+bool VoiceEngine::open(int newFrequency, int newChannels, SDL_AudioFormat newFormat, int newBufferFrames,
+    int maxVoices) {
+    if (!allocateVoices(newFrequency, newChannels, newFormat, newBufferFrames, maxVoices)) {
+        return false;
+    }
+    SDL_AudioSpec desired;
+    SDL_zero(desired);
+    desired.freq = frequency;
+    desired.format = format;
+    desired.channels = static_cast<Uint8>(channels);
+    desired.samples = static_cast<Uint16>(bufferFrames);
+    desired.callback = &VoiceEngine::audioCallback;
+    desired.userdata = this;
+    // No allowed changes: SDL converts to whatever the hardware wants, so
+    // the callback always sees the spec the samples were loaded for.
+    device = SDL_OpenAudioDevice(nullptr, 0, &desired, nullptr, 0);
+    if (device == 0) {
+        printf("   ---VoiceEngine::open::SDL_OpenAudioDevice failed: %s\n", SDL_GetError());
+        return false;
+    }
+    deviceRunning.store(true, std::memory_order_release);
+    SDL_PauseAudioDevice(device, 0);
+    printf("   VoiceEngine::open::%d Hz, %d channels, %s, %zu frame buffer, %u voices, %s kernels.\n",
+        frequency, channels, format == AUDIO_F32SYS ? "float" : "16-bit", bufferFrames,
+        maxSoundingVoices, kernels.name);
+    printf("   VoiceEngine::open::Stealing %s voices with a %.1f ms fade, resampling other rates at %s quality.\n",
+        getStealModeName(stealMode), fadeMilliseconds, SampleRateConverter::getQualityName(resamplerQuality));
+    return true;
+}
+
+bool VoiceEngine::openOffline(int newFrequency, int newChannels, SDL_AudioFormat newFormat, int newBufferFrames,
+    int maxVoices) {
+    return allocateVoices(newFrequency, newChannels, newFormat, newBufferFrames, maxVoices);
+}
+
+void VoiceEngine::closeDevice() {
+    if (device != 0) {
+        // Returns once the last callback has finished, so from here on waiters drain the queue themselves.
+        SDL_CloseAudioDevice(device);
+        device = 0;
+        deviceRunning.store(false, std::memory_order_release);
+    }
+}
+
+void VoiceEngine::close() {
+    closeDevice();
+    acquireMixer();
+    applyCommands();
+    while (!activeVoices.empty()) {
+        releaseVoice(activeVoices.size() - 1);
+    }
+    releaseMixer();
+}
+
+bool VoiceEngine::allocateVoices(int newFrequency, int newChannels, SDL_AudioFormat newFormat, int newBufferFrames,
+    int maxVoices) {
+    if (newFormat != AUDIO_F32SYS && newFormat != AUDIO_S16SYS) {
+        printf("   ---VoiceEngine::open::Unsupported format 0x%x, use float or 16-bit.\n", newFormat);
+        return false;
+    }
+    if (newFrequency <= 0 || newChannels <= 0 || newBufferFrames <= 0 || maxVoices <= 0) {
+        printf("   ---VoiceEngine::open::Invalid spec.\n");
+        return false;
+    }
+    closeDevice();
+    acquireMixer();
+    // Commands posted against the old pool are applied to it before it goes.
+    applyCommands();
+    frequency = newFrequency;
+    channels = newChannels;
+    format = newFormat;
+    bufferFrames = static_cast<size_t>(std::min(newBufferFrames, static_cast<int>(std::numeric_limits<Uint16>::max())));
+    // Fading voices live in the reserve so a steal never blocks the new voice.
+    int reserve = std::max(4, maxVoices / 4);
+    maxSoundingVoices = static_cast<uint32_t>(std::min(maxVoices, static_cast<int>(slotMask) - reserve));
+    size_t voiceCount = maxSoundingVoices + static_cast<size_t>(reserve);
+    fadeFrames = static_cast<uint32_t>(std::max(1.0, std::ceil(fadeMilliseconds * frequency / 1000.0)));
+    sampleRateConverter.prepare(frequency, resamplerQuality);
+    voiceSamples.assign(voiceCount, nullptr);
+    voiceFrameCount.assign(voiceCount, 0);
+    voicePosition.assign(voiceCount, 0);
+    voiceStep.assign(voiceCount, unitStep);
+    voiceGain.assign(voiceCount, 0.0f);
+    voiceHandle.assign(voiceCount, noVoice);
+    voiceNote.assign(voiceCount, 0);
+    voiceChokeGroup.assign(voiceCount, 0);
+    voiceStartOrder.assign(voiceCount, 0);
+    voiceFade.assign(voiceCount, 1.0f);
+    voiceFadeStep.assign(voiceCount, 0.0f);
+    activeVoices.clear();
+    activeVoices.reserve(voiceCount);
+    freeVoices.clear();
+    freeVoices.reserve(voiceCount);
+    // Hand out low slots first.
+    for (size_t voice = voiceCount; voice > 0; voice--) {
+        freeVoices.push_back(static_cast<uint16_t>(voice - 1));
+    }
+    mixBuffer.assign(bufferFrames * channels, 0.0f);
+    soundingVoiceCount = 0;
+    activeVoiceCount.store(0, std::memory_order_relaxed);
+    peakVoiceCount.store(0, std::memory_order_relaxed);
+    releaseMixer();
+    return true;
+}
+
+void VoiceEngine::setStealMode(StealMode mode, double newFadeMilliseconds) {
+    stealMode = mode;
+    fadeMilliseconds = std::max(0.0, newFadeMilliseconds);
+}
+
+void VoiceEngine::setResamplerQuality(ResamplerQuality quality) {
+    resamplerQuality = quality;
+}
+
+const SampleRateConverter& VoiceEngine::getSampleRateConverter() const {
+    return sampleRateConverter;
+}
+
+StealMode VoiceEngine::parseStealMode(const std::string& modeName) {
+    if (modeName == "quietest") {
+        return StealMode::Quietest;
+    } else if (modeName != "oldest") {
+        printf("   ---VoiceEngine::parseStealMode::Unknown voice_steal '%s', using oldest.\n", modeName.c_str());
+    }
+    return StealMode::Oldest;
+}
+
+const char* VoiceEngine::getStealModeName(StealMode mode) {
+    switch (mode) {
+        case StealMode::Quietest:
+            return "quietest";
+        default:
+            return "oldest";
+    }
+}
+
+int VoiceEngine::getFrequency() const {
+    return frequency;
+}
+
+int VoiceEngine::getChannels() const {
+    return channels;
+}
+
+SDL_AudioFormat VoiceEngine::getFormat() const {
+    return format;
+}
+// Sample Section
+//###################################################################################################################
+bool VoiceEngine::loadSample(const char* filepath, std::vector<float>& frames) {
+    SDL_AudioSpec fileSpec;
+    Uint8* fileBuffer = nullptr;
+    Uint32 fileLength = 0;
+    if (SDL_LoadWAV(filepath, &fileSpec, &fileBuffer, &fileLength) == nullptr) {
+        printf("         ---VoiceEngine::loadSample::%s: %s\n", filepath, SDL_GetError());
+        return false;
+    }
+    // SDL only converts the format and channel layout; the rate is left to the SampleRateConverter.
+    SDL_AudioCVT converter;
+    if (SDL_BuildAudioCVT(&converter, fileSpec.format, fileSpec.channels, fileSpec.freq,
+        AUDIO_F32SYS, static_cast<Uint8>(channels), fileSpec.freq) < 0) {
+        printf("         ---VoiceEngine::loadSample::%s: %s\n", filepath, SDL_GetError());
+        SDL_FreeWAV(fileBuffer);
+        return false;
+    }
+    std::vector<Uint8> converted(static_cast<size_t>(fileLength) * std::max(1, converter.len_mult));
+    std::memcpy(converted.data(), fileBuffer, fileLength);
+    SDL_FreeWAV(fileBuffer);
+    converter.buf = converted.data();
+    converter.len = static_cast<int>(fileLength);
+    size_t convertedBytes = fileLength;
+    if (converter.needed) {
+        if (SDL_ConvertAudio(&converter) < 0) {
+            printf("         ---VoiceEngine::loadSample::%s: %s\n", filepath, SDL_GetError());
+            return false;
+        }
+        convertedBytes = static_cast<size_t>(converter.len_cvt);
+    }
+    size_t frameCount = convertedBytes / (sizeof(float) * channels);
+    const float* decoded = reinterpret_cast<const float*>(converted.data());
+    if (fileSpec.freq != frequency) {
+        return sampleRateConverter.convert(decoded, frameCount, channels, fileSpec.freq, frames);
+    }
+    frames.assign(decoded, decoded + frameCount * channels);
+    return true;
+}
+// Voice Section
+//###################################################################################################################
+VoiceHandle VoiceEngine::play(const float* frames, uint32_t frameCount, const VoiceOptions& options) {
+    if (frames == nullptr || frameCount == 0) {
+        return noVoice;
+    }
+    VoiceCommand command;
+    command.type = VoiceCommandType::Play;
+    command.frames = frames;
+    command.frameCount = frameCount;
+    command.options = options;
+    command.handle = nextHandle.fetch_add(1, std::memory_order_relaxed);
+    if (command.handle == noVoice) {
+        // Wrapped after 2^32 plays; noVoice is never handed out.
+        command.handle = nextHandle.fetch_add(1, std::memory_order_relaxed);
+    }
+    VoiceHandle handle = command.handle;
+    return postCommand(command) ? handle : noVoice;
+}
+
+void VoiceEngine::stop(VoiceHandle handle) {
+    if (handle == noVoice) {
+        return;
+    }
+    VoiceCommand command;
+    command.type = VoiceCommandType::Stop;
+    command.handle = handle;
+    postCommand(command);
+}
+
+void VoiceEngine::setGain(VoiceHandle handle, float gain) {
+    if (handle == noVoice) {
+        return;
+    }
+    VoiceCommand command;
+    command.type = VoiceCommandType::SetGain;
+    command.handle = handle;
+    command.options.gain = gain;
+    postCommand(command);
+}
+
+void VoiceEngine::choke(int chokeGroup) {
+    if (chokeGroup == 0) {
+        return;
+    }
+    VoiceCommand command;
+    command.type = VoiceCommandType::Choke;
+    command.options.chokeGroup = chokeGroup;
+    postCommand(command);
+}
+
+void VoiceEngine::stopAll() {
+    VoiceCommand command;
+    command.type = VoiceCommandType::StopAll;
+    postCommand(command);
+}
+
+size_t VoiceEngine::stopSample(const float* frames) {
+    std::atomic<size_t> stopped(pendingStop);
+    VoiceCommand command;
+    command.type = VoiceCommandType::StopSample;
+    command.frames = frames;
+    command.stopped = &stopped;
+    command.postedNanoseconds = getSteadyNanoseconds();
+    // The caller frees frames next, so unlike a play this stop cannot be dropped.
+    while (!voiceCommands.push(std::move(command))) {
+        waitForCommands();
+    }
+    while (stopped.load(std::memory_order_acquire) == pendingStop) {
+        waitForCommands();
+    }
+    return stopped.load(std::memory_order_relaxed);
+}
+// Command Section
+//###################################################################################################################
+bool VoiceEngine::postCommand(VoiceCommand& command) {
+    command.postedNanoseconds = getSteadyNanoseconds();
+    if (!voiceCommands.push(std::move(command))) {
+        // Control threads never wait on the audio thread; a full queue drops the command.
+        droppedCommandCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void VoiceEngine::waitForCommands() {
+    // Without a running callback nobody else drains the queue, so the waiter applies it.
+    if (!deviceRunning.load(std::memory_order_acquire) && !mixerBusy.exchange(true, std::memory_order_acquire)) {
+        applyCommands();
+        releaseMixer();
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+void VoiceEngine::acquireMixer() {
+    // Only for threads that may wait; the callback never calls this.
+    while (mixerBusy.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+void VoiceEngine::releaseMixer() {
+    mixerBusy.store(false, std::memory_order_release);
+}
+
+void VoiceEngine::applyCommands() {
+    // Bounded so producers that keep posting cannot hold the audio thread in here.
+    size_t budget = voiceCommands.capacity();
+    VoiceCommand command;
+    uint64_t appliedNanoseconds = 0;
+    while (budget-- > 0 && voiceCommands.pop(command)) {
+        if (appliedNanoseconds == 0) {
+            appliedNanoseconds = getSteadyNanoseconds();
+        }
+        switch (command.type) {
+            case VoiceCommandType::Play:
+                startVoice(command);
+                break;
+            case VoiceCommandType::Stop: {
+                int voice = findVoice(command.handle);
+                if (voice >= 0 && voiceFadeStep[voice] == 0.0f) {
+                    beginFade(static_cast<uint16_t>(voice));
+                }
+                break;
+            }
+            case VoiceCommandType::SetGain: {
+                int voice = findVoice(command.handle);
+                if (voice >= 0) {
+                    voiceGain[voice] = command.options.gain;
+                }
+                break;
+            }
+            case VoiceCommandType::Choke:
+                fadeChokeGroup(command.options.chokeGroup);
+                break;
+            case VoiceCommandType::StopAll:
+                while (!activeVoices.empty()) {
+                    releaseVoice(activeVoices.size() - 1);
+                }
+                break;
+            case VoiceCommandType::StopSample:
+                command.stopped->store(cutSample(command.frames), std::memory_order_release);
+                break;
+        }
+        // Commands posted after the first pop of this drain count as no wait.
+        uint64_t latency = appliedNanoseconds > command.postedNanoseconds ?
+            appliedNanoseconds - command.postedNanoseconds : 0;
+        commandLatencyNanoseconds.fetch_add(latency, std::memory_order_relaxed);
+        if (latency > maxCommandLatencyNanoseconds.load(std::memory_order_relaxed)) {
+            maxCommandLatencyNanoseconds.store(latency, std::memory_order_relaxed);
+        }
+        appliedCommandCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void VoiceEngine::startVoice(const VoiceCommand& command) {
+    const VoiceOptions& options = command.options;
+    fadeChokeGroup(options.chokeGroup);
+    if (options.note != 0 && options.polyphony > 0) {
+        int noteVoices = 0;
+        for (uint16_t voice : activeVoices) {
+            if (voiceNote[voice] == options.note && voiceFadeStep[voice] == 0.0f) {
+                noteVoices++;
+            }
+        }
+        // A retriggered note always gives up its own oldest voice.
+        for (; noteVoices >= options.polyphony; noteVoices--) {
+            int victim = findVictim(options.note);
+            if (victim < 0) {
+                break;
+            }
+            beginFade(static_cast<uint16_t>(victim));
+        }
+    }
+    while (soundingVoiceCount >= maxSoundingVoices) {
+        int victim = findVictim(0);
+        if (victim < 0) {
+            break;
+        }
+        beginFade(static_cast<uint16_t>(victim));
+        stolenVoiceCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (freeVoices.empty() && !reclaimFadingVoice()) {
+        droppedVoiceCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    uint16_t voice = freeVoices.back();
+    freeVoices.pop_back();
+    voiceHandle[voice] = command.handle;
+    voiceSamples[voice] = command.frames;
+    voiceFrameCount[voice] = command.frameCount;
+    voicePosition[voice] = 0;
+    voiceStep[voice] = options.rate == 1.0f ? unitStep :
+        static_cast<uint64_t>(std::llround(std::min(maximumRate, std::max(minimumRate, options.rate)) * unitStep));
+    voiceGain[voice] = options.gain;
+    voiceNote[voice] = options.note;
+    voiceChokeGroup[voice] = options.chokeGroup;
+    voiceStartOrder[voice] = nextStartOrder++;
+    voiceFade[voice] = 1.0f;
+    voiceFadeStep[voice] = 0.0f;
+    activeVoices.push_back(voice);
+    soundingVoiceCount++;
+    uint32_t active = static_cast<uint32_t>(activeVoices.size());
+    activeVoiceCount.store(active, std::memory_order_relaxed);
+    if (active > peakVoiceCount.load(std::memory_order_relaxed)) {
+        peakVoiceCount.store(active, std::memory_order_relaxed);
+    }
+}
+
+void VoiceEngine::fadeChokeGroup(int chokeGroup) {
+    if (chokeGroup == 0) {
+        return;
+    }
+    for (uint16_t voice : activeVoices) {
+        if (voiceChokeGroup[voice] == chokeGroup && voiceFadeStep[voice] == 0.0f) {
+            beginFade(voice);
+            chokedVoiceCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+int VoiceEngine::findVoice(VoiceHandle handle) const {
+    for (uint16_t voice : activeVoices) {
+        if (voiceHandle[voice] == handle) {
+            return voice;
+        }
+    }
+    return -1;
+}
+
+size_t VoiceEngine::cutSample(const float* frames) {
+    size_t stopped = 0;
+    size_t activeIndex = 0;
+    while (activeIndex < activeVoices.size()) {
+        if (voiceSamples[activeVoices[activeIndex]] == frames) {
+            releaseVoice(activeIndex);
+            stopped++;
+        } else {
+            activeIndex++;
+        }
+    }
+    return stopped;
+}
+
+void VoiceEngine::beginFade(uint16_t voice) {
+    voiceFadeStep[voice] = 1.0f / fadeFrames;
+    soundingVoiceCount--;
+}
+
+int VoiceEngine::findVictim(uint32_t note) const {
+    int victim = -1;
+    float victimLevel = 0.0f;
+    for (uint16_t voice : activeVoices) {
+        if (voiceFadeStep[voice] != 0.0f || (note != 0 && voiceNote[voice] != note)) {
+            continue;
+        }
+        if (note == 0 && stealMode == StealMode::Quietest) {
+            float level = getUpcomingLevel(voice);
+            if (victim < 0 || level < victimLevel) {
+                victim = voice;
+                victimLevel = level;
+            }
+        } else if (victim < 0 || voiceStartOrder[voice] < voiceStartOrder[victim]) {
+            victim = voice;
+        }
+    }
+    return victim;
+}
+
+float VoiceEngine::getUpcomingLevel(uint16_t voice) const {
+    // Peak over the source frames a fade would cover, i.e. what stealing would cut short.
+    size_t position = static_cast<size_t>(voicePosition[voice] >> 32);
+    size_t fadeSourceFrames = static_cast<size_t>((static_cast<uint64_t>(fadeFrames) * voiceStep[voice]) >> 32) + 1;
+    size_t frameCount = std::min<size_t>(fadeSourceFrames, voiceFrameCount[voice] - position);
+    const float* samples = voiceSamples[voice] + position * channels;
+    float peak = 0.0f;
+    for (size_t index = 0; index < frameCount * channels; index++) {
+        peak = std::max(peak, std::fabs(samples[index]));
+    }
+    return peak * std::fabs(voiceGain[voice]);
+}
+
+bool VoiceEngine::reclaimFadingVoice() {
+    // The reserve is full of fades; cut the one closest to silence.
+    size_t quietestIndex = activeVoices.size();
+    for (size_t activeIndex = 0; activeIndex < activeVoices.size(); activeIndex++) {
+        uint16_t voice = activeVoices[activeIndex];
+        if (voiceFadeStep[voice] != 0.0f &&
+            (quietestIndex == activeVoices.size() || voiceFade[voice] < voiceFade[activeVoices[quietestIndex]])) {
+            quietestIndex = activeIndex;
+        }
+    }
+    if (quietestIndex == activeVoices.size()) {
+        return false;
+    }
+    releaseVoice(quietestIndex);
+    return true;
+}
+
+void VoiceEngine::releaseVoice(size_t activeIndex) {
+    uint16_t voice = activeVoices[activeIndex];
+    if (voiceFadeStep[voice] == 0.0f) {
+        soundingVoiceCount--;
+    }
+    voiceSamples[voice] = nullptr;
+    voiceFadeStep[voice] = 0.0f;
+    activeVoices[activeIndex] = activeVoices.back();
+    activeVoices.pop_back();
+    freeVoices.push_back(voice);
+    activeVoiceCount.store(static_cast<uint32_t>(activeVoices.size()), std::memory_order_relaxed);
+}
+
+uint32_t VoiceEngine::getActiveVoiceCount() const {
+    return activeVoiceCount.load(std::memory_order_relaxed);
+}
+// Mix Section
+//###################################################################################################################
+void VoiceEngine::audioCallback(void* userdata, Uint8* stream, int length) {
+    static_cast<VoiceEngine*>(userdata)->fillDeviceBuffer(stream, length);
+}
+
+void VoiceEngine::fillDeviceBuffer(Uint8* stream, int length) {
+    callbackCount.fetch_add(1, std::memory_order_relaxed);
+    size_t bytesPerFrame = channels * (format == AUDIO_F32SYS ? sizeof(float) : sizeof(int16_t));
+    size_t frameCount = static_cast<size_t>(length) / bytesPerFrame;
+    if (mixerBusy.exchange(true, std::memory_order_acquire)) {
+        // Only while the device opens or closes under a control thread draining
+        // the queue; a buffer of silence is better than waiting for it.
+        std::memset(stream, 0, static_cast<size_t>(length));
+        return;
+    }
+    applyCommands();
+    for (size_t offset = 0; offset < frameCount; offset += bufferFrames) {
+        size_t blockFrames = std::min(bufferFrames, frameCount - offset);
+        mixVoices(mixBuffer.data(), blockFrames);
+        size_t sampleOffset = offset * channels;
+        if (format == AUDIO_F32SYS) {
+            kernels.clampFloat(reinterpret_cast<float*>(stream) + sampleOffset, mixBuffer.data(), blockFrames * channels);
+        } else {
+            kernels.floatToS16(reinterpret_cast<int16_t*>(stream) + sampleOffset, mixBuffer.data(), blockFrames * channels);
+        }
+    }
+    releaseMixer();
+}
+
+void VoiceEngine::render(float* output, size_t frameCount) {
+    acquireMixer();
+    applyCommands();
+    mixVoices(output, frameCount);
+    releaseMixer();
+}
+
+void VoiceEngine::mixVoices(float* output, size_t frameCount) {
+    std::fill(output, output + frameCount * channels, 0.0f);
+    size_t activeIndex = 0;
+    while (activeIndex < activeVoices.size()) {
+        uint16_t voice = activeVoices[activeIndex];
+        uint64_t position = voicePosition[voice];
+        uint64_t step = voiceStep[voice];
+        uint64_t end = static_cast<uint64_t>(voiceFrameCount[voice]) << 32;
+        size_t count = static_cast<size_t>(std::min<uint64_t>(frameCount, (end - position + step - 1) / step));
+        if (voiceFadeStep[voice] != 0.0f) {
+            count = mixFadingVoice(output, voice, count);
+        } else if (step == unitStep) {
+            kernels.mixAdd(output, voiceSamples[voice] + static_cast<size_t>(position >> 32) * channels,
+                count * channels, voiceGain[voice]);
+        } else {
+            kernels.mixAddResampled(output, voiceSamples[voice], voiceFrameCount[voice], channels, position, step,
+                count, voiceGain[voice]);
+        }
+        voicePosition[voice] = position + count * step;
+        if (voicePosition[voice] >= end || voiceFade[voice] <= 0.0f) {
+            // Swap-remove; the slot moved into activeIndex is mixed next.
+            releaseVoice(activeIndex);
+        } else {
+            activeIndex++;
+        }
+    }
+}
+size_t VoiceEngine::mixFadingVoice(float* output, uint16_t voice, size_t frameCount) {
+    // Fades are a few milliseconds on a handful of voices, so a per-frame ramp in plain C++ is enough.
+    uint64_t position = voicePosition[voice];
+    uint64_t positionStep = voiceStep[voice];
+    const float* source = voiceSamples[voice] + static_cast<size_t>(position >> 32) * channels;
+    float fade = voiceFade[voice];
+    float step = voiceFadeStep[voice];
+    float gain = voiceGain[voice];
+    size_t frame = 0;
+    for (; frame < frameCount && fade > 0.0f; frame++) {
+        float frameGain = gain * fade;
+        if (positionStep == unitStep) {
+            for (int channel = 0; channel < channels; channel++) {
+                output[frame * channels + channel] += source[frame * channels + channel] * frameGain;
+            }
+        } else {
+            kernels.mixAddResampled(output + frame * channels, voiceSamples[voice], voiceFrameCount[voice], channels,
+                position + frame * positionStep, positionStep, 1, frameGain);
+        }
+        fade -= step;
+    }
+    voiceFade[voice] = std::max(0.0f, fade);
+    return frame;
+}
+// Report Section
+//###################################################################################################################
+void VoiceEngine::printReport() const {
+    printf("   VoiceEngine::Report::Peak voices %u of %zu, stolen %llu, choked %llu, dropped %llu, callbacks %llu, %s kernels.\n",
+        peakVoiceCount.load(std::memory_order_relaxed), voiceSamples.size(),
+        static_cast<unsigned long long>(stolenVoiceCount.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(chokedVoiceCount.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(droppedVoiceCount.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(callbackCount.load(std::memory_order_relaxed)), kernels.name);
+    uint64_t applied = appliedCommandCount.load(std::memory_order_relaxed);
+    if (applied > 0) {
+        printf("   VoiceEngine::Report::%llu commands applied, %llu dropped on a full queue, queue latency avg %.2f ms, max %.2f ms.\n",
+            static_cast<unsigned long long>(applied),
+            static_cast<unsigned long long>(droppedCommandCount.load(std::memory_order_relaxed)),
+            commandLatencyNanoseconds.load(std::memory_order_relaxed) / 1e6 / applied,
+            maxCommandLatencyNanoseconds.load(std::memory_order_relaxed) / 1e6);
+    }
+}
@@ -0,0 +1,188 @@
+#ifndef VOICE_ENGINE_H
+#define VOICE_ENGINE_H
+
+#ifdef _WIN32
+#include <SDL.h> // Include path for Windows
+#else
+#include <SDL2/SDL.h> // Include path for Linux
+#endif
+#include "MixKernels.h"
+#include "RingBuffer.h"
+#include "SampleRateConverter.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Numbered by play() in posting order, so it is known before the audio thread
+// picks a slot; a handle goes stale once its voice ends.
+typedef uint32_t VoiceHandle;
+
+enum class StealMode {
+    Oldest,  // the voice that started first
+    Quietest // the voice with the lowest level over the next fade
+};
+
+// Where a new voice sits in the pool's limits.
+struct VoiceOptions {
+    float gain = 1.0f;
+    uint32_t note = 0;  // voices sharing a note id count towards its polyphony, 0 = none
+    int polyphony = 0;  // voices this note may hold at once, 0 = only the global cap
+    int chokeGroup = 0; // a new voice fades out the others in its group, 0 = none
+    float rate = 1.0f;  // playback speed, 2 = an octave up; clamped to 1/16..16
+};
+
+// Melydy's own voice mixer. It opens the audio device with a callback and
+// mixes a fixed pool of voices into it, so the number of simultaneous hits
+// is set by max_voices rather than SDL_mixer's channel count. Voice state is
+// kept as parallel arrays (sample pointer, length, position, gain) and every
+// buffer is allocated in open(), so the callback never allocates. Samples are
+// float frames in the device's rate and channel layout; loadSample converts
+// a WAV file into that layout once, up front, with SDL for the format and
+// channels and the SampleRateConverter for the rate. A voice with a rate other than 1
+// reads its sample through the cubic resampling kernel, so one sample can be
+// played at several pitches; positions are 32.32 fixed-point frames.
+//
+// Control threads never touch the pool. play, stop, setGain, choke and the
+// stops are posted as timestamped commands on a lock-free ring, and the
+// audio callback (or render()) applies whatever is pending at the start of
+// each buffer, so neither side ever waits on a lock.
+//
+// At most maxVoices voices sound at once. When a new voice would exceed the
+// global or per-note cap, or hits its choke group, the voice it replaces is
+// faded out over a few milliseconds instead of cut. Fading voices run in a
+// small reserve of extra slots so the new hit always gets a voice.
+class VoiceEngine {
+    public:
+        static const VoiceHandle noVoice = 0;
+
+        explicit VoiceEngine(bool verbose = false);
+        ~VoiceEngine();
+
+        // format is AUDIO_F32SYS or AUDIO_S16SYS; mixing is always float.
+        bool open(int frequency, int channels, SDL_AudioFormat format, int bufferFrames, int maxVoices);
+        // Same voice pool without a device; the caller pulls audio with render().
+        bool openOffline(int frequency, int channels, SDL_AudioFormat format, int bufferFrames, int maxVoices);
+        // Stops the device callback but keeps the voices, e.g. to hand over to an offline render.
+        void closeDevice();
+        void close();
+
+        // Call before open(); fadeMilliseconds is used for steals, chokes and stop().
+        void setStealMode(StealMode mode, double fadeMilliseconds);
+        static StealMode parseStealMode(const std::string& modeName);
+        static const char* getStealModeName(StealMode mode);
+        // Call before open(); how loadSample converts files recorded at another rate.
+        void setResamplerQuality(ResamplerQuality quality);
+        const SampleRateConverter& getSampleRateConverter() const;
+
+        // Safe from several loader threads.
+        bool loadSample(const char* filepath, std::vector<float>& frames);
+        // Safe from any thread; the voice starts with the next buffer. frames must
+        // outlive the voice. Returns noVoice only if the command queue is full.
+        VoiceHandle play(const float* frames, uint32_t frameCount, const VoiceOptions& options = VoiceOptions());
+        // Fades out the one voice the handle was returned for, if it is still playing.
+        void stop(VoiceHandle handle);
+        void setGain(VoiceHandle handle, float gain);
+        // Fades out every voice in the choke group.
+        void choke(int chokeGroup);
+        // Cuts every voice at the start of the next buffer.
+        void stopAll();
+        // Cuts every voice reading frames; after it returns the buffer may be freed.
+        // Waits for the next buffer, so it belongs on loader and control threads.
+        size_t stopSample(const float* frames);
+        // Applies pending commands, then mixes the next frameCount frames of every voice into output (overwritten).
+        void render(float* output, size_t frameCount);
+
+        int getFrequency() const;
+        int getChannels() const;
+        SDL_AudioFormat getFormat() const;
+        uint32_t getActiveVoiceCount() const;
+        void printReport() const;
+
+    private:
+        enum class VoiceCommandType { Play, Stop, SetGain, Choke, StopAll, StopSample };
+
+        struct VoiceCommand {
+            VoiceCommandType type = VoiceCommandType::Stop;
+            VoiceHandle handle = 0;
+            const float* frames = nullptr;
+            uint32_t frameCount = 0;
+            VoiceOptions options;                   // gain also carries setGain, chokeGroup carries choke
+            uint64_t postedNanoseconds = 0;         // steady clock, for the latency report
+            std::atomic<size_t>* stopped = nullptr; // stopSample's count, written once the stop is applied
+        };
+
+        static void audioCallback(void* userdata, Uint8* stream, int length);
+        bool allocateVoices(int frequency, int channels, SDL_AudioFormat format, int bufferFrames, int maxVoices);
+        void fillDeviceBuffer(Uint8* stream, int length);
+        bool postCommand(VoiceCommand& command);
+        void waitForCommands();
+        void acquireMixer();
+        void releaseMixer();
+        void applyCommands();
+        void startVoice(const VoiceCommand& command);
+        void fadeChokeGroup(int chokeGroup);
+        int findVoice(VoiceHandle handle) const;
+        size_t cutSample(const float* frames);
+        void mixVoices(float* output, size_t frameCount);
+        size_t mixFadingVoice(float* output, uint16_t voice, size_t frameCount);
+        void beginFade(uint16_t voice);
+        int findVictim(uint32_t note) const;
+        float getUpcomingLevel(uint16_t voice) const;
+        bool reclaimFadingVoice();
+        void releaseVoice(size_t activeIndex);
+
+        bool verbose;
+        const MixKernelTable& kernels;
+        SDL_AudioDeviceID device;
+        std::atomic<bool> deviceRunning; // the callback is draining commands
+        int frequency;
+        int channels;
+        SDL_AudioFormat format;
+        size_t bufferFrames;
+        StealMode stealMode;
+        double fadeMilliseconds;
+        ResamplerQuality resamplerQuality;
+        SampleRateConverter sampleRateConverter;
+        uint32_t fadeFrames;
+        uint32_t maxSoundingVoices;
+
+        // Voice pool, structure of arrays indexed by voice slot.
+        std::vector<const float*> voiceSamples;
+        std::vector<uint32_t> voiceFrameCount;
+        std::vector<uint64_t> voicePosition; // 32.32 fixed-point frames
+        std::vector<uint64_t> voiceStep;     // added per output frame, 1 << 32 at the original pitch
+        std::vector<float> voiceGain;
+        std::vector<VoiceHandle> voiceHandle;
+        std::vector<uint32_t> voiceNote;
+        std::vector<int> voiceChokeGroup;
+        std::vector<uint64_t> voiceStartOrder;
+        std::vector<float> voiceFade;     // fade-out level, 1 until the voice is stopped
+        std::vector<float> voiceFadeStep; // per-frame decrement, 0 while not fading
+        // Dense list of playing slots so the callback only walks live voices.
+        std::vector<uint16_t> activeVoices;
+        std::vector<uint16_t> freeVoices;
+        std::vector<float> mixBuffer;
+        uint64_t nextStartOrder;
+        uint32_t soundingVoiceCount; // active and not fading
+
+        MPSCRingBuffer<VoiceCommand> voiceCommands;
+        std::atomic<VoiceHandle> nextHandle;
+        // Whoever holds this owns the pool: the callback, render(), or a control
+        // thread applying commands itself while no device is running.
+        std::atomic<bool> mixerBusy;
+
+        // Written by the thread applying commands, read by printReport.
+        std::atomic<uint32_t> activeVoiceCount;
+        std::atomic<uint32_t> peakVoiceCount;
+        std::atomic<uint64_t> stolenVoiceCount;
+        std::atomic<uint64_t> chokedVoiceCount;
+        std::atomic<uint64_t> droppedVoiceCount;   // no slot could be freed
+        std::atomic<uint64_t> droppedCommandCount; // the queue was full
+        std::atomic<uint64_t> appliedCommandCount;
+        std::atomic<uint64_t> commandLatencyNanoseconds; // posted to applied, summed
+        std::atomic<uint64_t> maxCommandLatencyNanoseconds;
+        std::atomic<uint64_t> callbackCount;
+};
+
+#endif // VOICE_ENGINE_H
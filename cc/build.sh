@@ -10,21 +10,103 @@ compile_source() {
     echo "Done compilin' $1, mate!"
 }
 
+# Function to link the scheduler benchmark; it needs no SDL libraries
+link_benchmark() {
+    echo "Linkin' the scheduler benchmark an' all..."
+    if ! g++ -O2 -o scheduler_benchmark \
+        ScheduleAction.o \
+        BatchActions.o \
+        BatchScheduler.o \
+        DurationLogger.o \
+        PrecisionWait.o \
+        Profiler.o \
+        ThreadPool.o \
+        ClockSource.o \
+        MasterClock.o \
+        SchedulerBenchmark.o \
+        -lpthread \
+        -lyaml-cpp;
+    then
+        echo "Cor blimey! Linkin' the benchmark failed, it did!"
+        exit 1
+    fi
+    echo "Linked the scheduler_benchmark too, mate!"
+}
+
+# Function to link the tests; like the benchmark they need no SDL libraries
+link_tests() {
+    echo "Linkin' the tests an' all..."
+    if ! g++ -O2 -o tick_allocation_test \
+        ScheduleAction.o \
+        BatchActions.o \
+        BatchScheduler.o \
+        DurationLogger.o \
+        PrecisionWait.o \
+        Profiler.o \
+        ThreadPool.o \
+        ClockSource.o \
+        MasterClock.o \
+        TickAllocationTest.o \
+        -lpthread \
+        -lyaml-cpp;
+    then
+        echo "Cor blimey! Linkin' the tick allocation test failed, it did!"
+        exit 1
+    fi
+    if ! g++ -O2 -o mix_kernel_test \
+        MixKernels.o \
+        MixKernelTest.o;
+    then
+        echo "Cor blimey! Linkin' the mix kernel test failed, it did!"
+        exit 1
+    fi
+    echo "Linked the tests too, mate!"
+}
+
+# Function to run the tests; a failing test fails the build
+run_tests() {
+    echo "Runnin' the tests, guv..."
+    if ! ./tick_allocation_test; then
+        echo "Blimey! The tick allocation test failed, it did!"
+        exit 1
+    fi
+    if ! ./mix_kernel_test; then
+        echo "Blimey! The mix kernel test failed, it did!"
+        exit 1
+    fi
+    echo "All the tests passed, mate!"
+}
+
 # Function to link object files and create the executable
 link_objects() {
     echo "Gawd, linkin' them object files now..."
     if ! g++ -O2 -o audio_player \
         ScheduleAction.o \
         BatchActions.o \
+        BatchScheduler.o \
+        DurationLogger.o \
+        PrecisionWait.o \
+        Profiler.o \
+        ThreadPool.o \
+        ClockSource.o \
+        SessionRecorder.o \
         KeyboardEvent.o \
         MasterClock.o \
         AudioProcessor.o \
+        MixKernels.o \
+        SampleRateConverter.o \
+        VoiceEngine.o \
+        SampleCache.o \
+        SampleIndex.o \
+        SampleBankManager.o \
+        OfflineMixer.o \
         AudioPlayer.o \
         AudioManager.o \
         GraphicProcessor.o \
         GraphicPlayer.o \
         GraphicManager.o \
         Manager.o \
+        OfflineRenderer.o \
         AudioLooper.o \
         LooperManager.o \
         main.o \
@@ -73,6 +155,48 @@ if ! check_md5sum BatchActions.cc || ! check_md5sum BatchActions.h; then
     get_md5sum BatchActions.h > BatchActions.h.md5
 fi
 
+if ! check_md5sum BatchScheduler.cc || ! check_md5sum BatchScheduler.h; then
+    compile_source BatchScheduler.cc
+    get_md5sum BatchScheduler.cc > BatchScheduler.cc.md5
+    get_md5sum BatchScheduler.h > BatchScheduler.h.md5
+fi
+
+if ! check_md5sum DurationLogger.cc || ! check_md5sum DurationLogger.h; then
+    compile_source DurationLogger.cc
+    get_md5sum DurationLogger.cc > DurationLogger.cc.md5
+    get_md5sum DurationLogger.h > DurationLogger.h.md5
+fi
+
+if ! check_md5sum PrecisionWait.cc || ! check_md5sum PrecisionWait.h; then
+    compile_source PrecisionWait.cc
+    get_md5sum PrecisionWait.cc > PrecisionWait.cc.md5
+    get_md5sum PrecisionWait.h > PrecisionWait.h.md5
+fi
+
+if ! check_md5sum Profiler.cc || ! check_md5sum Profiler.h; then
+    compile_source Profiler.cc
+    get_md5sum Profiler.cc > Profiler.cc.md5
+    get_md5sum Profiler.h > Profiler.h.md5
+fi
+
+if ! check_md5sum ThreadPool.cc || ! check_md5sum ThreadPool.h; then
+    compile_source ThreadPool.cc
+    get_md5sum ThreadPool.cc > ThreadPool.cc.md5
+    get_md5sum ThreadPool.h > ThreadPool.h.md5
+fi
+
+if ! check_md5sum ClockSource.cc || ! check_md5sum ClockSource.h; then
+    compile_source ClockSource.cc
+    get_md5sum ClockSource.cc > ClockSource.cc.md5
+    get_md5sum ClockSource.h > ClockSource.h.md5
+fi
+
+if ! check_md5sum SessionRecorder.cc || ! check_md5sum SessionRecorder.h; then
+    compile_source SessionRecorder.cc
+    get_md5sum SessionRecorder.cc > SessionRecorder.cc.md5
+    get_md5sum SessionRecorder.h > SessionRecorder.h.md5
+fi
+
 if ! check_md5sum MasterClock.cc || ! check_md5sum MasterClock.h; then
     compile_source MasterClock.cc
     get_md5sum MasterClock.cc > MasterClock.cc.md5
@@ -139,13 +263,79 @@ if ! check_md5sum Manager.cc || ! check_md5sum Manager.h; then
     get_md5sum Manager.h > Manager.h.md5
 fi
 
+if ! check_md5sum MixKernels.cc || ! check_md5sum MixKernels.h; then
+    compile_source MixKernels.cc
+    get_md5sum MixKernels.cc > MixKernels.cc.md5
+    get_md5sum MixKernels.h > MixKernels.h.md5
+fi
+
+if ! check_md5sum SampleRateConverter.cc || ! check_md5sum SampleRateConverter.h; then
+    compile_source SampleRateConverter.cc
+    get_md5sum SampleRateConverter.cc > SampleRateConverter.cc.md5
+    get_md5sum SampleRateConverter.h > SampleRateConverter.h.md5
+fi
+
+if ! check_md5sum VoiceEngine.cc || ! check_md5sum VoiceEngine.h; then
+    compile_source VoiceEngine.cc
+    get_md5sum VoiceEngine.cc > VoiceEngine.cc.md5
+    get_md5sum VoiceEngine.h > VoiceEngine.h.md5
+fi
+
+if ! check_md5sum SampleCache.cc || ! check_md5sum SampleCache.h; then
+    compile_source SampleCache.cc
+    get_md5sum SampleCache.cc > SampleCache.cc.md5
+    get_md5sum SampleCache.h > SampleCache.h.md5
+fi
+
+if ! check_md5sum SampleIndex.cc || ! check_md5sum SampleIndex.h; then
+    compile_source SampleIndex.cc
+    get_md5sum SampleIndex.cc > SampleIndex.cc.md5
+    get_md5sum SampleIndex.h > SampleIndex.h.md5
+fi
+
+if ! check_md5sum SampleBankManager.cc || ! check_md5sum SampleBankManager.h; then
+    compile_source SampleBankManager.cc
+    get_md5sum SampleBankManager.cc > SampleBankManager.cc.md5
+    get_md5sum SampleBankManager.h > SampleBankManager.h.md5
+fi
+
+if ! check_md5sum OfflineMixer.cc || ! check_md5sum OfflineMixer.h; then
+    compile_source OfflineMixer.cc
+    get_md5sum OfflineMixer.cc > OfflineMixer.cc.md5
+    get_md5sum OfflineMixer.h > OfflineMixer.h.md5
+fi
+
+if ! check_md5sum OfflineRenderer.cc || ! check_md5sum OfflineRenderer.h; then
+    compile_source OfflineRenderer.cc
+    get_md5sum OfflineRenderer.cc > OfflineRenderer.cc.md5
+    get_md5sum OfflineRenderer.h > OfflineRenderer.h.md5
+fi
+
 if ! check_md5sum main.cc; then
     compile_source main.cc
     get_md5sum main.cc > main.cc.md5
 fi
 
+if ! check_md5sum SchedulerBenchmark.cc; then
+    compile_source SchedulerBenchmark.cc
+    get_md5sum SchedulerBenchmark.cc > SchedulerBenchmark.cc.md5
+fi
+
+if ! check_md5sum TickAllocationTest.cc; then
+    compile_source TickAllocationTest.cc
+    get_md5sum TickAllocationTest.cc > TickAllocationTest.cc.md5
+fi
+
+if ! check_md5sum MixKernelTest.cc; then
+    compile_source MixKernelTest.cc
+    get_md5sum MixKernelTest.cc > MixKernelTest.cc.md5
+fi
+
 # Link object files to create the executable
 link_objects
+link_benchmark
+link_tests
+run_tests
 
 # Change the permissions of the executable
 chmod 777 audio_player
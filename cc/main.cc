@@ -1,9 +1,14 @@
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <stdbool.h>
 #include <signal.h>
 #include "Manager.h"
 #include "MasterClock.h"
+#include "OfflineMixer.h"
+#include "OfflineRenderer.h"
+#include "SessionRecorder.h"
 #include "Structures.h"
 #include <chrono>
 #include <thread>
@@ -91,10 +96,91 @@ std::string argumentHandler(int argc, char* argv[]) {
     return configFilePath;
 }
 
+struct SessionArguments {
+    std::string recordPath;
+    std::string renderPath;
+    std::string outputPath;
+    double tailSeconds;
+};
+
+SessionArguments sessionArgumentHandler(int argc, char* argv[]) {
+    SessionArguments arguments;
+    arguments.outputPath = "render.wav";
+    arguments.tailSeconds = 2.0;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--record") {
+            arguments.recordPath = argv[++i];
+        } else if (arg == "--render") {
+            arguments.renderPath = argv[++i];
+        } else if (arg == "--output") {
+            arguments.outputPath = argv[++i];
+        } else if (arg == "--tail") {
+            arguments.tailSeconds = std::max(0.0, std::atof(argv[++i]));
+        }
+    }
+    return arguments;
+}
+
+// Renders a recorded session to a WAV file without audio or video output.
+// The clock runs on simulated time, so this finishes as fast as the mixing allows.
+int renderSession(MasterClock& masterClock, const SessionArguments& arguments,
+    double bpm, double beatDivisions,
+    const KeypadLoopDurations& loopDurations,
+    const YAML::Node& verbosity, const YAML::Node& notesConfig, const YAML::Node& windowConfig,
+    const YAML::Node& audioMixerConfig, bool superVerbose, bool timeVerbose) {
+    std::vector<SessionEvent> events;
+    double sessionBPM = bpm;
+    double sessionDivisions = beatDivisions;
+    if (!SessionRecorder::loadSession(arguments.renderPath, events, sessionBPM, sessionDivisions)) {
+        return 1;
+    }
+    if (sessionBPM != bpm || sessionDivisions != beatDivisions) {
+        printf("---Main::renderSession::Session was recorded at %f bpm / %f divisions, config has %f / %f.\n",
+            sessionBPM, sessionDivisions, bpm, beatDivisions);
+    }
+    // The dummy driver lets the audio output open, so samples are converted
+    // to its format as usual, without needing (or blocking on) a sound card.
+    setenv("SDL_AUDIODRIVER", "dummy", 1);
+    if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_EVENTS) < 0) {
+        printf("---SDL initialization failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    VirtualClockSource virtualClock;
+    masterClock.setClockSource(&virtualClock);
+    masterClock.start();
+
+    int result = 0;
+    {
+        Manager manager(masterClock, loopDurations, verbosity, notesConfig, windowConfig,
+            audioMixerConfig, superVerbose, timeVerbose, false);
+        OfflineMixer mixer(virtualClock, verbosity["mainVerbose"].as<bool>());
+        manager.setOfflineMixer(&mixer);
+        if (mixer.open(arguments.outputPath)) {
+            OfflineRenderer renderer(masterClock, virtualClock, manager, mixer,
+                verbosity["mainVerbose"].as<bool>());
+            Duration tail = std::chrono::duration_cast<Duration>(std::chrono::duration<double>(arguments.tailSeconds));
+            if (!renderer.render(events, tail)) {
+                result = 1;
+            }
+            mixer.close();
+        } else {
+            result = 1;
+        }
+        manager.setOfflineMixer(nullptr);
+    }
+    masterClock.stop();
+    masterClock.setClockSource(nullptr);
+    SDL_Quit();
+    return result;
+}
+
 int main(int argc, char* argv[]) {
     // Set up the termination signal handler
     signal(SIGINT, handleTermination);
     const std::string configFile = argumentHandler(argc, argv);
+    const SessionArguments sessionArguments = sessionArgumentHandler(argc, argv);
+    const bool renderMode = !sessionArguments.renderPath.empty();
     YAML::Node config = YAML::LoadFile(configFile);
     
     YAML::Node audioMixerConfig = config["audioMixer"];
@@ -110,37 +196,11 @@ int main(int argc, char* argv[]) {
     // Read the BPM value from the YAML config
     double bpm = config["bpm"].as<double>();
     double beatDivisions = config["beatDivisions"].as<double>();
-    double kp1LoopDuration = 1/config["kp1LoopDuration"].as<double>();
-    double kp2LoopDuration = 1/config["kp2LoopDuration"].as<double>();
-    double kp3LoopDuration = 1/config["kp3LoopDuration"].as<double>();
-    double kp4LoopDuration = 1/config["kp4LoopDuration"].as<double>();
-    double kp5LoopDuration = 1/config["kp5LoopDuration"].as<double>();
-    double kp6LoopDuration = 1/config["kp6LoopDuration"].as<double>();
-    double kp7LoopDuration = 1/config["kp7LoopDuration"].as<double>();
-    double kp8LoopDuration = 1/config["kp8LoopDuration"].as<double>();
-    double kp9LoopDuration = 1/config["kp9LoopDuration"].as<double>();
-
-    bool loopKP1State = false;
-    bool loopKP2State = false;
-    bool loopKP3State = false;
-    bool loopKP4State = false;
-    bool loopKP5State = false;
-    bool loopKP6State = false;
-    bool loopKP7State = false;
-    bool loopKP8State = false;
-    bool loopKP9State = false;
-
-    const std::unordered_map<std::string, std::pair<bool*, double>> stringBoolPairs = {
-        {"KP1", {&loopKP1State, kp1LoopDuration}},
-        {"KP2", {&loopKP2State, kp2LoopDuration}},
-        {"KP3", {&loopKP3State, kp3LoopDuration}},
-        {"KP4", {&loopKP4State, kp4LoopDuration}},
-        {"KP5", {&loopKP5State, kp5LoopDuration}},
-        {"KP6", {&loopKP6State, kp6LoopDuration}},
-        {"KP7", {&loopKP7State, kp7LoopDuration}},
-        {"KP8", {&loopKP8State, kp8LoopDuration}},
-        {"KP9", {&loopKP9State, kp9LoopDuration}}
-    };
+    KeypadLoopDurations loopDurations;
+    for (size_t keypad = 0; keypad < loopDurations.size(); keypad++) {
+        std::string key = "kp" + std::to_string(keypad + 1) + "LoopDuration";
+        loopDurations[keypad] = 1/config[key].as<double>();
+    }
 
     if (mainVerbose) {
         printf("Main::Starting MasterClock.\n");
@@ -152,6 +212,11 @@ int main(int argc, char* argv[]) {
         verbosity["masterClockVerbose"].as<bool>(), 
         superVerbose, 
         timeVerbose);
+    masterClock.setClockConfig(config["clock"]);
+    if (renderMode) {
+        return renderSession(masterClock, sessionArguments, bpm, beatDivisions, loopDurations,
+            verbosity, notesConfig, windowConfig, audioMixerConfig, superVerbose, timeVerbose);
+    }
     masterClock.start();
     printf("superVerbose from main: %d.\n", superVerbose);
     if (mainVerbose) {
@@ -167,7 +232,12 @@ int main(int argc, char* argv[]) {
     }
 
     std::unique_ptr<Manager> manager(new Manager(masterClock, 
-        stringBoolPairs, verbosity, notesConfig, windowConfig, audioMixerConfig, superVerbose, timeVerbose));
+        loopDurations, verbosity, notesConfig, windowConfig, audioMixerConfig, superVerbose, timeVerbose));
+    SessionRecorder sessionRecorder(mainVerbose);
+    if (!sessionArguments.recordPath.empty() &&
+        sessionRecorder.start(sessionArguments.recordPath, bpm, beatDivisions)) {
+        manager->setSessionRecorder(&sessionRecorder);
+    }
     std::thread mainThread([&]() {
         try {
             masterClock.executeScheduledBatches();
@@ -180,6 +250,8 @@ int main(int argc, char* argv[]) {
     
     mainThread.join();
     masterClock.stop();
+    manager->setSessionRecorder(nullptr);
+    sessionRecorder.stop();
 
     // Clean up SDL and other resources
     SDL_Quit();
@@ -0,0 +1,85 @@
+import struct
+
+# Reader for the binary duration log written by cc/DurationLogger.cc
+# (duration_logs_*.bin). See DurationLogger.h for the file layout.
+
+LOG_MAGIC = b"MELYDLOG"
+HEADER_FORMAT = "<8sIIddq"
+KIND_DURATION = 0
+KIND_TAG = 1
+
+
+def isBinaryLog(filePath):
+    with open(filePath, "rb") as file:
+        return file.read(len(LOG_MAGIC)) == LOG_MAGIC
+
+
+def readDurationLog(filePath):
+    """Returns (header, records). Each record is a dict with timestamp,
+    processingDuration, sleepDuration and wakeupError in nanoseconds plus the
+    idTag name ("" when no looping batch ran). wakeupError is None for
+    version 1 logs, which predate it."""
+    with open(filePath, "rb") as file:
+        data = file.read()
+
+    headerSize = struct.calcsize(HEADER_FORMAT)
+    magic, version, entrySize, bpm, divisions, startTime = struct.unpack_from(HEADER_FORMAT, data, 0)
+    if magic != LOG_MAGIC:
+        raise ValueError(f"{filePath} is not a binary duration log.")
+    header = {
+        "version": version,
+        "bpm": bpm,
+        "divisions": divisions,
+        "startTime": startTime,
+    }
+
+    tags = {0: ""}
+    records = []
+    offset = headerSize
+    while offset + 4 <= len(data):
+        kind, = struct.unpack_from("<I", data, offset)
+        if kind == KIND_TAG:
+            tagId, nameLength = struct.unpack_from("<II", data, offset + 4)
+            nameStart = offset + 12
+            tags[tagId] = data[nameStart:nameStart + nameLength].decode("utf-8", "replace")
+            offset = nameStart + nameLength
+        elif kind == KIND_DURATION:
+            if offset + entrySize > len(data):
+                break  # truncated final entry
+            tagId, timestamp, processing, sleep = struct.unpack_from("<Iqqq", data, offset + 4)
+            wakeupError = None
+            if version >= 2:
+                wakeupError, = struct.unpack_from("<q", data, offset + 32)
+            records.append({
+                "timestamp": timestamp,
+                "tag": tags.get(tagId, ""),
+                "processingDuration": processing,
+                "sleepDuration": sleep,
+                "wakeupError": wakeupError,
+            })
+            # entrySize comes from the header so newer writers can append fields.
+            offset += entrySize
+        else:
+            raise ValueError(f"Unknown entry kind {kind} at offset {offset}.")
+    return header, records
+
+
+def toTextLines(filePath, includeWakeupError=False):
+    """Renders a binary log as the text lines the original per-tick log used,
+    so existing line-based analysis keeps working unchanged. With
+    includeWakeupError each record also gets a "WU_error" line."""
+    header, records = readDurationLog(filePath)
+    lines = [
+        "MasterClock::MasterClock::Setup:",
+        f"  BPM: {header['bpm']:f}",
+        f"  Divisions: {header['divisions']:f}",
+    ]
+    for record in records:
+        processing = record["processingDuration"] // 1000
+        sleep = record["sleepDuration"] // 1000
+        lines.append(f"MasterClock::executeScheduledBatches::Duration: {processing} (microseconds) PD_time")
+        lines.append(f"MasterClock::executeScheduledBatches::Duration: {sleep} (microseconds) {record['tag']}")
+        if includeWakeupError and record["wakeupError"] is not None:
+            wakeup = record["wakeupError"] // 1000
+            lines.append(f"MasterClock::executeScheduledBatches::Duration: {wakeup} (microseconds) WU_error")
+    return lines
@@ -3,6 +3,7 @@ import numpy as np
 from scipy.stats import linregress, norm
 import matplotlib.pyplot as plt
 import argparse
+from durationLogReader import isBinaryLog, toTextLines
 
 def process_data(data, analysisType):
     lines = data.strip().split('\n')
@@ -21,12 +22,12 @@ def process_data(data, analysisType):
                     total_time = duration
                 else:
                     total_time += duration
-            elif analysisType == "pp":
-                if "RunTimeTasks" in parts[-1]:
-                    totals.append(duration)
             elif analysisType == "pd":
                 if "PD_time" in parts[-1]:
                     totals.append(duration)
+            elif analysisType == "we":
+                if "WU_error" in parts[-1]:
+                    totals.append(duration)
 
     # Add the last total if there's one remaining
     if analysisType == "kp":
@@ -38,7 +39,7 @@ def process_data(data, analysisType):
 def main():
     parser = argparse.ArgumentParser(description="Setup Config for Drum Machine.")
     parser.add_argument("-t", "--type", required=True,
-                    help="Analytic Type (KeyPad (kp), Processing Durations (pd), or Program Prcoesses (pp))")
+                    help="Analytic Type (KeyPad (kp), Processing Durations (pd), or Wakeup Error (we))")
     parser.add_argument("-f", "--file", required=True, help="Input file pathh")
     args = parser.parse_args()
     file_path = args.file
@@ -47,7 +48,7 @@ def main():
         analysisType = analysisType.lower()
     else:
         sys.exit(f"Incorrect format for Type: {type(analysisType)}.")
-    analysisTypes = ["pp", "pd", "kp"]
+    analysisTypes = ["pd", "kp", "we"]
     
     if analysisType in analysisTypes:
         pass
@@ -56,9 +57,12 @@ def main():
 
     
     try:
-        with open(file_path, 'r') as file:
-            data = file.read()
-            totals = process_data(data, analysisType)
+        if isBinaryLog(file_path):
+            data = "\n".join(toTextLines(file_path, analysisType == "we"))
+        else:
+            with open(file_path, 'r') as file:
+                data = file.read()
+        totals = process_data(data, analysisType)
     except FileNotFoundError:
         print("File not found!")
 